@@ -1,9 +1,23 @@
 #include "gltf.hpp"
+#include "gltf_animation.hpp"
+#include "gltf_bvh.hpp"
+#include "gltf_detail.hpp"
+#include "gltf_indirect.hpp"
+#include "gltf_mesh_opt.hpp"
+#include "gltf_quantize.hpp"
+#include "gltf_skin.hpp"
+#include "gltf_upload.hpp"
+#include "gltf_vertex_gen.hpp"
 #include "json.hpp"
 #include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <execution>
 #include <filesystem>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
 
 namespace knu
 {
@@ -22,27 +36,449 @@ namespace knu
 
 			void load(std::string gltf_file, std::string relative_path)
 			{
+				// nothing parsed or built from the previous file may stay around
+				*this = impl{};
 				open_gltf_file(gltf_file, relative_path);
 			}
 
+			void clear_cache()
+			{
+				triangle_bvh_cache.clear();
+				std::get<0>(node_caches).clear();
+				std::get<1>(node_caches).clear();
+			}
+
 			bool has_node(std::string node_name)
 			{
 				auto iter = find_node(node_name);
 				return iter != std::end(nodes_vec);
 			}
 
-			void build_node(std::string_view node_name, gltf_node& node)
+			template <typename Real>
+			void build_node(std::string_view node_name, basic_gltf_node<Real>& node,
+				const gltf_build_options& options)
 			{
 				auto node_iter = find_node(node_name);
 
 				if (node_iter != std::end(nodes_vec))
+					build_node(static_cast<std::size_t>(node_iter - std::begin(nodes_vec)), node, options);
+			}
+
+			// names are optional and need not be unique, anything that walks the nodes goes by index
+			template <typename Real>
+			void build_node(std::size_t node_index, basic_gltf_node<Real>& node, const gltf_build_options& options)
+			{
+				auto node_iter = std::begin(nodes_vec) + node_index;
+
+				node.node_name = node_iter->node_name;
+				node.skin_index = node_iter->skin_index;
+				load_glft_transformation(node_iter, node);
+
+				if (node_iter->has_mesh)
 				{
-					node.node_name = node_name;
-					load_glft_transformation(node_iter, node);
+					load_gltf_mesh(meshes_vec[node_iter->mesh_index], node, options.attribute_mask);
+					apply_build_options(node_iter->mesh_index, node, options);
+
+					node.weights = node_iter->weights.empty() ? meshes_vec[node_iter->mesh_index].weights : node_iter->weights;
+				}
+			}
+
+			// build_node once per node and options, the node is kept and handed out again after that
+			template <typename Real>
+			std::shared_ptr<const basic_gltf_node<Real>> build_shared_node(std::string_view node_name,
+				const gltf_build_options& options)
+			{
+				auto node_iter = find_node(node_name);
+				if (node_iter == std::end(nodes_vec))
+					return nullptr;
+
+				const std::size_t node_index = static_cast<std::size_t>(node_iter - std::begin(nodes_vec));
+				auto& cache = std::get<node_cache<Real>>(node_caches);
+				node_cache_key key{ node_index, options_key(options) };
+				auto cached = cache.find(key);
+				if (cached != std::end(cache))
+					return cached->second;
 
-					if (node_iter->has_mesh)
-						load_gltf_mesh(meshes_vec[node_iter->mesh_index], node);
+				auto node = std::make_shared<basic_gltf_node<Real>>();
+				build_node(node_index, *node, options);
+				cache.emplace(std::move(key), node);
+
+				return node;
+			}
+
+			// names resolve to the first node with that name, see the index overload
+			template <typename Real>
+			bool build_static_batch(const std::vector<std::string>& node_names, basic_gltf_node<Real>& batch,
+				const gltf_build_options& options)
+			{
+				std::vector<std::size_t> node_indices;
+				for (const std::string& node_name : node_names)
+				{
+					auto node_iter = find_node(node_name);
+					if (node_iter != std::end(nodes_vec))
+						node_indices.push_back(static_cast<std::size_t>(node_iter - std::begin(nodes_vec)));
 				}
+
+				return build_static_batch(node_indices, batch, options);
+			}
+
+			template <typename Real>
+			bool build_static_batch(const std::vector<std::size_t>& node_indices, basic_gltf_node<Real>& batch,
+				const gltf_build_options& options)
+			{
+				const std::vector<detail::mat4> world = world_matrices();
+
+				batch.node_name = "static_batch";
+				batch.scale = { 1, 1, 1 };
+				batch.translation = { 0, 0, 0 };
+				batch.rotation = { 0, 0, 0, 1 };
+
+				bool any = false;
+				for (std::size_t node_index : node_indices)
+				{
+					if (node_index >= nodes_vec.size() || !nodes_vec[node_index].has_mesh)
+						continue;
+
+					basic_gltf_node<Real> node;
+					load_gltf_mesh(meshes_vec[nodes_vec[node_index].mesh_index], node, options.attribute_mask);
+					pre_transform(node.mesh, world[node_index]);
+
+					// the node's buffers go after the ones already in the batch
+					const std::uint32_t buffer_offset = static_cast<std::uint32_t>(batch.mesh.buffers.size());
+					for (auto& sub_mesh : node.mesh.sub_meshes)
+					{
+						detail::for_each_attribute(sub_mesh, [buffer_offset](basic_gltf_component_info<Real>& info)
+						{
+							info.buffer_index += buffer_offset;
+						});
+						batch.mesh.sub_meshes.emplace_back(std::move(sub_mesh));
+					}
+
+					for (auto& buffer : node.mesh.buffers)
+						batch.mesh.buffers.emplace_back(std::move(buffer));
+
+					any = true;
+				}
+
+				if (!any)
+					return false;
+
+				gltf_build_options batch_options = options;
+				batch_options.merge_primitives = true;
+				apply_build_options(-1, batch, batch_options);
+
+				return true;
+			}
+
+			gltf_indirect_draws build_scene_draws(const gltf_vertex_layout& layout, const gltf_build_options& options)
+			{
+				const std::vector<detail::mat4> world = world_matrices();
+
+				std::vector<gltf_node_f> nodes;
+				std::vector<std::array<float, 16>> transforms;
+				for (std::size_t i = 0; i < nodes_vec.size(); ++i)
+				{
+					if (!nodes_vec[i].has_mesh)
+						continue;
+
+					nodes.emplace_back();
+					build_node(i, nodes.back(), options);
+
+					std::array<float, 16> transform;
+					std::transform(std::begin(world[i]), std::end(world[i]), std::begin(transform),
+						[](double v) { return static_cast<float>(v); });
+					transforms.push_back(transform);
+				}
+
+				return build_indirect_draws(nodes, layout, transforms);
+			}
+
+			gltf_upload_plan plan_uploads(std::size_t gap_threshold, std::size_t alignment)
+			{
+				std::vector<gltf_buffer_view_range> views;
+				for (const buffer_views_struct& bvs : buffer_views_vec)
+					views.push_back(gltf_buffer_view_range{ bvs.buffer_index, bvs.byte_offset, bvs.byte_length,
+						static_cast<std::uint32_t>(bvs.target), false });
+
+				auto reference = [&](int accessor_index, std::uint32_t usage)
+				{
+					// sparse accessors are made dense on load, the base view alone lacks the substituted
+					// values so it is not uploaded for them
+					if (accessor_index < 0 || !is_dense(accessors_vec[accessor_index]))
+						return;
+
+					gltf_buffer_view_range& view = views[accessors_vec[accessor_index].buffer_view_ref];
+					if (view.target == NO_TARGET)
+						view.target = usage;
+					view.referenced = true;
+				};
+
+				for (const meshes_struct& mesh : meshes_vec)
+				{
+					for (const primitives_struct& primitive : mesh.primitives_vec)
+					{
+						reference(primitive.indices_ref, gltf_targets::element_array_buffer);
+						if (primitive.has_position)
+							reference(primitive.position_index, gltf_targets::array_buffer);
+						if (primitive.has_normal)
+							reference(primitive.normal_index, gltf_targets::array_buffer);
+						if (primitive.has_tangent)
+							reference(primitive.tangent_index, gltf_targets::array_buffer);
+						for (int texcoord : primitive.texcoord_indices)
+							reference(texcoord, gltf_targets::array_buffer);
+						for (const auto& attribute : primitive.other_attributes)
+							reference(attribute.second, gltf_targets::array_buffer);
+						for (const std::array<int, 3>& target : primitive.targets)
+							for (int accessor_index : target)
+								reference(accessor_index, gltf_targets::array_buffer);
+					}
+				}
+
+				return knu::graphics::plan_uploads(views, gap_threshold, alignment);
+			}
+
+			std::size_t animation_count() const
+			{
+				return animations_vec.size();
+			}
+
+			std::string animation_name(std::size_t animation_index) const
+			{
+				return animations_vec.at(animation_index).animation_name;
+			}
+
+			bool build_animation(std::string_view animation_name, gltf_animation& animation,
+				const gltf_animation_options& options)
+			{
+				auto animation_iter = std::find_if(std::begin(animations_vec), std::end(animations_vec),
+					[=](const animations_struct& a) { return a.animation_name == animation_name; });
+				if (animation_iter == std::end(animations_vec))
+					return false;
+
+				animation.name = animation_iter->animation_name;
+
+				// only the elements of the accessors the samplers use are copied, once per accessor, the
+				// key times are often shared by every sampler
+				std::map<int, gltf_component_info_f> copied;
+				auto copy_accessor = [&](int accessor)
+				{
+					auto copied_iter = copied.find(accessor);
+					if (copied_iter == std::end(copied))
+						copied_iter = copied.emplace(accessor, get_owned_component_info<float>(accessor, animation.buffers)).first;
+					return copied_iter->second;
+				};
+
+				auto valid_accessor = [this](int accessor) { return accessor >= 0 && std::size_t(accessor) < accessors_vec.size(); };
+
+				bool has_keys = false;
+				animation.start_time = std::numeric_limits<float>::max();
+				animation.end_time = std::numeric_limits<float>::lowest();
+				for (const animation_samplers_struct& ss : animation_iter->samplers)
+				{
+					gltf_animation_sampler sampler;
+					sampler.interpolation = ss.interpolation;
+					if (valid_accessor(ss.input) && valid_accessor(ss.output))
+					{
+						sampler.input = copy_accessor(ss.input);
+						sampler.output = copy_accessor(ss.output);
+					}
+
+					// times are FLOAT and the spec makes min and max required for them
+					if (sampler.input.valid && sampler.input.count > 0)
+					{
+						const detail::attribute_reader times{ animation.buffers, sampler.input };
+						animation.start_time = std::min(animation.start_time, times.component(0, 0));
+						animation.end_time = std::max(animation.end_time, times.component(times.size() - 1, 0));
+						has_keys = true;
+					}
+
+					animation.samplers.push_back(sampler);
+				}
+
+				if (!has_keys)
+					animation.start_time = animation.end_time = 0.0f;
+
+				for (const animation_channels_struct& cs : animation_iter->channels)
+				{
+					if (cs.node < 0 || cs.sampler < 0 || std::size_t(cs.sampler) >= animation.samplers.size())
+						continue;
+
+					const gltf_animation_sampler& sampler = animation.samplers[cs.sampler];
+					if (!sampler.input.valid || sampler.input.count == 0)
+						continue;
+
+					std::uint32_t components = cs.path == gltf_animation_path::rotation ? 4 : 3;
+					if (cs.path == gltf_animation_path::weights)
+					{
+						// scalars, the targets of every key one after the other
+						const std::uint32_t keys = sampler.input.count
+							* (sampler.interpolation == gltf_interpolation::cubic_spline ? 3 : 1);
+						components = sampler.output.count / keys;
+					}
+
+					animation.value_offsets.push_back(animation.value_count);
+					animation.value_count += components;
+					animation.channels.push_back(gltf_animation_channel{ static_cast<std::uint32_t>(cs.sampler),
+						static_cast<std::uint32_t>(cs.node), cs.path, components });
+				}
+
+				if (options.reduce_keys || options.quantize_rotations)
+					compress_animation(animation, options);
+
+				return true;
+			}
+
+			std::size_t skin_count() const
+			{
+				return skins_vec.size();
+			}
+
+			bool build_skin(std::size_t skin_index, gltf_skin& skin)
+			{
+				if (skin_index >= skins_vec.size())
+					return false;
+
+				const skins_struct& ss = skins_vec[skin_index];
+				skin.name = ss.skin_name;
+				skin.skeleton = ss.skeleton;
+				skin.joints.assign(std::begin(ss.joints), std::end(ss.joints));
+
+				std::array<float, 16> identity;
+				const detail::mat4 identity_matrix = detail::identity_matrix();
+				std::copy(std::begin(identity_matrix), std::end(identity_matrix), std::begin(identity));
+				skin.inverse_bind_matrices.assign(skin.joints.size(), identity);
+
+				// MAT4 of FLOAT, columns first. The accessor can be sparse or have no bufferView, and matrices
+				// it does not have, or that would read past the end of the data, stay identity
+				if (ss.inverse_bind_matrices >= 0 && std::size_t(ss.inverse_bind_matrices) < accessors_vec.size()
+					&& accessors_vec[ss.inverse_bind_matrices].d_type == MAT4)
+				{
+					std::vector<gltf_buffer> dense;
+					const gltf_component_info_f info = get_component_info<float>(ss.inverse_bind_matrices, dense);
+					const std::vector<std::uint8_t>& data = dense.empty() ? buffers_vec[info.buffer_index].data : dense.back().data;
+					const detail::attribute_reader reader{ info, data.data() };
+
+					const std::size_t stride = info.byte_stride != 0 ? info.byte_stride : reader.element_size();
+					std::size_t count = std::min<std::size_t>(reader.size(), skin.joints.size());
+					while (count > 0 && info.byte_offset + (count - 1) * stride + reader.element_size() > data.size())
+						--count;
+
+					for (std::size_t j = 0; j < count; ++j)
+						for (std::uint32_t e = 0; e < 16; ++e)
+							skin.inverse_bind_matrices[j][e] = reader.component(j, e);
+				}
+
+				return true;
+			}
+
+			std::vector<std::array<double, 16>> world_transforms(const gltf_animation* animation, const float* values)
+			{
+				std::vector<detail::mat4> locals;
+				for (const nodes_struct& n : nodes_vec)
+					locals.push_back(local_matrix(n));
+
+				if (animation != nullptr && values != nullptr)
+				{
+					// the animated paths over the node's own, nodes with a matrix cannot be animated
+					std::vector<nodes_struct> animated = nodes_vec;
+					std::vector<bool> changed(nodes_vec.size(), false);
+					for (std::size_t c = 0; c < animation->channels.size(); ++c)
+					{
+						const gltf_animation_channel& channel = animation->channels[c];
+						if (channel.node >= animated.size() || animated[channel.node].has_matrix)
+							continue;
+
+						const float* value = values + animation->value_offsets[c];
+						nodes_struct& n = animated[channel.node];
+						switch (channel.path)
+						{
+						case gltf_animation_path::translation: std::copy(value, value + 3, n.translation); break;
+						case gltf_animation_path::rotation: std::copy(value, value + 4, n.rotation); break;
+						case gltf_animation_path::scale: std::copy(value, value + 3, n.scale); break;
+						default: continue;
+						}
+
+						changed[channel.node] = true;
+					}
+
+					for (std::size_t i = 0; i < animated.size(); ++i)
+						if (changed[i])
+							locals[i] = local_matrix(animated[i]);
+				}
+
+				return world_matrices(locals);
+			}
+
+			std::size_t node_count() const
+			{
+				return nodes_vec.size();
+			}
+
+			std::string node_name(std::size_t node_index) const
+			{
+				return nodes_vec.at(node_index).node_name;
+			}
+
+			gltf_scene_bvh build_scene_bvh()
+			{
+				const std::vector<detail::mat4> world = world_matrices();
+
+				std::vector<std::uint32_t> mesh_nodes;
+				for (std::uint32_t i = 0; i < nodes_vec.size(); ++i)
+				{
+					if (nodes_vec[i].has_mesh)
+						mesh_nodes.push_back(i);
+				}
+
+				std::vector<std::array<float, 3>> min_bounds(mesh_nodes.size());
+				std::vector<std::array<float, 3>> max_bounds(mesh_nodes.size());
+
+				std::vector<std::size_t> slots(mesh_nodes.size());
+				for (std::size_t i = 0; i < slots.size(); ++i)
+					slots[i] = i;
+
+				std::for_each(std::execution::par, std::begin(slots), std::end(slots),
+					[&](std::size_t slot)
+				{
+					const std::uint32_t node_index = mesh_nodes[slot];
+					const meshes_struct& mesh = meshes_vec[nodes_vec[node_index].mesh_index];
+
+					// union of the position accessor bounds, in the mesh's local space
+					std::array<double, 3> local_min = { std::numeric_limits<double>::max(),
+						std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+					std::array<double, 3> local_max = { std::numeric_limits<double>::lowest(),
+						std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest() };
+					bool has_bounds = false;
+
+					for (const primitives_struct& primitive : mesh.primitives_vec)
+					{
+						if (!primitive.has_position || !accessors_vec[primitive.position_index].has_min_max)
+							continue;
+
+						const accessors_struct& accessor = accessors_vec[primitive.position_index];
+						has_bounds = true;
+						for (std::size_t axis = 0; axis < 3; ++axis)
+						{
+							local_min[axis] = std::min(local_min[axis], accessor.min_bounds[axis]);
+							local_max[axis] = std::max(local_max[axis], accessor.max_bounds[axis]);
+						}
+					}
+
+					if (has_bounds)
+						detail::transform_aabb(world[node_index], local_min, local_max,
+							min_bounds[slot], max_bounds[slot]);
+					else
+					{
+						// nothing to go on, the node is a point at its origin
+						for (std::size_t axis = 0; axis < 3; ++axis)
+						{
+							min_bounds[slot][axis] = static_cast<float>(world[node_index][12 + axis]);
+							max_bounds[slot][axis] = min_bounds[slot][axis];
+						}
+					}
+				});
+
+				return knu::graphics::build_scene_bvh(mesh_nodes, min_bounds, max_bounds);
 			}
 
 		private:
@@ -51,7 +487,7 @@ namespace knu
 				FLOAT = 5126
 			};
 			enum data_type { SCALAR, VEC2, VEC3, VEC4, MAT2, MAT3, MAT4 };
-			enum buffer_target { ARRAY_BUFFER = 34962, ELEMENT_ARRAY_BUFFER = 34963 };
+			enum buffer_target { NO_TARGET = 0, ARRAY_BUFFER = 34962, ELEMENT_ARRAY_BUFFER = 34963 };
 			enum rendering_mode {
 				POINTS, LINES, LINE_LOOP, LINE_STRIP, TRIANGLES,
 				TRIANGLE_STRIP, TRIANGLE_FAN
@@ -72,6 +508,15 @@ namespace knu
 				std::array<double, 3> min_bounds;
 				std::array<double, 3> max_bounds;
 				data_type d_type;
+
+				// sparse accessors replace sparse_count elements of the bufferView (or of zeros, when
+				// there is no bufferView) with the values at the indices
+				std::size_t sparse_count;		// 0 when the accessor is not sparse
+				std::size_t sparse_indices_view;
+				std::size_t sparse_indices_offset;
+				component_type sparse_indices_type;		// UBYTE, USHORT or UINT
+				std::size_t sparse_values_view;
+				std::size_t sparse_values_offset;
 			};
 
 			struct asset_struct
@@ -92,7 +537,8 @@ namespace knu
 				std::uint32_t buffer_index;
 				std::size_t byte_length;
 				std::uint32_t byte_offset;
-				buffer_target target;
+				std::uint32_t byte_stride;		// 0 when the data is tightly packed
+				buffer_target target = NO_TARGET;
 			};
 
 			struct pbr_metallic_roughness_struct
@@ -105,6 +551,7 @@ namespace knu
 			struct materials_struct
 			{
 				std::string material_name;
+				std::string alpha_mode = "OPAQUE";		// OPAQUE, MASK or BLEND
 				pbr_metallic_roughness_struct material_roughness;
 			};
 
@@ -112,9 +559,14 @@ namespace knu
 			{
 				bool has_position = false;
 				bool has_normal = false;
+				bool has_tangent = false;
 
 				int position_index;
 				int normal_index;
+				int tangent_index;
+				std::vector<int> texcoord_indices;	// TEXCOORD_0, TEXCOORD_1, ... up to the first one missing
+				std::vector<std::pair<gltf_semantic, int>> other_attributes;	// semantic and accessor of the rest
+				std::vector<std::array<int, 3>> targets;	// POSITION, NORMAL and TANGENT accessor of every morph target, -1 when missing
 
 				int indices_ref;
 				int materials_ref;
@@ -125,19 +577,54 @@ namespace knu
 			{
 				std::string mesh_name;
 				std::vector<primitives_struct> primitives_vec;
+				std::vector<float> weights;		// default morph target weights
 			};
 
 			struct nodes_struct
 			{
 				std::string node_name;
+				std::vector<int> children;
 				bool has_mesh = false;
 				int mesh_index = -1;
+				int skin_index = -1;
+				bool has_matrix = false;
+				double matrix[16];		// column major, replaces rotation, translation and scale when present
 				bool has_rotation = false;
 				double rotation[4] = { 0.0, 0.0, 0.0, 1.0 };	// unit quaternion in [vec3, w]
 				bool has_translation = false;
 				double translation[3] = { 0.0, 0.0, 0.0 };
 				bool has_scale = false;
 				double scale[3] = { 1.0, 1.0, 1.0 };
+				std::vector<float> weights;		// morph target weights, replace the mesh's when present
+			};
+
+			struct animation_samplers_struct
+			{
+				int input = -1;		// accessor of the key times
+				int output = -1;	// accessor of the values
+				gltf_interpolation interpolation = gltf_interpolation::linear;
+			};
+
+			struct animation_channels_struct
+			{
+				int sampler = -1;
+				int node = -1;		// no node means the channel is ignored
+				gltf_animation_path path = gltf_animation_path::translation;
+			};
+
+			struct skins_struct
+			{
+				std::string skin_name;
+				std::vector<int> joints;
+				int inverse_bind_matrices = -1;		// accessor of MAT4s
+				int skeleton = -1;
+			};
+
+			struct animations_struct
+			{
+				std::string animation_name;
+				std::vector<animation_samplers_struct> samplers;
+				std::vector<animation_channels_struct> channels;
 			};
 
 		private:
@@ -149,12 +636,77 @@ namespace knu
 					[=](const nodes_struct & n) {return n.node_name == node_name; });
 			}
 
-			std::vector<std::uint16_t> get_indices(const primitives_struct& ps)
+			detail::mat4 local_matrix(const nodes_struct& n) const
+			{
+				if (n.has_matrix)
+				{
+					detail::mat4 m;
+					std::copy(std::begin(n.matrix), std::end(n.matrix), std::begin(m));
+					return m;
+				}
+
+				return detail::compose_trs(std::array<double, 3>{ n.translation[0], n.translation[1], n.translation[2] },
+					std::array<double, 4>{ n.rotation[0], n.rotation[1], n.rotation[2], n.rotation[3] },
+					std::array<double, 3>{ n.scale[0], n.scale[1], n.scale[2] });
+			}
+
+			// the world matrix of every node, walking down from the nodes that are nobody's child
+			std::vector<detail::mat4> world_matrices() const
+			{
+				std::vector<detail::mat4> locals;
+				for (const nodes_struct& n : nodes_vec)
+					locals.push_back(local_matrix(n));
+
+				return world_matrices(locals);
+			}
+
+			std::vector<detail::mat4> world_matrices(const std::vector<detail::mat4>& locals) const
+			{
+				std::vector<detail::mat4> world(nodes_vec.size(), detail::identity_matrix());
+				std::vector<bool> is_child(nodes_vec.size(), false);
+
+				// children out of range are skipped, and a node is only visited once so a file with a
+				// cycle still ends
+				auto valid_child = [this](int child) { return child >= 0 && std::size_t(child) < nodes_vec.size(); };
+				for (const nodes_struct& n : nodes_vec)
+					for (int child : n.children)
+						if (valid_child(child))
+							is_child[child] = true;
+
+				std::vector<std::pair<std::size_t, detail::mat4>> stack;
+				for (std::size_t i = 0; i < nodes_vec.size(); ++i)
+				{
+					if (!is_child[i])
+						stack.emplace_back(i, detail::identity_matrix());
+				}
+
+				std::vector<bool> visited(nodes_vec.size(), false);
+				while (!stack.empty())
+				{
+					auto [index, parent] = stack.back();
+					stack.pop_back();
+					if (visited[index])
+						continue;
+
+					visited[index] = true;
+					world[index] = detail::multiply(parent, locals[index]);
+					for (int child : nodes_vec[index].children)
+						if (valid_child(child) && !visited[child])
+							stack.emplace_back(child, world[index]);
+				}
+
+				return world;
+			}
+
+			// the indices widened to 32 bits, gltf allows UBYTE, USHORT and UINT
+			std::vector<std::uint32_t> get_indices(const primitives_struct& ps)
 			{
 				const int accessor_index = ps.indices_ref;
+				if (accessor_index < 0)
+					return {};		// not indexed, the vertices are drawn in order
 
-				// for indices, c_type should be USHORT (5123)
-				assert(USHORT == accessors_vec[accessor_index].c_type);
+				const std::uint32_t c_type = accessors_vec[accessor_index].c_type;
+				assert(UBYTE == c_type || USHORT == c_type || UINT == c_type);
 
 				const std::uint32_t indices_count = accessors_vec[accessor_index].count;
 				const std::int32_t buffer_view_index = accessors_vec[accessor_index].buffer_view_ref;
@@ -168,48 +720,151 @@ namespace knu
 
 				const std::uint32_t offset = accessor_byte_offset + buffer_views_byte_offset;
 
-				std::uint8_t * base_ptr = buffers_vec[buffer_index].data.data();
-				std::uint16_t * start = reinterpret_cast<std::uint16_t*>(base_ptr);
-				std::uint16_t * last = start + indices_count;
+				const std::uint8_t * base_ptr = buffers_vec[buffer_index].data.data() + offset;
+				std::vector<std::uint32_t> indices(indices_count);
+
+				switch (c_type)
+				{
+				case UBYTE:
+					std::copy(base_ptr, base_ptr + indices_count, std::begin(indices));
+					break;
+				case USHORT:
+					for (std::uint32_t i = 0; i < indices_count; ++i)
+					{
+						std::uint16_t index;
+						std::memcpy(&index, base_ptr + i * sizeof(index), sizeof(index));
+						indices[i] = index;
+					}
+					break;
+				default:
+					std::memcpy(indices.data(), base_ptr, indices_count * sizeof(std::uint32_t));
+					break;
+				}
+
+				return indices;
+			}
 
-				return std::vector<std::uint16_t>{start, last};
+			static std::uint32_t component_size(component_type c_type)
+			{
+				switch (c_type)
+				{
+				case BYTE: case UBYTE: return 1;
+				case SHORT: case USHORT: return 2;
+				default: return 4;
+				}
 			}
 
-			gltf_component_info get_component_info(std::uint32_t accessor_index)
+			bool is_dense(const accessors_struct& accessor) const
 			{
-				const accessors_struct& accessor_ref = accessors_vec[accessor_index];
-				const buffer_views_struct& buffer_views_ref = buffer_views_vec[accessor_ref.buffer_view_ref];
+				return accessor.sparse_count == 0 && accessor.buffer_view_ref != static_cast<std::size_t>(-1);
+			}
+
+			// the elements of a sparse accessor, or of one without a bufferView, tightly packed. Elements the
+			// buffers are too short for stay zero
+			gltf_buffer dense_accessor(const accessors_struct& accessor, std::uint32_t element_size) const
+			{
+				const std::size_t byte_length = accessor.count * element_size;
+				gltf_buffer dense{ byte_length, std::vector<std::uint8_t>(byte_length, 0) };
+
+				if (accessor.buffer_view_ref != static_cast<std::size_t>(-1))
+				{
+					const buffer_views_struct& view = buffer_views_vec[accessor.buffer_view_ref];
+					const std::vector<std::uint8_t>& data = buffers_vec[view.buffer_index].data;
+					const std::size_t offset = view.byte_offset + accessor.byte_offset;
+					const std::size_t stride = view.byte_stride != 0 ? view.byte_stride : element_size;
+					for (std::size_t i = 0; i < accessor.count && offset + i * stride + element_size <= data.size(); ++i)
+						std::memcpy(dense.data.data() + i * element_size, data.data() + offset + i * stride, element_size);
+				}
+
+				if (accessor.sparse_count != 0)
+				{
+					const buffer_views_struct& indices_view = buffer_views_vec[accessor.sparse_indices_view];
+					const buffer_views_struct& values_view = buffer_views_vec[accessor.sparse_values_view];
+					const std::vector<std::uint8_t>& indices_data = buffers_vec[indices_view.buffer_index].data;
+					const std::vector<std::uint8_t>& values_data = buffers_vec[values_view.buffer_index].data;
+					const std::size_t indices_offset = indices_view.byte_offset + accessor.sparse_indices_offset;
+					const std::size_t values_offset = values_view.byte_offset + accessor.sparse_values_offset;
+					const std::uint8_t* indices = indices_data.data() + indices_offset;
+					const std::uint8_t* values = values_data.data() + values_offset;
+					const std::uint32_t index_size = component_size(accessor.sparse_indices_type);
+
+					for (std::size_t i = 0; i < accessor.sparse_count; ++i)
+					{
+						if (indices_offset + (i + 1) * index_size > indices_data.size()
+							|| values_offset + (i + 1) * element_size > values_data.size())
+							break;
+
+						std::uint32_t index = 0;
+						switch (index_size)
+						{
+						case 1: index = indices[i]; break;
+						case 2: { std::uint16_t v; std::memcpy(&v, indices + i * 2, 2); index = v; } break;
+						default: std::memcpy(&index, indices + i * 4, 4); break;
+						}
+
+						if (index < accessor.count)
+							std::memcpy(dense.data.data() + std::size_t(index) * element_size, values + i * element_size, element_size);
+					}
+				}
+
+				return dense;
+			}
 
-				const std::size_t buffer_index = buffer_views_ref.buffer_index;
-				const std::size_t byte_offset = accessor_ref.byte_offset + buffer_views_ref.byte_offset;
+			// buffers is where the info points to, accessors that are sparse or have no bufferView are
+			// made dense into a buffer appended to it
+			template <typename Real>
+			basic_gltf_component_info<Real> get_component_info(std::uint32_t accessor_index, std::vector<gltf_buffer>& buffers)
+			{
+				const accessors_struct& accessor_ref = accessors_vec[accessor_index];
 				const std::uint32_t component_type = accessor_ref.c_type;
 
-				std::array<double, 3> min_bounds = { 0, 0, 0 };
-				std::array<double, 3> max_bounds = { 0, 0, 0 };
+				std::array<Real, 3> min_bounds = { 0, 0, 0 };
+				std::array<Real, 3> max_bounds = { 0, 0, 0 };
 
 				if (accessor_ref.has_min_max)
 				{
-					min_bounds = accessor_ref.min_bounds;
-					max_bounds = accessor_ref.max_bounds;
+					// the accessor always keeps doubles, narrow them to what the caller asked for
+					for (std::size_t i = 0; i < 3; ++i)
+					{
+						min_bounds[i] = static_cast<Real>(accessor_ref.min_bounds[i]);
+						max_bounds[i] = static_cast<Real>(accessor_ref.max_bounds[i]);
+					}
 				}
 
 				std::size_t component_count = 0;
 				switch (accessor_ref.d_type)
 				{
+				case data_type::SCALAR:	component_count = 1; break;		// custom attributes can be
 				case data_type::VEC2:	component_count = 2; break;
 				case data_type::VEC3:	component_count = 3; break;
 				case data_type::VEC4:	component_count = 4; break;
+				case data_type::MAT4:	component_count = 16; break;	// no column padding for any type
 				default: {
 					// what????!!
 					throw std::runtime_error("Unsupported data type specified");
 				}break;
 				}
 
-				gltf_component_info info;
-				info.buffer_index = buffer_index;
-				info.byte_offset = byte_offset;
+				basic_gltf_component_info<Real> info;
+				if (is_dense(accessor_ref))
+				{
+					const buffer_views_struct& buffer_views_ref = buffer_views_vec[accessor_ref.buffer_view_ref];
+					info.buffer_index = buffer_views_ref.buffer_index;
+					info.byte_offset = static_cast<std::uint32_t>(accessor_ref.byte_offset + buffer_views_ref.byte_offset);
+					info.byte_stride = buffer_views_ref.byte_stride;
+				}
+				else
+				{
+					info.buffer_index = static_cast<std::uint32_t>(buffers.size());
+					info.byte_offset = 0;
+					info.byte_stride = 0;
+					buffers.emplace_back(dense_accessor(accessor_ref,
+						component_size(accessor_ref.c_type) * static_cast<std::uint32_t>(component_count)));
+				}
+
 				info.component_count = component_count;
 				info.component_type = component_type;
+				info.count = static_cast<std::uint32_t>(accessor_ref.count);
 				info.min_bounds = min_bounds;
 				info.max_bounds = max_bounds;
 				info.valid = true;	// confirm that the info here is good
@@ -217,6 +872,24 @@ namespace knu
 				return info;
 			}
 
+			// get_component_info, but the elements are always copied tightly packed into a buffer appended
+			// to buffers, so the info does not point into the file's buffers
+			template <typename Real>
+			basic_gltf_component_info<Real> get_owned_component_info(std::uint32_t accessor_index, std::vector<gltf_buffer>& buffers)
+			{
+				const accessors_struct& accessor_ref = accessors_vec[accessor_index];
+				basic_gltf_component_info<Real> info = get_component_info<Real>(accessor_index, buffers);
+				if (is_dense(accessor_ref))
+				{
+					info.buffer_index = static_cast<std::uint32_t>(buffers.size());
+					info.byte_offset = 0;
+					info.byte_stride = 0;
+					buffers.emplace_back(dense_accessor(accessor_ref, component_size(accessor_ref.c_type) * info.component_count));
+				}
+
+				return info;
+			}
+
 		private:
 			std::vector<accessors_struct> accessors_vec;
 			asset_struct asset;
@@ -225,9 +898,24 @@ namespace knu
 			std::vector<materials_struct> materials_vec;
 			std::vector<meshes_struct> meshes_vec;
 			std::vector<nodes_struct> nodes_vec;
+			std::vector<animations_struct> animations_vec;
+			std::vector<skins_struct> skins_vec;
 			std::string model_file_str;
 			std::string model_path_str;
 
+			// triangle hierarchies already built, keyed by mesh index, primitive index and every build
+			// option (any stage before the hierarchy may change the triangles or their order). Nodes of
+			// either precision can share them
+			using triangle_bvh_key = std::tuple<int, std::size_t, std::string>;
+			std::map<triangle_bvh_key, std::shared_ptr<const gltf_triangle_bvh>> triangle_bvh_cache;
+
+			// nodes handed out by build_shared_node, keyed by node index and every build option, one
+			// map per precision
+			using node_cache_key = std::pair<std::size_t, std::string>;
+			template <typename Real>
+			using node_cache = std::map<node_cache_key, std::shared_ptr<const basic_gltf_node<Real>>>;
+			std::tuple<node_cache<double>, node_cache<float>> node_caches;
+
 		private:
 
 			void open_gltf_file(std::string gltf_file, std::string relative_path)
@@ -260,12 +948,14 @@ namespace knu
 			void parse_json(json j)
 			{
 				const std::string GLTF_ACCESSORS = "accessors";
+				const std::string GLTF_ANIMATIONS = "animations";
 				const std::string GLTF_ASSET = "asset";
 				const std::string GLTF_BUFFER_VIEWS = "bufferViews";
 				const std::string GLTF_BUFFERS = "buffers";
 				const std::string GLTF_MATERIALS = "materials";
 				const std::string GLTF_MESHES = "meshes";
 				const std::string GLTF_NODES = "nodes";
+				const std::string GLTF_SKINS = "skins";
 
 				json::iterator iter = std::begin(j);
 				json::iterator last = std::end(j);
@@ -275,12 +965,14 @@ namespace knu
 					const std::string current_key = iter.key();
 
 					if (GLTF_ACCESSORS == current_key) { parse_accessors(iter.value()); }
+					if (GLTF_ANIMATIONS == current_key) { parse_animations(iter.value()); }
 					if (GLTF_ASSET == current_key) { parse_asset(iter.value()); }
 					if (GLTF_BUFFER_VIEWS == current_key) { parse_buffer_views(iter.value()); }
 					if (GLTF_BUFFERS == current_key) { parse_buffers(iter.value()); }
 					if (GLTF_MATERIALS == current_key) { parse_materials2(iter.value()); }
 					if (GLTF_MESHES == current_key) { parse_meshes2(iter.value()); }
 					if (GLTF_NODES == current_key) { parse_nodes(iter.value()); }
+					if (GLTF_SKINS == current_key) { parse_skins(iter.value()); }
 
 					++iter;
 				}
@@ -300,6 +992,7 @@ namespace knu
 				const std::string min_key = "min";
 				const std::string max_key = "max";
 				const std::string type_key = "type";
+				const std::string sparse_key = "sparse";
 
 				accessors_struct accessors;
 
@@ -355,8 +1048,10 @@ namespace knu
 					if (min_bound_iter != iter->end() && accessors.d_type != SCALAR)
 					{
 						accessors.has_min_max = true;
+						// VEC2 accessors (texture coordinates) only have two bounds
 						json::value_type min_val = min_bound_iter.value();
-						accessors.min_bounds = { min_val[0], min_val[1], min_val[2] };
+						for (std::size_t i = 0; i < min_val.size() && i < 3; ++i)
+							accessors.min_bounds[i] = min_val[i];
 
 						// there should be a max key
 						json::iterator max_bound_iter = iter->find(max_key);
@@ -364,10 +1059,27 @@ namespace knu
 						if (max_bound_iter != iter->end())
 						{
 							json::value_type max_val = max_bound_iter.value();
-							accessors.max_bounds = { max_val[0], max_val[1], max_val[2] };
+							for (std::size_t i = 0; i < max_val.size() && i < 3; ++i)
+								accessors.max_bounds[i] = max_val[i];
 						}
 					}
 
+					json::iterator sparse_iter = iter->find(sparse_key);
+					if (sparse_iter != iter->end())
+					{
+						json::value_type sparse_val = sparse_iter.value();
+						accessors.sparse_count = sparse_val.value(count_key, static_cast<std::size_t>(0));
+
+						json::value_type indices_val = sparse_val.value("indices", json::object());
+						accessors.sparse_indices_view = indices_val.value(buffer_view_key, static_cast<std::size_t>(0));
+						accessors.sparse_indices_offset = indices_val.value(byte_offset_key, static_cast<std::size_t>(0));
+						accessors.sparse_indices_type = static_cast<component_type>(indices_val.value(component_type_key, static_cast<int>(UINT)));
+
+						json::value_type values_val = sparse_val.value("values", json::object());
+						accessors.sparse_values_view = values_val.value(buffer_view_key, static_cast<std::size_t>(0));
+						accessors.sparse_values_offset = values_val.value(byte_offset_key, static_cast<std::size_t>(0));
+					}
+
 					accessors_vec.emplace_back(accessors);
 
 					++iter;
@@ -393,12 +1105,14 @@ namespace knu
 				const std::string byte_length_key = "byteLength";
 				const std::string byte_offset_key = "byteOffset";
 				const std::string target_key = "target";
+				const std::string byte_stride_key = "byteStride";
 
 				while (iter != last)
 				{
 					auto buf = iter->value(buffer_key, std::uint32_t(0));
 					auto bl = iter->value(byte_length_key, std::size_t(0));
 					auto bo = iter->value(byte_offset_key, std::uint32_t(0));
+					auto bst = iter->value(byte_stride_key, std::uint32_t(0));
 					auto tar = iter->value(target_key, int(0));
 
 					buffer_views_struct bvs;
@@ -412,6 +1126,7 @@ namespace knu
 					bvs.buffer_index = buf;
 					bvs.byte_length = bl;
 					bvs.byte_offset = bo;
+					bvs.byte_stride = bst;
 
 					buffer_views_vec.emplace_back(bvs);
 
@@ -477,6 +1192,7 @@ namespace knu
 				const std::string base_color_factor_key = "baseColorFactor";
 				const std::string metallic_factor_key = "metallicFactor";
 				const std::string roughness_factor_key = "roughnessFactor";
+				const std::string alpha_mode_key = "alphaMode";
 
 				while (materials_iter_begin != materials_iter_end)
 				{
@@ -484,6 +1200,7 @@ namespace knu
 					materials_struct& materials_ref = materials_vec.back();
 
 					materials_ref.material_name = materials_iter_begin->value(name_key, "");
+					materials_ref.alpha_mode = materials_iter_begin->value(alpha_mode_key, "OPAQUE");
 
 					json::iterator pbr_iter = materials_iter_begin->find(pbr_metallic_roughness_key);
 
@@ -521,7 +1238,10 @@ namespace knu
 				const std::string materials_key = "material";
 				const std::string normal_key = "NORMAL";
 				const std::string position_key = "POSITION";
-				const std::string texture_key = "TEXTURE";
+				const std::string tangent_key = "TANGENT";
+				const std::string texcoord_key = "TEXCOORD_";
+				const std::string targets_key = "targets";
+				const std::string weights_key = "weights";
 
 				const int no_value = -1;
 
@@ -535,6 +1255,10 @@ namespace knu
 
 					meshes_ref.mesh_name = mesh_iter_begin->value(name_key, "");
 
+					json::iterator weights_iter = mesh_iter_begin->find(weights_key);
+					if (weights_iter != mesh_iter_begin->end())
+						meshes_ref.weights = weights_iter.value().get<std::vector<float>>();
+
 					json::iterator primitives = mesh_iter_begin->find(primitives_key);
 
 					auto primitives_iter_begin = primitives->begin();
@@ -576,8 +1300,39 @@ namespace knu
 							if (primitives_ref.normal_index != no_value)
 								primitives_ref.has_normal = true;
 
-							// I guess here would be the setup for texture coordinates
+							primitives_ref.tangent_index = attributes_iter->value(tangent_key, no_value);
+
+							if (primitives_ref.tangent_index != no_value)
+								primitives_ref.has_tangent = true;
+
+							for (int set = 0;; ++set)
+							{
+								const int texcoord_index = attributes_iter->value(texcoord_key + std::to_string(set), no_value);
+								if (texcoord_index == no_value)
+									break;
+
+								primitives_ref.texcoord_indices.push_back(texcoord_index);
+							}
 
+							// everything without a field of its own, by interned semantic
+							for (auto& attribute : attributes_iter->items())
+							{
+								const std::string& semantic = attribute.key();
+								if (semantic == position_key || semantic == normal_key || semantic == tangent_key
+									|| semantic.compare(0, texcoord_key.size(), texcoord_key) == 0)
+									continue;
+
+								primitives_ref.other_attributes.emplace_back(gltf_semantic_id(semantic), attribute.value().get<int>());
+							}
+						}
+
+						// morph targets only displace POSITION, NORMAL and TANGENT
+						json::iterator targets_iter = primitives_iter_begin->find(targets_key);
+						if (targets_iter != primitives_iter_begin->end())
+						{
+							for (auto& target : *targets_iter)
+								primitives_ref.targets.push_back({ target.value(position_key, no_value),
+									target.value(normal_key, no_value), target.value(tangent_key, no_value) });
 						}
 
 						++primitives_iter_begin;
@@ -587,6 +1342,97 @@ namespace knu
 				}
 			}
 
+			void parse_animations(json::value_type val)
+			{
+				if (!val.is_array())
+					return;
+
+				const std::string name_key = "name";
+				const std::string samplers_key = "samplers";
+				const std::string channels_key = "channels";
+				const std::string input_key = "input";
+				const std::string output_key = "output";
+				const std::string interpolation_key = "interpolation";
+				const std::string sampler_key = "sampler";
+				const std::string target_key = "target";
+				const std::string node_key = "node";
+				const std::string path_key = "path";
+
+				for (auto& animation : val)
+				{
+					animations_vec.emplace_back(animations_struct{});
+					animations_struct& animation_ref = animations_vec.back();
+					animation_ref.animation_name = animation.value(name_key, "");
+
+					auto samplers_iter = animation.find(samplers_key);
+					if (samplers_iter != animation.end())
+					{
+						for (auto& sampler : *samplers_iter)
+						{
+							animation_samplers_struct ss;
+							ss.input = sampler.value(input_key, -1);
+							ss.output = sampler.value(output_key, -1);
+
+							const std::string interpolation = sampler.value(interpolation_key, "LINEAR");
+							if (interpolation == "STEP")
+								ss.interpolation = gltf_interpolation::step;
+							else if (interpolation == "CUBICSPLINE")
+								ss.interpolation = gltf_interpolation::cubic_spline;
+
+							animation_ref.samplers.push_back(ss);
+						}
+					}
+
+					auto channels_iter = animation.find(channels_key);
+					if (channels_iter != animation.end())
+					{
+						for (auto& channel : *channels_iter)
+						{
+							animation_channels_struct cs;
+							cs.sampler = channel.value(sampler_key, -1);
+
+							auto target_iter = channel.find(target_key);
+							if (target_iter != channel.end())
+							{
+								cs.node = target_iter->value(node_key, -1);
+
+								const std::string path = target_iter->value(path_key, "");
+								if (path == "rotation")
+									cs.path = gltf_animation_path::rotation;
+								else if (path == "scale")
+									cs.path = gltf_animation_path::scale;
+								else if (path == "weights")
+									cs.path = gltf_animation_path::weights;
+								else if (path != "translation")
+									cs.node = -1;	// a path from an extension
+							}
+
+							animation_ref.channels.push_back(cs);
+						}
+					}
+				}
+			}
+
+			void parse_skins(json::value_type val)
+			{
+				if (!val.is_array())
+					return;
+
+				for (auto& skin : val)
+				{
+					skins_struct ss;
+					ss.skin_name = skin.value("name", "");
+					ss.inverse_bind_matrices = skin.value("inverseBindMatrices", -1);
+					ss.skeleton = skin.value("skeleton", -1);
+
+					auto joints_iter = skin.find("joints");
+					if (joints_iter != skin.end())
+						ss.joints = joints_iter->get<std::vector<int>>();
+
+					skins_vec.push_back(ss);
+				}
+			}
+
 			void parse_nodes(json::value_type val)
 			{
 				if (val.is_array())
@@ -600,9 +1446,13 @@ namespace knu
 
 				const std::string name_key = "name";
 				const std::string mesh_key = "mesh";
+				const std::string skin_key = "skin";
 				const std::string rotation_key = "rotation";
 				const std::string translation_key = "translation";
 				const std::string scale_key = "scale";
+				const std::string matrix_key = "matrix";
+				const std::string children_key = "children";
+				const std::string weights_key = "weights";
 				const int no_mesh_val = -1;		// to represent this node has no mesh
 
 				while (b != e)
@@ -612,6 +1462,8 @@ namespace knu
 					std::string node_name = b->value(name_key, "");
 					nodes_vec.back().node_name = node_name;
 
+					nodes_vec.back().skin_index = b->value(skin_key, -1);
+
 					int mesh_index = b->value(mesh_key, no_mesh_val);
 					if (no_mesh_val != mesh_index)
 					{
@@ -663,6 +1515,24 @@ namespace knu
 						nodes_vec.back().translation[2] = c;
 					}
 
+					// a matrix is the alternative to rotation, translation and scale
+					json::iterator matrix_iter = b->find(matrix_key);
+					if (matrix_iter != b->end())
+					{
+						nodes_vec.back().has_matrix = true;
+						json::value_type val = matrix_iter.value();
+						for (std::size_t i = 0; i < 16; ++i)
+							nodes_vec.back().matrix[i] = val[i];
+					}
+
+					json::iterator children_iter = b->find(children_key);
+					if (children_iter != b->end())
+						nodes_vec.back().children = children_iter.value().get<std::vector<int>>();
+
+					json::iterator weights_iter = b->find(weights_key);
+					if (weights_iter != b->end())
+						nodes_vec.back().weights = weights_iter.value().get<std::vector<float>>();
+
 					// advance the iterator
 					++b;
 				}
@@ -670,13 +1540,14 @@ namespace knu
 
 		private:
 			// the gltf functions for building an object go here
-			void load_glft_transformation(std::vector<nodes_struct>::iterator iter, gltf_node & node)
+			template <typename Real>
+			void load_glft_transformation(std::vector<nodes_struct>::iterator iter, basic_gltf_node<Real> & node)
 			{
 				if (iter->has_scale)
 				{
-					node.scale[0] = iter->scale[0];
-					node.scale[1] = iter->scale[1];
-					node.scale[2] = iter->scale[2];
+					node.scale[0] = static_cast<Real>(iter->scale[0]);
+					node.scale[1] = static_cast<Real>(iter->scale[1]);
+					node.scale[2] = static_cast<Real>(iter->scale[2]);
 				}
 				else
 				{
@@ -687,9 +1558,9 @@ namespace knu
 
 				if (iter->has_translation)
 				{
-					node.translation[0] = iter->translation[0];
-					node.translation[1] = iter->translation[1];
-					node.translation[2] = iter->translation[1];
+					node.translation[0] = static_cast<Real>(iter->translation[0]);
+					node.translation[1] = static_cast<Real>(iter->translation[1]);
+					node.translation[2] = static_cast<Real>(iter->translation[2]);
 				}
 				else
 				{
@@ -701,10 +1572,10 @@ namespace knu
 				if (iter->has_rotation)
 				{
 					// unit quaternion in form [vec3, w]
-					node.rotation[0] = iter->rotation[0];
-					node.rotation[1] = iter->rotation[1];
-					node.rotation[2] = iter->rotation[2];
-					node.rotation[3] = iter->rotation[3];
+					node.rotation[0] = static_cast<Real>(iter->rotation[0]);
+					node.rotation[1] = static_cast<Real>(iter->rotation[1]);
+					node.rotation[2] = static_cast<Real>(iter->rotation[2]);
+					node.rotation[3] = static_cast<Real>(iter->rotation[3]);
 				}
 				else
 				{
@@ -716,7 +1587,8 @@ namespace knu
 				}
 			}
 
-			void load_gltf_mesh(const meshes_struct & m, gltf_node & node)
+			template <typename Real>
+			void load_gltf_mesh(const meshes_struct & m, basic_gltf_node<Real> & node, std::uint64_t attribute_mask)
 			{
 				node.mesh.mesh_name = m.mesh_name;
 
@@ -731,6 +1603,7 @@ namespace knu
 					mat_ref.base_color_factor = ms.material_roughness.base_color_factor;
 					mat_ref.metallic_factor = ms.material_roughness.metallic_factor;
 					mat_ref.roughness_factor = ms.material_roughness.roughness_factor;
+					mat_ref.alpha_mode = ms.alpha_mode;
 				});
 
 				// copy all the buffers
@@ -741,33 +1614,231 @@ namespace knu
 						bs.data });
 				});
 
+				bool split = false;
 				for (auto primitive = std::begin(m.primitives_vec); primitive != std::end(m.primitives_vec); ++primitive)
 				{
-					std::vector<std::uint16_t> indices = get_indices(*primitive);
-					node.mesh.sub_meshes.emplace_back(gltf_partial_mesh{});
-					gltf_partial_mesh& sub_mesh_ref = node.mesh.sub_meshes.back();
+					std::vector<std::uint32_t> indices = get_indices(*primitive);
+					basic_gltf_partial_mesh<Real> sub_mesh_ref;
+
+					// attributes left out of the mask are not even looked at
+					auto wanted = [attribute_mask](gltf_semantic semantic)
+					{
+						return (attribute_mask & gltf_attribute_bit(semantic)) != 0;
+					};
+
+					basic_gltf_component_info<Real> position_info;
+					if (primitive->has_position && wanted(gltf_semantics::position))
+						position_info = get_component_info<Real>(primitive->position_index, node.mesh.buffers);
 
-					gltf_component_info position_info;
-					if (primitive->has_position)
-						position_info = get_component_info(primitive->position_index);
+					basic_gltf_component_info<Real> normal_info;
+					if (primitive->has_normal && wanted(gltf_semantics::normal))
+						normal_info = get_component_info<Real>(primitive->normal_index, node.mesh.buffers);
 
-					gltf_component_info normal_info;
-					if (primitive->has_normal)
-						normal_info = get_component_info(primitive->normal_index);
+					basic_gltf_component_info<Real> tangent_info;
+					if (primitive->has_tangent && wanted(gltf_semantics::tangent))
+						tangent_info = get_component_info<Real>(primitive->tangent_index, node.mesh.buffers);
 
 					std::uint32_t material_index = primitive->materials_ref;
 
-					// future, texture coordinates
+					// sets keep their position, a set left out stays invalid
+					for (std::size_t set = 0; set < primitive->texcoord_indices.size(); ++set)
+					{
+						sub_mesh_ref.texcoord_infos.emplace_back();
+						if (wanted(gltf_semantic_id("TEXCOORD_" + std::to_string(set))))
+							sub_mesh_ref.texcoord_infos.back() = get_component_info<Real>(primitive->texcoord_indices[set], node.mesh.buffers);
+					}
+
+					for (const auto& attribute : primitive->other_attributes)
+					{
+						if (wanted(attribute.first))
+							sub_mesh_ref.attributes.set(attribute.first, get_component_info<Real>(attribute.second, node.mesh.buffers));
+					}
 
 					sub_mesh_ref.render_mode = primitive->render_mode;
 					sub_mesh_ref.material_index = material_index;
-					sub_mesh_ref.indices = indices;
 					sub_mesh_ref.position_info = position_info;
 					sub_mesh_ref.normal_info = normal_info;
+					sub_mesh_ref.tangent_info = tangent_info;
+
+					// the displacements follow the mask of the attribute they move
+					for (const std::array<int, 3>& target : primitive->targets)
+					{
+						sub_mesh_ref.targets.emplace_back();
+						basic_gltf_morph_target<Real>& target_ref = sub_mesh_ref.targets.back();
+						if (target[0] >= 0 && position_info.valid)
+							target_ref.position_info = get_component_info<Real>(target[0], node.mesh.buffers);
+						if (target[1] >= 0 && normal_info.valid)
+							target_ref.normal_info = get_component_info<Real>(target[1], node.mesh.buffers);
+						if (target[2] >= 0 && tangent_info.valid)
+							target_ref.tangent_info = get_component_info<Real>(target[2], node.mesh.buffers);
+					}
+
+					// more vertices than 16 bit indices reach, the primitive is loaded as several
+					if (!indices.empty() && *std::max_element(std::begin(indices), std::end(indices)) > 0xffff)
+					{
+						split_primitive(node.mesh, std::move(sub_mesh_ref), indices);
+						split = true;
+						continue;
+					}
+
+					sub_mesh_ref.indices.assign(std::begin(indices), std::end(indices));
+					node.mesh.sub_meshes.emplace_back(std::move(sub_mesh_ref));
 				}
+
+				// the split primitives have their own copies of the vertices
+				if (split)
+					detail::remove_unused_buffers(node.mesh);
+			}
+
+			// every build option as bytes, a cached node is only handed out for options that match in all of
+			// them. New fields of gltf_build_options have to be added here
+			static std::string options_key(const gltf_build_options & options)
+			{
+				std::string key;
+				auto append = [&key](const auto& value)
+				{
+					key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+				};
+
+				append(options.attribute_mask);
+				append(options.convert_to_lists);
+				append(options.merge_primitives);
+				append(options.stripify);
+				append(options.build_triangle_bvh);
+				append(options.quantize_vertices);
+				append(options.quantized_normal_bits);
+				append(options.generate_normals);
+				append(options.generate_tangents);
+				append(options.tangent_texcoord);
+				append(options.weld_vertices);
+				append(options.weld_epsilon);
+				append(options.optimize_vertex_cache);
+				append(options.optimize_vertex_fetch);
+				append(options.optimize_overdraw);
+				append(options.overdraw_threshold);
+				append(options.build_meshlets);
+				append(options.meshlet_max_vertices);
+				append(options.meshlet_max_triangles);
+				for (float ratio : options.lod_ratios)
+					append(ratio);
+
+				return key;
+			}
+
+			template <typename Real>
+			// mesh_index is the gltf mesh the node was loaded from, -1 for a batch of several that is not cached
+			void apply_build_options(int mesh_index, basic_gltf_node<Real> & node, const gltf_build_options & options)
+			{
+				auto& sub_meshes = node.mesh.sub_meshes;
+
+				// stages that rewrite the geometry go first, in a fixed order
+				if (options.convert_to_lists)
+					convert_to_lists(node.mesh);
+				if (options.merge_primitives)
+					merge_primitives(node.mesh);
+				if (options.generate_normals != gltf_normal_generation::none)
+					generate_normals(node.mesh, options.generate_normals);
+				if (options.generate_tangents)
+					generate_tangents(node.mesh, options.tangent_texcoord);
+				if (options.weld_vertices)
+					weld_vertices(node.mesh, options.weld_epsilon);
+				if (options.optimize_vertex_cache)
+					optimize_vertex_cache(node.mesh);
+				if (options.optimize_overdraw)
+					optimize_overdraw(node.mesh, options.overdraw_threshold);
+				if (options.optimize_vertex_fetch)
+					optimize_vertex_fetch(node.mesh);
+				if (!options.lod_ratios.empty())
+					generate_lods(node.mesh, options.lod_ratios, options.optimize_vertex_cache);
+				if (options.build_meshlets)
+					build_meshlets(node.mesh, options.meshlet_max_vertices, options.meshlet_max_triangles);
+				if (options.stripify)
+					stripify(node.mesh);
+
+				// stages that derive data from the final geometry
+				if (options.build_triangle_bvh)
+				{
+					const std::string build_key = options_key(options);
+					auto bvh_key = [&](std::size_t i) { return triangle_bvh_key{ mesh_index, i, build_key }; };
+
+					// build whatever is not cached yet in parallel, then hand out the shared copies
+					std::vector<std::size_t> missing;
+					for (std::size_t i = 0; i < sub_meshes.size(); ++i)
+					{
+						auto iter = mesh_index >= 0 ? triangle_bvh_cache.find(bvh_key(i))
+							: std::end(triangle_bvh_cache);
+						if (iter != std::end(triangle_bvh_cache))
+							sub_meshes[i].triangle_bvh = iter->second;
+						else
+							missing.push_back(i);
+					}
+
+					std::for_each(std::execution::par, std::begin(missing), std::end(missing),
+						[&node](std::size_t i)
+					{
+						node.mesh.sub_meshes[i].triangle_bvh = std::make_shared<const gltf_triangle_bvh>(
+							knu::graphics::build_triangle_bvh(node.mesh, node.mesh.sub_meshes[i]));
+					});
+
+					for (std::size_t i : missing)
+						if (mesh_index >= 0)
+							triangle_bvh_cache[bvh_key(i)] = sub_meshes[i].triangle_bvh;
+				}
+
+				// the output encoding goes last, every stage above works on the decoded attributes
+				if (options.quantize_vertices)
+					quantize_vertices(node.mesh, options.quantized_normal_bits);
 			}
 		};
 
+		namespace
+		{
+			// every semantic name seen so far, the well known ones in the order of their ids
+			struct semantic_registry
+			{
+				std::mutex mutex;
+				std::unordered_map<std::string, gltf_semantic> ids;
+				std::vector<std::string> names = { "POSITION", "NORMAL", "TANGENT", "TEXCOORD_0", "TEXCOORD_1",
+					"COLOR_0", "JOINTS_0", "WEIGHTS_0" };
+
+				semantic_registry()
+				{
+					for (gltf_semantic id = 0; id < names.size(); ++id)
+						ids.emplace(names[id], id);
+				}
+			};
+
+			semantic_registry& semantics()
+			{
+				static semantic_registry registry;
+				return registry;
+			}
+		}
+
+		gltf_semantic gltf_semantic_id(const std::string& name)
+		{
+			semantic_registry& registry = semantics();
+			std::lock_guard<std::mutex> lock{ registry.mutex };
+
+			auto iter = registry.ids.find(name);
+			if (iter != std::end(registry.ids))
+				return iter->second;
+
+			const gltf_semantic id = static_cast<gltf_semantic>(registry.names.size());
+			registry.names.push_back(name);
+			registry.ids.emplace(name, id);
+
+			return id;
+		}
+
+		std::string gltf_semantic_name(gltf_semantic semantic)
+		{
+			semantic_registry& registry = semantics();
+			std::lock_guard<std::mutex> lock{ registry.mutex };
+
+			return semantic < registry.names.size() ? registry.names[semantic] : std::string{};
+		}
+
 		gltf::gltf() :
 			impl_ptr{ std::make_unique<impl>() }
 		{}
@@ -787,23 +1858,147 @@ namespace knu
 			return impl_ptr->has_node(node_name);
 		}
 
-		std::pair<bool, gltf_node> gltf::build_node(std::string node_name)
+		std::pair<bool, gltf_node> gltf::build_node(std::string node_name,
+			const gltf_build_options& options)
 		{
 			gltf_node node;
 			if (!has_node(node_name))
 				return { false, node };
 
-			impl_ptr->build_node(node_name, node);;
+			impl_ptr->build_node(node_name, node, options);
 			return { true, node };
 		}
 
-		std::pair<bool, gltf_node> load_gltf_node(std::string model_name,
+		std::size_t gltf::animation_count()
+		{
+			return impl_ptr->animation_count();
+		}
+
+		std::string gltf::animation_name(std::size_t animation_index)
+		{
+			return impl_ptr->animation_name(animation_index);
+		}
+
+		std::pair<bool, gltf_animation> gltf::build_animation(std::string animation_name,
+			const gltf_animation_options& options)
+		{
+			gltf_animation animation;
+			const bool success = impl_ptr->build_animation(animation_name, animation, options);
+			return { success, animation };
+		}
+
+		std::size_t gltf::skin_count()
+		{
+			return impl_ptr->skin_count();
+		}
+
+		std::pair<bool, gltf_skin> gltf::build_skin(std::size_t skin_index)
+		{
+			gltf_skin skin;
+			const bool success = impl_ptr->build_skin(skin_index, skin);
+			return { success, skin };
+		}
+
+		std::vector<std::array<double, 16>> gltf::world_transforms(const gltf_animation* animation, const float* values)
+		{
+			return impl_ptr->world_transforms(animation, values);
+		}
+
+		std::size_t gltf::node_count()
+		{
+			return impl_ptr->node_count();
+		}
+
+		std::string gltf::node_name(std::size_t node_index)
+		{
+			return impl_ptr->node_name(node_index);
+		}
+
+		std::pair<bool, gltf_node> gltf::build_static_batch(const std::vector<std::string>& node_names,
+			const gltf_build_options& options)
+		{
+			gltf_node node;
+			const bool success = impl_ptr->build_static_batch(node_names, node, options);
+			return { success, node };
+		}
+
+		std::pair<bool, gltf_node_f> gltf::build_static_batch_f(const std::vector<std::string>& node_names,
+			const gltf_build_options& options)
+		{
+			gltf_node_f node;
+			const bool success = impl_ptr->build_static_batch(node_names, node, options);
+			return { success, node };
+		}
+
+		std::pair<bool, gltf_node> gltf::build_static_batch(const std::vector<std::size_t>& node_indices,
+			const gltf_build_options& options)
+		{
+			gltf_node node;
+			const bool success = impl_ptr->build_static_batch(node_indices, node, options);
+			return { success, node };
+		}
+
+		std::pair<bool, gltf_node_f> gltf::build_static_batch_f(const std::vector<std::size_t>& node_indices,
+			const gltf_build_options& options)
+		{
+			gltf_node_f node;
+			const bool success = impl_ptr->build_static_batch(node_indices, node, options);
+			return { success, node };
+		}
+
+		gltf_scene_bvh gltf::build_scene_bvh()
+		{
+			return impl_ptr->build_scene_bvh();
+		}
+
+		gltf_upload_plan gltf::plan_uploads(std::size_t gap_threshold, std::size_t alignment)
+		{
+			return impl_ptr->plan_uploads(gap_threshold, alignment);
+		}
+
+		gltf_indirect_draws gltf::build_scene_draws(const gltf_vertex_layout& layout, const gltf_build_options& options)
+		{
+			return impl_ptr->build_scene_draws(layout, options);
+		}
+
+		std::pair<bool, gltf_node_f> gltf::build_node_f(std::string node_name,
+			const gltf_build_options& options)
+		{
+			gltf_node_f node;
+			if (!has_node(node_name))
+				return { false, node };
+
+			impl_ptr->build_node(node_name, node, options);
+			return { true, node };
+		}
+
+		std::shared_ptr<const gltf_node> gltf::build_shared_node(std::string node_name,
+			const gltf_build_options& options)
+		{
+			return impl_ptr->build_shared_node<double>(node_name, options);
+		}
+
+		std::shared_ptr<const gltf_node_f> gltf::build_shared_node_f(std::string node_name,
+			const gltf_build_options& options)
+		{
+			return impl_ptr->build_shared_node<float>(node_name, options);
+		}
+
+		void gltf::clear_cache()
+		{
+			impl_ptr->clear_cache();
+		}
+
+		// shared by load_gltf_node and load_gltf_node_f
+		template <typename Real>
+		std::pair<bool, basic_gltf_node<Real>> load_basic_gltf_node(std::string model_name,
 			std::string relative_path,
-			std::string node_name)
+			std::string node_name,
+			const gltf_build_options& options)
 		{
 			using namespace std::filesystem;
 
-			gltf_node node;
+			basic_gltf_node<Real> node;
 			bool success = false;
 
 			if (!exists(path{relative_path + model_name }))
@@ -812,17 +2007,36 @@ namespace knu
 			try {
 				gltf model(model_name, relative_path);
 				if (!model.has_node(node_name))
-					return { false, gltf_node{} };
+					return { false, basic_gltf_node<Real>{} };
 
-				std::tie(success, node) = model.build_node(node_name);
+				if constexpr (std::is_same_v<Real, float>)
+					std::tie(success, node) = model.build_node_f(node_name, options);
+				else
+					std::tie(success, node) = model.build_node(node_name, options);
 			}
 			catch (std::runtime_error & e)
 			{
 				std::cerr << e.what() << "\n";
-				return { false, gltf_node{} };
+				return { false, basic_gltf_node<Real>{} };
 			}
 
 			return { success, node };
 		}
+
+		std::pair<bool, gltf_node> load_gltf_node(std::string model_name,
+			std::string relative_path,
+			std::string node_name,
+			const gltf_build_options& options)
+		{
+			return load_basic_gltf_node<double>(model_name, relative_path, node_name, options);
+		}
+
+		std::pair<bool, gltf_node_f> load_gltf_node_f(std::string model_name,
+			std::string relative_path,
+			std::string node_name,
+			const gltf_build_options& options)
+		{
+			return load_basic_gltf_node<float>(model_name, relative_path, node_name, options);
+		}
 	} // namespace graphics
 } // namespace knu
@@ -11,24 +11,218 @@ namespace knu
 	namespace graphics
 	{
 		// a struct containing information about the component (position, normal, texture coords)
-		struct gltf_component_info
+		// Real selects the storage used for the bounds, double by default or float for
+		// the compact (_f) family
+		template <typename Real>
+		struct basic_gltf_component_info
 		{
 			bool valid = false;				// use this flag to determine whether the rest of the struct is good to use
 			std::uint32_t buffer_index;
 			std::uint32_t byte_offset;
 			std::uint32_t component_type;	// unsigned int, float (compatable with OpenGL's GL_UNSIGNED_INT, GL_FLOAT and so on)
 			std::uint32_t component_count;	// should be 2 (tex), 3 (position, normal) or 4 (position)
-			std::array<double, 3> min_bounds;
-			std::array<double, 3> max_bounds;
+			std::uint32_t byte_stride;		// distance between elements, 0 means tightly packed
+			std::uint32_t count;			// number of elements
+			std::array<Real, 3> min_bounds;
+			std::array<Real, 3> max_bounds;
 		};
 
-		struct gltf_partial_mesh
+		// vertex attribute semantics (POSITION, COLOR_0, _CUSTOM, ...) are interned into small numbers,
+		// so primitives compare and store them without strings
+		using gltf_semantic = std::uint32_t;
+
+		// ids of the well known semantics, gltf_semantic_id hands out the next free ones for any other name
+		namespace gltf_semantics
+		{
+			constexpr gltf_semantic position = 0;
+			constexpr gltf_semantic normal = 1;
+			constexpr gltf_semantic tangent = 2;
+			constexpr gltf_semantic texcoord_0 = 3;
+			constexpr gltf_semantic texcoord_1 = 4;
+			constexpr gltf_semantic color_0 = 5;
+			constexpr gltf_semantic joints_0 = 6;
+			constexpr gltf_semantic weights_0 = 7;
+		}
+
+		// the id of a semantic name, a new name gets a new id. Safe to call from several threads
+		gltf_semantic gltf_semantic_id(const std::string& name);
+
+		// the name an id was interned from, empty for ids never handed out
+		std::string gltf_semantic_name(gltf_semantic semantic);
+
+		// the bit of a semantic in gltf_build_options::attribute_mask, ids past 62 share the last bit
+		constexpr std::uint64_t gltf_attribute_bit(gltf_semantic semantic)
+		{
+			return semantic < 63 ? std::uint64_t(1) << semantic : std::uint64_t(1) << 63;
+		}
+
+		// the attributes of a primitive by semantic. A few are kept in place, the vector only goes
+		// to the heap for primitives with more than inline_capacity of them
+		template <typename Real>
+		class basic_gltf_attribute_map
+		{
+		public:
+			struct entry
+			{
+				gltf_semantic semantic;
+				basic_gltf_component_info<Real> info;
+			};
+
+			static constexpr std::size_t inline_capacity = 4;
+
+			std::size_t size() const { return count; }
+			bool empty() const { return count == 0; }
+
+			entry* begin() { return heap.empty() ? local.data() : heap.data(); }
+			entry* end() { return begin() + count; }
+			const entry* begin() const { return heap.empty() ? local.data() : heap.data(); }
+			const entry* end() const { return begin() + count; }
+
+			// nullptr when the primitive has no such attribute
+			basic_gltf_component_info<Real>* find(gltf_semantic semantic)
+			{
+				for (entry& e : *this)
+					if (e.semantic == semantic) return &e.info;
+				return nullptr;
+			}
+
+			const basic_gltf_component_info<Real>* find(gltf_semantic semantic) const
+			{
+				for (const entry& e : *this)
+					if (e.semantic == semantic) return &e.info;
+				return nullptr;
+			}
+
+			// adds the attribute or replaces the one with the same semantic
+			void set(gltf_semantic semantic, const basic_gltf_component_info<Real>& info)
+			{
+				if (basic_gltf_component_info<Real>* existing = find(semantic))
+				{
+					*existing = info;
+					return;
+				}
+
+				if (heap.empty() && count < inline_capacity)
+				{
+					local[count++] = entry{ semantic, info };
+					return;
+				}
+
+				if (heap.empty())
+					heap.assign(local.begin(), local.end());
+				heap.push_back(entry{ semantic, info });
+				++count;
+			}
+
+		private:
+			std::array<entry, inline_capacity> local{};
+			std::vector<entry> heap;
+			std::size_t count = 0;
+		};
+
+		struct gltf_triangle_bvh;	// see gltf_bvh.hpp
+
+		// post transform vertex cache efficiency of an index buffer
+		struct gltf_vertex_cache_stats
+		{
+			float acmr = 0.0f;		// average cache miss ratio, transformed vertices per triangle (0.5 is ideal)
+			float atvr = 0.0f;		// average transform to vertex ratio, transformed vertices per vertex (1.0 is ideal)
+		};
+
+		struct gltf_weld_report
+		{
+			bool valid = false;		// only set when the weld stage ran on the primitive
+			std::uint32_t vertices_before = 0;
+			std::uint32_t vertices_after = 0;
+		};
+
+		// a simplified index buffer over the same vertices as the primitive it belongs to
+		struct gltf_lod
+		{
+			float ratio = 1.0f;		// triangle count compared to the full primitive
+			float error = 0.0f;		// deviation from the full primitive, relative to its bounding box diagonal
+			std::vector<std::uint16_t> indices;
+		};
+
+		// a small cluster of a primitive's triangles, for cluster culling and mesh shaders
+		struct gltf_meshlet
+		{
+			std::uint32_t vertex_offset = 0;	// first entry in gltf_meshlets::vertices
+			std::uint32_t triangle_offset = 0;	// first entry in gltf_meshlets::triangles, three per triangle
+			std::uint32_t vertex_count = 0;
+			std::uint32_t triangle_count = 0;
+
+			std::array<float, 3> center = { 0, 0, 0 };		// bounding sphere
+			float radius = 0.0f;
+
+			// every triangle faces away from a camera at c when
+			// dot(normalize(cone_apex - c), cone_axis) >= cone_cutoff, a cutoff of 1 never culls
+			std::array<float, 3> cone_apex = { 0, 0, 0 };
+			std::array<float, 3> cone_axis = { 0, 0, 0 };
+			float cone_cutoff = 1.0f;
+		};
+
+		struct gltf_meshlets
+		{
+			std::vector<gltf_meshlet> meshlets;
+			std::vector<std::uint32_t> vertices;	// the primitive's vertex index of every meshlet vertex
+			std::vector<std::uint8_t> triangles;	// micro indices into the meshlet's own vertices
+		};
+
+		// how the attributes of a quantized primitive decode, see gltf_quantize.hpp. Integer values
+		// below are normalized, unsigned ones to [0, 1] and signed ones to [-1, 1]
+		struct gltf_quantization
+		{
+			bool valid = false;		// only set when the quantize stage ran on the primitive
+
+			// position = position_offset + position_scale * value, per axis
+			std::array<float, 3> position_offset = { 0, 0, 0 };
+			std::array<float, 3> position_scale = { 1, 1, 1 };
+
+			// NORMAL and TANGENT xy are octahedral, signed and this many bits each. TANGENT z is the
+			// bitangent sign. 0 when the primitive had neither
+			std::uint32_t normal_bits = 0;
+		};
+
+		struct gltf_vertex_cache_report
+		{
+			bool valid = false;		// only set when the vertex cache stage ran on the primitive
+			gltf_vertex_cache_stats before;
+			gltf_vertex_cache_stats after;
+		};
+
+		// the displacements one morph target adds to the vertices of its primitive, an attribute the
+		// target does not move stays invalid
+		template <typename Real>
+		struct basic_gltf_morph_target
+		{
+			basic_gltf_component_info<Real> position_info;
+			basic_gltf_component_info<Real> normal_info;
+			basic_gltf_component_info<Real> tangent_info;
+		};
+
+		template <typename Real>
+		struct basic_gltf_partial_mesh
 		{
 			std::uint32_t render_mode;		// for first parameter of glDrawArrays(), GL_POINTS, GL_TRIANGLES
 			std::uint32_t material_index;
-			std::vector<std::uint16_t> indices;
-			gltf_component_info position_info;
-			gltf_component_info normal_info;
+			std::vector<std::uint16_t> indices;	// UBYTE and UINT are widened or narrowed, bigger primitives are split on load
+			basic_gltf_component_info<Real> position_info;
+			basic_gltf_component_info<Real> normal_info;
+			basic_gltf_component_info<Real> tangent_info;		// xyz is the tangent, w the sign of the bitangent
+			std::vector<basic_gltf_component_info<Real>> texcoord_infos;	// TEXCOORD_0, TEXCOORD_1, ...
+			basic_gltf_attribute_map<Real> attributes;		// everything else, COLOR_n, JOINTS_n, WEIGHTS_n, _CUSTOM
+			std::vector<basic_gltf_morph_target<Real>> targets;	// morph targets, sparse ones are made dense on load, see gltf_morph.hpp
+
+			// only filled in when requested through gltf_build_options, shared between every
+			// node built from the same gltf object
+			std::shared_ptr<const gltf_triangle_bvh> triangle_bvh;
+			gltf_vertex_cache_report vertex_cache_report;
+			gltf_weld_report weld_report;
+			std::vector<gltf_lod> lods;		// most detailed first, the primitive itself is not included
+			gltf_meshlets meshlets;
+			gltf_quantization quantization;
+			bool primitive_restart = false;	// 0xffff in indices starts a new strip, see gltf_build_options::stripify
 		};
 
 		struct gltf_buffer
@@ -43,23 +237,97 @@ namespace knu
 			std::array<double, 4> base_color_factor = { 0.0, 0.0, 0.0, 0.0 };
 			double metallic_factor = 0.0;
 			double roughness_factor = 0.0;
+			std::string alpha_mode = "OPAQUE";		// OPAQUE, MASK or BLEND
 		};
 
-		struct gltf_mesh
+		template <typename Real>
+		struct basic_gltf_mesh
 		{
 			std::string mesh_name;
-			std::vector<gltf_partial_mesh> sub_meshes;
+			std::vector<basic_gltf_partial_mesh<Real>> sub_meshes;
 			std::vector<gltf_buffer> buffers;
 			std::vector<gltf_material> materials;
 		};
 
-		struct gltf_node
+		template <typename Real>
+		struct basic_gltf_node
 		{
 			std::string node_name = {};
-			std::array<double, 3> scale = { 0, 0, 0 };
-			std::array<double, 3> translation = { 0, 0, 0 };
-			std::array<double, 4> rotation = { 0, 0, 0, 1 }; // unit quaternion in form [vec3, w]
-			gltf_mesh mesh;
+			std::array<Real, 3> scale = { 0, 0, 0 };
+			std::array<Real, 3> translation = { 0, 0, 0 };
+			std::array<Real, 4> rotation = { 0, 0, 0, 1 }; // unit quaternion in form [vec3, w]
+			int skin_index = -1;	// see gltf::build_skin, -1 for meshes that are not skinned
+			std::vector<float> weights;		// morph target weights, the node's own or else the mesh's defaults
+			basic_gltf_mesh<Real> mesh;
+		};
+
+		// double precision types, the default
+		using gltf_component_info = basic_gltf_component_info<double>;
+		using gltf_morph_target = basic_gltf_morph_target<double>;
+		using gltf_partial_mesh = basic_gltf_partial_mesh<double>;
+		using gltf_mesh = basic_gltf_mesh<double>;
+		using gltf_node = basic_gltf_node<double>;
+
+		// single precision types, half the footprint for transforms and bounds
+		using gltf_component_info_f = basic_gltf_component_info<float>;
+		using gltf_morph_target_f = basic_gltf_morph_target<float>;
+		using gltf_partial_mesh_f = basic_gltf_partial_mesh<float>;
+		using gltf_mesh_f = basic_gltf_mesh<float>;
+		using gltf_node_f = basic_gltf_node<float>;
+
+		struct gltf_scene_bvh;		// see gltf_bvh.hpp
+		struct gltf_vertex_layout;	// see gltf_interleave.hpp
+		struct gltf_indirect_draws;	// see gltf_indirect.hpp
+		struct gltf_upload_plan;	// see gltf_upload.hpp
+		struct gltf_animation;		// see gltf_animation.hpp
+		struct gltf_skin;			// see gltf_skin.hpp
+
+		// how normals are made up for primitives that have none
+		enum class gltf_normal_generation
+		{
+			none,
+			area_weighted,		// smooth, larger triangles count more
+			angle_weighted,		// smooth, by the angle of the triangle's corner, independent of tessellation
+			flat				// one normal per triangle
+		};
+
+		// optional work done by build_node once the mesh has been loaded, everything is off by default
+		struct gltf_build_options
+		{
+			// attributes to load, gltf_attribute_bit of every wanted semantic. The rest are not decoded
+			// at all, gltf_attribute_bit(gltf_semantics::position) alone is enough for collision meshes
+			std::uint64_t attribute_mask = ~std::uint64_t(0);
+
+			bool convert_to_lists = false;		// strips, fans and loops become indexed lists, see gltf_mesh_opt.hpp
+			bool merge_primitives = false;		// one primitive per material, mode and attribute set, fewer draws
+			bool stripify = false;				// the opposite, TRIANGLES become strips with restart indices
+			bool build_triangle_bvh = false;	// a triangle hierarchy per primitive, for picking and line of sight
+			bool quantize_vertices = false;		// compact interleaved vertices, always done last, see gltf_quantize.hpp
+			std::uint32_t quantized_normal_bits = 16;	// 8 or 16 per octahedral component
+			gltf_normal_generation generate_normals = gltf_normal_generation::none;	// when NORMAL is missing, see gltf_vertex_gen.hpp
+			bool generate_tangents = false;		// when TANGENT is missing, needs normals, see gltf_vertex_gen.hpp
+			std::uint32_t tangent_texcoord = 0;	// the TEXCOORD_n set the tangents follow
+			bool weld_vertices = false;			// merge vertices with identical attributes, see gltf_mesh_opt.hpp
+			float weld_epsilon = 0.0f;			// grid size for float attributes when welding, 0 means exact
+			bool optimize_vertex_cache = false;	// reorder triangles for the post transform cache, see gltf_mesh_opt.hpp
+			bool optimize_vertex_fetch = false;	// vertices in first use order, unused ones dropped, owned buffers
+			bool optimize_overdraw = false;		// order triangle clusters to reduce overdraw on opaque primitives
+			float overdraw_threshold = 1.05f;	// how much worse the vertex cache may get for it, 1.05 is 5%
+			std::vector<float> lod_ratios;		// triangle ratios of the lods to generate, { 0.5f, 0.25f, 0.125f } say
+			bool build_meshlets = false;		// split the triangles into meshlets, see gltf_mesh_opt.hpp
+			std::uint32_t meshlet_max_vertices = 64;	// at most 256, micro indices are bytes
+			std::uint32_t meshlet_max_triangles = 124;
+		};
+
+		// optional work done by build_animation, see compress_animation in gltf_animation.hpp
+		struct gltf_animation_options
+		{
+			bool reduce_keys = false;			// drop LINEAR and STEP keys the ones around them rebuild within tolerance
+			float translation_tolerance = 0.0001f;	// largest component difference, in scene units
+			float rotation_tolerance = 0.0001f;		// angle between the rotations, in radians
+			float scale_tolerance = 0.0001f;		// largest component difference
+			float weights_tolerance = 0.001f;		// largest morph target weight difference
+			bool quantize_rotations = false;	// LINEAR and STEP rotations as smallest three, 6 bytes per key
 		};
 
 		class gltf
@@ -83,7 +351,71 @@ namespace knu
 
 			void load(std::string gltf_file, std::string relative_path);
 			bool has_node(std::string node_name);
-			std::pair<bool, gltf_node> build_node(std::string node_name);
+			std::pair<bool, gltf_node> build_node(std::string node_name,
+				const gltf_build_options& options = {});
+			std::pair<bool, gltf_node_f> build_node_f(std::string node_name,
+				const gltf_build_options& options = {});
+
+			// build_node done once per node and options, asking again hands out the same node without
+			// building or copying anything. nullptr for a missing node. The nodes are immutable and shared,
+			// load() and clear_cache() forget them but the ones handed out stay valid
+			std::shared_ptr<const gltf_node> build_shared_node(std::string node_name,
+				const gltf_build_options& options = {});
+			std::shared_ptr<const gltf_node_f> build_shared_node_f(std::string node_name,
+				const gltf_build_options& options = {});
+
+			// drops the shared nodes and the triangle hierarchies kept for the nodes built so far
+			void clear_cache();
+
+			// the mesh nodes given by index, pre-transformed into world space and merged into a single node
+			// with an identity transform, for static geometry that never moves on its own. merge_primitives
+			// is always done, nodes without a mesh or out of range are skipped, false when none is left
+			std::pair<bool, gltf_node> build_static_batch(const std::vector<std::size_t>& node_indices,
+				const gltf_build_options& options = {});
+			std::pair<bool, gltf_node_f> build_static_batch_f(const std::vector<std::size_t>& node_indices,
+				const gltf_build_options& options = {});
+
+			// by name, each name is the first node that has it. Unnamed nodes or names that repeat need
+			// the index overload
+			std::pair<bool, gltf_node> build_static_batch(const std::vector<std::string>& node_names,
+				const gltf_build_options& options = {});
+			std::pair<bool, gltf_node_f> build_static_batch_f(const std::vector<std::string>& node_names,
+				const gltf_build_options& options = {});
+
+			std::size_t node_count();
+			std::string node_name(std::size_t node_index);
+
+			// animations by name, the keyframes are views into the animation's own copy of the accessors
+			// its samplers use, or keys of its own when the options reduce or quantize them
+			std::size_t animation_count();
+			std::string animation_name(std::size_t animation_index);
+			std::pair<bool, gltf_animation> build_animation(std::string animation_name,
+				const gltf_animation_options& options = {});
+
+			// skins by index, gltf_node::skin_index says which one a node uses
+			std::size_t skin_count();
+			std::pair<bool, gltf_skin> build_skin(std::size_t skin_index);
+
+			// the column major world matrix of every node, in node order. With an animation and values
+			// sampled from it (see sample_animation) the animated translations, rotations and scales
+			// replace the ones from the file first
+			std::vector<std::array<double, 16>> world_transforms(const gltf_animation* animation = nullptr,
+				const float* values = nullptr);
+
+			// builds a bounding volume hierarchy over the world space bounds of every
+			// node with a mesh, the queries in gltf_bvh.hpp report gltf node indices
+			gltf_scene_bvh build_scene_bvh();
+
+			// every node with a mesh built with the options, in node order, and put into one vertex
+			// and index arena with indirect draw commands, the transforms are the world matrices
+			gltf_indirect_draws build_scene_draws(const gltf_vertex_layout& layout,
+				const gltf_build_options& options = {});
+
+			// the copies that stage every bufferView the meshes use, by target, see gltf_upload.hpp.
+			// Views without a target get the one their accessors are used as (indices or attributes).
+			// The views under sparse accessors are left out, their values only exist after the load
+			// made them dense (gltf_component_info into the node's buffers)
+			gltf_upload_plan plan_uploads(std::size_t gap_threshold = 256, std::size_t alignment = 16);
 
 		private:
 			class impl;
@@ -93,7 +425,14 @@ namespace knu
 		// a convenience function for loading a model with a node
 		std::pair<bool, gltf_node> load_gltf_node(std::string model_name,
 			std::string relative_path,
-			std::string node_name);
+			std::string node_name,
+			const gltf_build_options& options = {});
+
+		// same as above, but builds the single precision node
+		std::pair<bool, gltf_node_f> load_gltf_node_f(std::string model_name,
+			std::string relative_path,
+			std::string node_name,
+			const gltf_build_options& options = {});
 	}
 }
 
@@ -0,0 +1,805 @@
+#include "gltf_animation.hpp"
+#include "gltf_detail.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <execution>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace knu
+{
+	namespace graphics
+	{
+		namespace
+		{
+			// the key times of a sampler, read in place
+			class key_times
+			{
+			public:
+				key_times(const std::vector<gltf_buffer>& buffers, const gltf_component_info_f& input) :
+					base{ buffers[input.buffer_index].data.data() + input.byte_offset },
+					stride{ input.byte_stride != 0 ? input.byte_stride : std::uint32_t(sizeof(float)) },
+					count{ input.count }
+				{}
+
+				float operator[](std::size_t key) const
+				{
+					float time;
+					std::memcpy(&time, base + key * stride, sizeof(time));
+					return time;
+				}
+
+				std::uint32_t size() const { return count; }
+
+				// the key whose segment [time of key, time of key + 1) holds time, the last segment holds
+				// everything past it. The hint and the key after it are tried before searching
+				std::uint32_t find(float time, std::uint32_t hint) const
+				{
+					if (count < 2)
+						return 0;
+
+					const std::uint32_t last_segment = count - 2;
+					for (std::uint32_t key = hint; key <= hint + 1 && key <= last_segment; ++key)
+					{
+						if ((*this)[key] <= time && (time < (*this)[key + 1] || key == last_segment))
+							return key;
+					}
+
+					std::uint32_t low = 0, high = count;	// first key after time, by bisection
+					while (low < high)
+					{
+						const std::uint32_t middle = low + (high - low) / 2;
+						if ((*this)[middle] <= time)
+							low = middle + 1;
+						else
+							high = middle;
+					}
+
+					return std::min(low > 0 ? low - 1 : 0, last_segment);
+				}
+
+			private:
+				const std::uint8_t* base;
+				std::uint32_t stride;
+				std::uint32_t count;
+			};
+
+			// smallest three rotations are 48 bits: the index of the largest component in the lowest 2 bits,
+			// then the other three in order, 15 bits each over [-1 / sqrt(2), 1 / sqrt(2)]. The largest one
+			// is made positive (q and -q are the same rotation) and rebuilt from the unit length
+			const std::uint32_t smallest_three_size = 6;
+			const float smallest_three_range = 0.70710678f;
+			const float smallest_three_steps = 32767.0f;
+
+			void encode_smallest_three(const float* q, std::uint8_t* out)
+			{
+				int largest = 0;
+				for (int i = 1; i < 4; ++i)
+					if (std::abs(q[i]) > std::abs(q[largest]))
+						largest = i;
+
+				const float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+				std::uint64_t bits = std::uint64_t(largest);
+				int shift = 2;
+				for (int i = 0; i < 4; ++i)
+				{
+					if (i == largest)
+						continue;
+
+					const float v = std::min(std::max(q[i] * sign / smallest_three_range, -1.0f), 1.0f);
+					bits |= std::uint64_t(std::lround((v * 0.5f + 0.5f) * smallest_three_steps)) << shift;
+					shift += 15;
+				}
+
+				for (std::uint32_t b = 0; b < smallest_three_size; ++b)
+					out[b] = static_cast<std::uint8_t>(bits >> (b * 8));
+			}
+
+			void decode_smallest_three(const std::uint8_t* in, float* q)
+			{
+				std::uint64_t bits = 0;
+				for (std::uint32_t b = 0; b < smallest_three_size; ++b)
+					bits |= std::uint64_t(in[b]) << (b * 8);
+
+				const int largest = static_cast<int>(bits & 3);
+				float sum = 0.0f;
+				int shift = 2;
+				for (int i = 0; i < 4; ++i)
+				{
+					if (i == largest)
+						continue;
+
+					q[i] = (float((bits >> shift) & 0x7fff) / smallest_three_steps * 2.0f - 1.0f) * smallest_three_range;
+					sum += q[i] * q[i];
+					shift += 15;
+				}
+
+				q[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+			}
+
+			// the n values of element, where an element is a key or, for cubic splines, a key's
+			// in tangent, value or out tangent. Weights are scalars, n of them per element
+			void read_element(const detail::attribute_reader& output, std::uint32_t element, std::uint32_t n, float* out)
+			{
+				if (output.type() == detail::GL_SMALLEST_THREE)
+					decode_smallest_three(output.element(element), out);
+				else if (output.components() == n && output.type() == detail::GL_FLOAT)
+				{
+					std::memcpy(out, output.element(element), n * sizeof(float));
+				}
+				else if (output.components() == 1)
+				{
+					for (std::uint32_t j = 0; j < n; ++j)
+						out[j] = output.component(std::size_t(element) * n + j, 0);
+				}
+				else
+				{
+					for (std::uint32_t j = 0; j < n; ++j)
+						out[j] = output.component(element, j);
+				}
+			}
+
+			// out = a + (b - a) * t over n floats, n rounded up to 4 for the vector loop
+			void lerp(const float* a, const float* b, float t, float* out, std::uint32_t n)
+			{
+				std::uint32_t i = 0;
+#if defined(KNU_GLTF_SSE)
+				const __m128 weight = _mm_set1_ps(t);
+				for (; i + 4 <= n; i += 4)
+				{
+					const __m128 va = _mm_loadu_ps(a + i);
+					_mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b + i), va), weight)));
+				}
+#endif
+				for (; i < n; ++i)
+					out[i] = a[i] + (b[i] - a[i]) * t;
+			}
+
+			// the hermite curve through p0 and p1 with tangents m0 and m1 scaled by the key distance
+			void hermite(const float* p0, const float* m0, const float* p1, const float* m1, float t, float dt,
+				float* out, std::uint32_t n)
+			{
+				const float t2 = t * t, t3 = t2 * t;
+				const float h00 = 2.0f * t3 - 3.0f * t2 + 1.0f;
+				const float h10 = (t3 - 2.0f * t2 + t) * dt;
+				const float h01 = -2.0f * t3 + 3.0f * t2;
+				const float h11 = (t3 - t2) * dt;
+
+				std::uint32_t i = 0;
+#if defined(KNU_GLTF_SSE)
+				const __m128 w00 = _mm_set1_ps(h00), w10 = _mm_set1_ps(h10), w01 = _mm_set1_ps(h01), w11 = _mm_set1_ps(h11);
+				for (; i + 4 <= n; i += 4)
+				{
+					__m128 v = _mm_mul_ps(w00, _mm_loadu_ps(p0 + i));
+					v = _mm_add_ps(v, _mm_mul_ps(w10, _mm_loadu_ps(m0 + i)));
+					v = _mm_add_ps(v, _mm_mul_ps(w01, _mm_loadu_ps(p1 + i)));
+					v = _mm_add_ps(v, _mm_mul_ps(w11, _mm_loadu_ps(m1 + i)));
+					_mm_storeu_ps(out + i, v);
+				}
+#endif
+				for (; i < n; ++i)
+					out[i] = h00 * p0[i] + h10 * m0[i] + h01 * p1[i] + h11 * m1[i];
+			}
+
+			void normalize_quaternion(float* q)
+			{
+#if defined(KNU_GLTF_SSE)
+				const __m128 v = _mm_loadu_ps(q);
+				__m128 d = _mm_mul_ps(v, v);
+				d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+				d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 0, 3, 2)));
+				if (_mm_cvtss_f32(d) > 0.0f)
+					_mm_storeu_ps(q, _mm_div_ps(v, _mm_sqrt_ps(d)));
+#else
+				const float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+				if (length > 0.0f)
+					for (int i = 0; i < 4; ++i)
+						q[i] /= length;
+#endif
+			}
+
+			// shortest arc slerp, close quaternions fall back to a normalized lerp where the sines lose precision
+			void slerp(const float* a, const float* b, float t, float* out)
+			{
+				float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+				const float sign = dot < 0.0f ? -1.0f : 1.0f;
+				dot *= sign;
+
+				float wa = 1.0f - t, wb = t * sign;
+				if (dot < 0.9995f)
+				{
+					const float theta = std::acos(dot);
+					const float inverse_sine = 1.0f / std::sin(theta);
+					wa = std::sin((1.0f - t) * theta) * inverse_sine;
+					wb = std::sin(t * theta) * inverse_sine * sign;
+				}
+
+#if defined(KNU_GLTF_SSE)
+				_mm_storeu_ps(out, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(wa), _mm_loadu_ps(a)),
+					_mm_mul_ps(_mm_set1_ps(wb), _mm_loadu_ps(b))));
+#else
+				for (int i = 0; i < 4; ++i)
+					out[i] = wa * a[i] + wb * b[i];
+#endif
+				normalize_quaternion(out);
+			}
+
+			// how far apart two values of a channel are, the angle between rotations (from the chord and
+			// its complement, acos loses too much near 1) or the largest component difference
+			float value_error(const float* a, const float* b, std::uint32_t n, bool rotation)
+			{
+				if (rotation)
+				{
+					const float sign = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0.0f ? -1.0f : 1.0f;
+					float difference = 0.0f, sum = 0.0f;
+					for (int i = 0; i < 4; ++i)
+					{
+						difference += (a[i] - b[i] * sign) * (a[i] - b[i] * sign);
+						sum += (a[i] + b[i] * sign) * (a[i] + b[i] * sign);
+					}
+
+					return 4.0f * std::atan2(std::sqrt(difference), std::sqrt(sum));
+				}
+
+				float error = 0.0f;
+				for (std::uint32_t i = 0; i < n; ++i)
+					error = std::max(error, std::abs(a[i] - b[i]));
+				return error;
+			}
+
+			// the keys worth keeping, the first and the last always. A linear segment grows until a key
+			// inside it is missed by more than tolerance, step keys stay when their value moved that much
+			std::vector<std::uint32_t> reduce_keys(const key_times& times, const std::vector<float>& values, std::uint32_t n,
+				gltf_interpolation interpolation, bool rotation, float tolerance)
+			{
+				const std::uint32_t count = times.size();
+				std::vector<std::uint32_t> kept = { 0 };
+				std::vector<float> rebuilt(n);
+
+				if (interpolation == gltf_interpolation::step)
+				{
+					for (std::uint32_t key = 1; key + 1 < count; ++key)
+						if (value_error(&values[std::size_t(kept.back()) * n], &values[std::size_t(key) * n], n, rotation) > tolerance)
+							kept.push_back(key);
+				}
+				else
+				{
+					std::uint32_t anchor = 0;
+					for (std::uint32_t end = anchor + 2; end < count; ++end)
+					{
+						const float* a = &values[std::size_t(anchor) * n];
+						const float* b = &values[std::size_t(end) * n];
+						const float span = times[end] - times[anchor];
+
+						bool fits = true;
+						for (std::uint32_t key = anchor + 1; key < end && fits; ++key)
+						{
+							const float t = span > 0.0f ? (times[key] - times[anchor]) / span : 0.0f;
+							if (rotation)
+								slerp(a, b, t, rebuilt.data());
+							else
+								lerp(a, b, t, rebuilt.data(), n);
+
+							fits = value_error(rebuilt.data(), &values[std::size_t(key) * n], n, rotation) <= tolerance;
+						}
+
+						if (!fits)
+						{
+							anchor = end - 1;
+							kept.push_back(anchor);
+						}
+					}
+				}
+
+				if (count > 1)
+					kept.push_back(count - 1);
+
+				return kept;
+			}
+
+			// eight instances side by side, one register with AVX, two with SSE2
+			const std::size_t lane_count = gltf_pose_batch::lane_width;
+
+#if defined(__AVX__)
+			using lanes = __m256;
+			lanes load(const float* p) { return _mm256_loadu_ps(p); }
+			void store(float* p, lanes v) { _mm256_storeu_ps(p, v); }
+			lanes add(lanes a, lanes b) { return _mm256_add_ps(a, b); }
+			lanes sub(lanes a, lanes b) { return _mm256_sub_ps(a, b); }
+			lanes mul(lanes a, lanes b) { return _mm256_mul_ps(a, b); }
+			lanes div(lanes a, lanes b) { return _mm256_div_ps(a, b); }
+			lanes sqrt(lanes a) { return _mm256_sqrt_ps(a); }
+#elif defined(KNU_GLTF_SSE)
+			struct lanes { __m128 low, high; };
+			lanes load(const float* p) { return { _mm_loadu_ps(p), _mm_loadu_ps(p + 4) }; }
+			void store(float* p, lanes v) { _mm_storeu_ps(p, v.low); _mm_storeu_ps(p + 4, v.high); }
+			lanes add(lanes a, lanes b) { return { _mm_add_ps(a.low, b.low), _mm_add_ps(a.high, b.high) }; }
+			lanes sub(lanes a, lanes b) { return { _mm_sub_ps(a.low, b.low), _mm_sub_ps(a.high, b.high) }; }
+			lanes mul(lanes a, lanes b) { return { _mm_mul_ps(a.low, b.low), _mm_mul_ps(a.high, b.high) }; }
+			lanes div(lanes a, lanes b) { return { _mm_div_ps(a.low, b.low), _mm_div_ps(a.high, b.high) }; }
+			lanes sqrt(lanes a) { return { _mm_sqrt_ps(a.low), _mm_sqrt_ps(a.high) }; }
+#else
+			struct lanes { float v[8]; };
+			lanes load(const float* p) { lanes r; std::copy(p, p + 8, r.v); return r; }
+			void store(float* p, lanes v) { std::copy(v.v, v.v + 8, p); }
+			template <typename Op>
+			lanes each(lanes a, lanes b, Op op) { for (int i = 0; i < 8; ++i) a.v[i] = op(a.v[i], b.v[i]); return a; }
+			lanes add(lanes a, lanes b) { return each(a, b, [](float x, float y) { return x + y; }); }
+			lanes sub(lanes a, lanes b) { return each(a, b, [](float x, float y) { return x - y; }); }
+			lanes mul(lanes a, lanes b) { return each(a, b, [](float x, float y) { return x * y; }); }
+			lanes div(lanes a, lanes b) { return each(a, b, [](float x, float y) { return x / y; }); }
+			lanes sqrt(lanes a) { for (float& x : a.v) x = std::sqrt(x); return a; }
+#endif
+
+			// one channel of a group of instances, component k of lane l at [k * lane_count + l]
+			struct lane_segment
+			{
+				std::vector<float> p0, m0, p1, m1, out;
+				float u[lane_count];		// where each instance is between its two keys, 0 to 1
+				float dt[lane_count];		// key distance, scales the tangents
+
+				void resize(std::size_t components)
+				{
+					for (auto* v : { &p0, &m0, &p1, &m1, &out })
+						v->assign(components * lane_count, 0.0f);
+				}
+			};
+
+			// reads the keys around every lane's time. The ends hold their values through u being 0 or 1,
+			// step keeps the first key until the second one
+			void gather_segment(const gltf_animation& animation, const gltf_animation_channel& channel,
+				const float* lane_times, lane_segment& segment)
+			{
+				const gltf_animation_sampler& sampler = animation.samplers[channel.sampler];
+				const key_times times{ animation.buffers, sampler.input };
+				const detail::attribute_reader output{ animation.buffers, sampler.output };
+				const std::uint32_t n = channel.components;
+				const bool cubic = sampler.interpolation == gltf_interpolation::cubic_spline;
+
+				std::vector<float> keys(std::size_t(n) * 4);	// p0, m0, p1, m1 of one lane
+				float* p0 = keys.data();
+				float* m0 = p0 + n;
+				float* p1 = m0 + n;
+				float* m1 = p1 + n;
+
+				for (std::size_t lane = 0; lane < lane_count; ++lane)
+				{
+					const float time = lane_times[lane];
+					const std::uint32_t key = times.find(time, 0);
+					const std::uint32_t next = times.size() > 1 ? key + 1 : key;
+					const float t0 = times[key], t1 = times[next];
+
+					float u = t1 > t0 ? (time - t0) / (t1 - t0) : 0.0f;
+					u = std::min(std::max(u, 0.0f), 1.0f);
+					if (sampler.interpolation == gltf_interpolation::step)
+						u = u >= 1.0f ? 1.0f : 0.0f;
+
+					segment.u[lane] = u;
+					segment.dt[lane] = t1 - t0;
+
+					read_element(output, cubic ? key * 3 + 1 : key, n, p0);
+					read_element(output, cubic ? next * 3 + 1 : next, n, p1);
+					if (cubic)
+					{
+						read_element(output, key * 3 + 2, n, m0);
+						read_element(output, next * 3, n, m1);
+					}
+
+					for (std::uint32_t k = 0; k < n; ++k)
+					{
+						segment.p0[k * lane_count + lane] = p0[k];
+						segment.p1[k * lane_count + lane] = p1[k];
+						segment.m0[k * lane_count + lane] = m0[k];
+						segment.m1[k * lane_count + lane] = m1[k];
+					}
+				}
+			}
+
+			// the interpolation of every lane at once
+			void evaluate_segment(const gltf_animation_sampler& sampler, const gltf_animation_channel& channel,
+				lane_segment& segment)
+			{
+				const std::uint32_t n = channel.components;
+
+				if (sampler.interpolation == gltf_interpolation::cubic_spline)
+				{
+					float h[4][lane_count];
+					for (std::size_t lane = 0; lane < lane_count; ++lane)
+					{
+						const float t = segment.u[lane], t2 = t * t, t3 = t2 * t;
+						h[0][lane] = 2.0f * t3 - 3.0f * t2 + 1.0f;
+						h[1][lane] = (t3 - 2.0f * t2 + t) * segment.dt[lane];
+						h[2][lane] = -2.0f * t3 + 3.0f * t2;
+						h[3][lane] = (t3 - t2) * segment.dt[lane];
+					}
+
+					const lanes h00 = load(h[0]), h10 = load(h[1]), h01 = load(h[2]), h11 = load(h[3]);
+					for (std::uint32_t k = 0; k < n; ++k)
+					{
+						const std::size_t row = k * lane_count;
+						lanes r = mul(h00, load(&segment.p0[row]));
+						r = add(r, mul(h10, load(&segment.m0[row])));
+						r = add(r, mul(h01, load(&segment.p1[row])));
+						r = add(r, mul(h11, load(&segment.m1[row])));
+						store(&segment.out[row], r);
+					}
+				}
+				else if (channel.path == gltf_animation_path::rotation && sampler.interpolation == gltf_interpolation::linear)
+				{
+					// the dot products across lanes, the angles per lane, then the blend across lanes again
+					lanes dot = mul(load(&segment.p0[0]), load(&segment.p1[0]));
+					for (std::uint32_t k = 1; k < 4; ++k)
+						dot = add(dot, mul(load(&segment.p0[k * lane_count]), load(&segment.p1[k * lane_count])));
+
+					float dots[lane_count], wa[lane_count], wb[lane_count];
+					store(dots, dot);
+					for (std::size_t lane = 0; lane < lane_count; ++lane)
+					{
+						const float t = segment.u[lane];
+						const float sign = dots[lane] < 0.0f ? -1.0f : 1.0f;
+						const float d = dots[lane] * sign;
+
+						wa[lane] = 1.0f - t;
+						wb[lane] = t * sign;
+						if (d < 0.9995f)
+						{
+							const float theta = std::acos(d);
+							const float inverse_sine = 1.0f / std::sin(theta);
+							wa[lane] = std::sin((1.0f - t) * theta) * inverse_sine;
+							wb[lane] = std::sin(t * theta) * inverse_sine * sign;
+						}
+					}
+
+					const lanes a = load(wa), b = load(wb);
+					for (std::uint32_t k = 0; k < 4; ++k)
+					{
+						const std::size_t row = k * lane_count;
+						store(&segment.out[row], add(mul(a, load(&segment.p0[row])), mul(b, load(&segment.p1[row]))));
+					}
+				}
+				else
+				{
+					const lanes u = load(segment.u);
+					for (std::uint32_t k = 0; k < n; ++k)
+					{
+						const std::size_t row = k * lane_count;
+						const lanes a = load(&segment.p0[row]);
+						store(&segment.out[row], add(a, mul(sub(load(&segment.p1[row]), a), u)));
+					}
+				}
+
+				if (channel.path == gltf_animation_path::rotation)
+				{
+					lanes length = mul(load(&segment.out[0]), load(&segment.out[0]));
+					for (std::uint32_t k = 1; k < 4; ++k)
+						length = add(length, mul(load(&segment.out[k * lane_count]), load(&segment.out[k * lane_count])));
+					length = sqrt(length);
+
+					for (std::uint32_t k = 0; k < 4; ++k)
+						store(&segment.out[k * lane_count], div(load(&segment.out[k * lane_count]), length));
+				}
+			}
+		}
+
+		void sample_animation(const gltf_animation& animation, float time, float* values, gltf_animation_cursor* cursor)
+		{
+			if (cursor != nullptr && cursor->keys.size() != animation.samplers.size())
+				cursor->keys.assign(animation.samplers.size(), 0);
+
+			std::uint32_t max_components = 4;
+			for (const gltf_animation_channel& channel : animation.channels)
+				max_components = std::max(max_components, channel.components);
+
+			// the two keys and the two tangents of a segment
+			std::vector<float> scratch(std::size_t(max_components) * 4);
+			float* p0 = scratch.data();
+			float* p1 = p0 + max_components;
+			float* m0 = p1 + max_components;
+			float* m1 = m0 + max_components;
+
+			for (std::size_t c = 0; c < animation.channels.size(); ++c)
+			{
+				const gltf_animation_channel& channel = animation.channels[c];
+				const gltf_animation_sampler& sampler = animation.samplers[channel.sampler];
+				const key_times times{ animation.buffers, sampler.input };
+				const detail::attribute_reader output{ animation.buffers, sampler.output };
+				const std::uint32_t n = channel.components;
+				float* out = values + animation.value_offsets[c];
+
+				if (times.size() == 0)
+				{
+					std::fill(out, out + n, 0.0f);
+					continue;
+				}
+
+				const std::uint32_t hint = cursor != nullptr ? cursor->keys[channel.sampler] : 0;
+				const std::uint32_t key = times.find(time, hint);
+				if (cursor != nullptr)
+					cursor->keys[channel.sampler] = key;
+
+				const bool cubic = sampler.interpolation == gltf_interpolation::cubic_spline;
+				auto value_element = [cubic](std::uint32_t k) { return cubic ? k * 3 + 1 : k; };
+
+				// before the first key, after the last one and on a single key the value is held
+				const float t0 = times[key];
+				const float t1 = times.size() > 1 ? times[key + 1] : t0;
+				if (times.size() == 1 || time <= t0 || time >= t1)
+				{
+					const std::uint32_t held = times.size() > 1 && time >= t1 ? key + 1 : key;
+					read_element(output, value_element(held), n, out);
+					if (channel.path == gltf_animation_path::rotation)
+						normalize_quaternion(out);
+					continue;
+				}
+
+				const float dt = t1 - t0;
+				const float t = (time - t0) / dt;
+
+				switch (sampler.interpolation)
+				{
+				case gltf_interpolation::step:
+					read_element(output, key, n, out);
+					break;
+
+				case gltf_interpolation::linear:
+					read_element(output, key, n, p0);
+					read_element(output, key + 1, n, p1);
+					if (channel.path == gltf_animation_path::rotation)
+						slerp(p0, p1, t, out);
+					else
+						lerp(p0, p1, t, out, n);
+					break;
+
+				case gltf_interpolation::cubic_spline:
+					read_element(output, key * 3 + 1, n, p0);
+					read_element(output, key * 3 + 2, n, m0);		// out tangent of the first key
+					read_element(output, (key + 1) * 3, n, m1);	// in tangent of the second
+					read_element(output, (key + 1) * 3 + 1, n, p1);
+					hermite(p0, m0, p1, m1, t, dt, out, n);
+					break;
+				}
+
+				if (channel.path == gltf_animation_path::rotation && sampler.interpolation != gltf_interpolation::linear)
+					normalize_quaternion(out);
+			}
+		}
+
+		std::vector<float> sample_animation(const gltf_animation& animation, float time, gltf_animation_cursor* cursor)
+		{
+			std::vector<float> values(animation.value_count);
+			sample_animation(animation, time, values.data(), cursor);
+			return values;
+		}
+
+		void compress_animation(gltf_animation& animation, const gltf_animation_options& options)
+		{
+			// what a sampler animates comes from its channels, a shared sampler gets the tightest tolerance
+			struct sampler_use
+			{
+				bool used = false;
+				gltf_animation_path path = gltf_animation_path::translation;
+				std::uint32_t components = 0;
+				float tolerance = 0.0f;
+			};
+
+			std::vector<sampler_use> uses(animation.samplers.size());
+			for (const gltf_animation_channel& channel : animation.channels)
+			{
+				float tolerance = options.translation_tolerance;
+				switch (channel.path)
+				{
+				case gltf_animation_path::translation: tolerance = options.translation_tolerance; break;
+				case gltf_animation_path::rotation: tolerance = options.rotation_tolerance; break;
+				case gltf_animation_path::scale: tolerance = options.scale_tolerance; break;
+				case gltf_animation_path::weights: tolerance = options.weights_tolerance; break;
+				}
+
+				sampler_use& use = uses[channel.sampler];
+				if (!use.used)
+					use = sampler_use{ true, channel.path, channel.components, tolerance };
+				else
+					use.tolerance = std::min(use.tolerance, tolerance);
+			}
+
+			// every sampler writes its own buffer slot, they are appended once all are done
+			const std::size_t first_new_buffer = animation.buffers.size();
+			std::vector<gltf_buffer> new_buffers(animation.samplers.size());
+
+			std::vector<std::size_t> slots(animation.samplers.size());
+			for (std::size_t i = 0; i < slots.size(); ++i)
+				slots[i] = i;
+
+			std::for_each(std::execution::par, std::begin(slots), std::end(slots), [&](std::size_t slot)
+			{
+				gltf_animation_sampler& sampler = animation.samplers[slot];
+				const sampler_use& use = uses[slot];
+				const bool rotation = use.path == gltf_animation_path::rotation && use.components == 4;
+				const bool quantize = options.quantize_rotations && rotation;
+				if (!use.used || sampler.interpolation == gltf_interpolation::cubic_spline || !sampler.input.valid
+					|| !sampler.output.valid || sampler.input.count == 0)
+					return;
+
+				const key_times times{ animation.buffers, sampler.input };
+				const detail::attribute_reader output{ animation.buffers, sampler.output };
+				const std::uint32_t n = use.components;
+				if (std::size_t(output.size()) * output.components() < std::size_t(times.size()) * n)
+					return;
+
+				std::vector<float> values(std::size_t(times.size()) * n);
+				for (std::uint32_t key = 0; key < times.size(); ++key)
+				{
+					read_element(output, key, n, &values[std::size_t(key) * n]);
+					if (rotation)
+						normalize_quaternion(&values[std::size_t(key) * n]);
+				}
+
+				std::vector<std::uint32_t> kept;
+				if (options.reduce_keys)
+				{
+					kept = reduce_keys(times, values, n, sampler.interpolation, rotation, use.tolerance);
+				}
+				else
+				{
+					kept.resize(times.size());
+					for (std::uint32_t key = 0; key < kept.size(); ++key)
+						kept[key] = key;
+				}
+
+				const std::size_t value_size = quantize ? smallest_three_size : n * sizeof(float);
+				const std::size_t values_offset = (kept.size() * sizeof(float) + 3) & ~std::size_t(3);
+				const std::size_t byte_length = values_offset + kept.size() * value_size;
+
+				gltf_buffer& buffer = new_buffers[slot];
+				buffer = gltf_buffer{ byte_length, std::vector<std::uint8_t>(byte_length) };
+				for (std::size_t k = 0; k < kept.size(); ++k)
+				{
+					const float time = times[kept[k]];
+					std::memcpy(buffer.data.data() + k * sizeof(float), &time, sizeof(float));
+
+					const float* value = &values[std::size_t(kept[k]) * n];
+					std::uint8_t* out = buffer.data.data() + values_offset + k * value_size;
+					if (quantize)
+						encode_smallest_three(value, out);
+					else
+						std::memcpy(out, value, value_size);
+				}
+
+				const std::uint32_t buffer_index = static_cast<std::uint32_t>(first_new_buffer + slot);
+				const std::uint32_t key_count = static_cast<std::uint32_t>(kept.size());
+
+				gltf_component_info_f input;
+				input.valid = true;
+				input.buffer_index = buffer_index;
+				input.byte_offset = 0;
+				input.component_type = detail::GL_FLOAT;
+				input.component_count = 1;
+				input.byte_stride = 0;
+				input.count = key_count;
+				input.min_bounds = { times[kept.front()], 0, 0 };
+				input.max_bounds = { times[kept.back()], 0, 0 };
+
+				// weights stay scalars, n per key
+				gltf_component_info_f compressed;
+				compressed.valid = true;
+				compressed.buffer_index = buffer_index;
+				compressed.byte_offset = static_cast<std::uint32_t>(values_offset);
+				compressed.component_type = quantize ? std::uint32_t(detail::GL_SMALLEST_THREE) : std::uint32_t(detail::GL_FLOAT);
+				compressed.component_count = use.path == gltf_animation_path::weights ? 1 : n;
+				compressed.byte_stride = quantize ? smallest_three_size : 0;
+				compressed.count = use.path == gltf_animation_path::weights ? key_count * n : key_count;
+				compressed.min_bounds = { 0, 0, 0 };
+				compressed.max_bounds = { 0, 0, 0 };
+
+				sampler.input = input;
+				sampler.output = compressed;
+			});
+
+			for (gltf_buffer& buffer : new_buffers)
+				animation.buffers.emplace_back(std::move(buffer));
+
+			// drop the buffers no sampler reads any more and renumber the rest
+			std::vector<bool> used(animation.buffers.size(), false);
+			for (const gltf_animation_sampler& sampler : animation.samplers)
+			{
+				if (sampler.input.valid) used[sampler.input.buffer_index] = true;
+				if (sampler.output.valid) used[sampler.output.buffer_index] = true;
+			}
+
+			std::vector<std::uint32_t> new_index(animation.buffers.size(), 0);
+			std::vector<gltf_buffer> kept_buffers;
+			for (std::size_t i = 0; i < animation.buffers.size(); ++i)
+			{
+				if (!used[i])
+					continue;
+
+				new_index[i] = static_cast<std::uint32_t>(kept_buffers.size());
+				kept_buffers.emplace_back(std::move(animation.buffers[i]));
+			}
+
+			animation.buffers = std::move(kept_buffers);
+			for (gltf_animation_sampler& sampler : animation.samplers)
+			{
+				if (sampler.input.valid) sampler.input.buffer_index = new_index[sampler.input.buffer_index];
+				if (sampler.output.valid) sampler.output.buffer_index = new_index[sampler.output.buffer_index];
+			}
+		}
+
+		void sample_animations(const std::vector<gltf_animation>& clips,
+			const std::vector<gltf_animation_instance>& instances, gltf_pose_batch& batch)
+		{
+			batch.instance_count = instances.size();
+			batch.stride = (instances.size() + lane_count - 1) / lane_count * lane_count;
+			batch.value_count = 0;
+			for (const gltf_animation_instance& instance : instances)
+				batch.value_count = std::max<std::size_t>(batch.value_count, clips[instance.clip].value_count);
+			batch.values.assign(batch.value_count * batch.stride, 0.0f);
+
+			// instances of a clip next to each other, then cut into groups of lane_count that share a clip
+			std::vector<std::uint32_t> order(instances.size());
+			for (std::uint32_t i = 0; i < order.size(); ++i)
+				order[i] = i;
+			std::stable_sort(std::begin(order), std::end(order),
+				[&instances](std::uint32_t a, std::uint32_t b) { return instances[a].clip < instances[b].clip; });
+
+			std::vector<std::pair<std::size_t, std::size_t>> groups;
+			for (std::size_t first = 0; first < order.size();)
+			{
+				std::size_t last = first + 1;
+				while (last < order.size() && last - first < lane_count
+					&& instances[order[last]].clip == instances[order[first]].clip)
+					++last;
+
+				groups.emplace_back(first, last);
+				first = last;
+			}
+
+			std::for_each(std::execution::par, std::begin(groups), std::end(groups),
+				[&](const std::pair<std::size_t, std::size_t>& group)
+			{
+				const gltf_animation& clip = clips[instances[order[group.first]].clip];
+				const std::size_t size = group.second - group.first;
+
+				// lanes past the end of a short group repeat its last instance and are not written
+				std::uint32_t lane_instances[lane_count];
+				float lane_times[lane_count];
+				for (std::size_t lane = 0; lane < lane_count; ++lane)
+				{
+					lane_instances[lane] = order[group.first + std::min(lane, size - 1)];
+					lane_times[lane] = instances[lane_instances[lane]].time;
+				}
+
+				// a full group of consecutive instances writes whole rows of lanes
+				const bool contiguous = size == lane_count && lane_instances[lane_count - 1] - lane_instances[0] == lane_count - 1;
+
+				lane_segment segment;
+				for (std::size_t c = 0; c < clip.channels.size(); ++c)
+				{
+					const gltf_animation_channel& channel = clip.channels[c];
+					const gltf_animation_sampler& sampler = clip.samplers[channel.sampler];
+
+					segment.resize(channel.components);
+					gather_segment(clip, channel, lane_times, segment);
+					evaluate_segment(sampler, channel, segment);
+
+					for (std::uint32_t k = 0; k < channel.components; ++k)
+					{
+						float* row = batch.values.data() + (clip.value_offsets[c] + k) * batch.stride;
+						const float* lane_values = segment.out.data() + k * lane_count;
+						if (contiguous)
+						{
+							std::copy(lane_values, lane_values + lane_count, row + lane_instances[0]);
+						}
+						else
+						{
+							for (std::size_t lane = 0; lane < size; ++lane)
+								row[lane_instances[lane]] = lane_values[lane];
+						}
+					}
+				}
+			});
+		}
+	} // namespace graphics
+} // namespace knu
@@ -0,0 +1,110 @@
+#ifndef KNU_GLTF_ANIMATION_HPP
+#define KNU_GLTF_ANIMATION_HPP
+
+#include "gltf.hpp"
+
+namespace knu
+{
+	namespace graphics
+	{
+		enum class gltf_interpolation
+		{
+			linear,			// slerp for rotations
+			step,
+			cubic_spline	// hermite, the output has an in tangent, the value and an out tangent per key
+		};
+
+		enum class gltf_animation_path
+		{
+			translation,
+			rotation,
+			scale,
+			weights			// morph target weights
+		};
+
+		// the keys of a sampler are views into the animation's buffers, nothing is decoded on load
+		struct gltf_animation_sampler
+		{
+			gltf_interpolation interpolation = gltf_interpolation::linear;
+			gltf_component_info_f input;	// key times in seconds, FLOAT scalars
+			gltf_component_info_f output;	// values, FLOAT or normalized integers, or compressed rotations that only the sampling reads
+		};
+
+		struct gltf_animation_channel
+		{
+			std::uint32_t sampler;
+			std::uint32_t node;				// gltf node index, see gltf::node_name
+			gltf_animation_path path;
+			std::uint32_t components;		// 3, 4 for rotations, the number of morph targets for weights
+		};
+
+		struct gltf_animation
+		{
+			std::string name;
+			std::vector<gltf_buffer> buffers;
+			std::vector<gltf_animation_sampler> samplers;
+			std::vector<gltf_animation_channel> channels;
+			float start_time = 0.0f;		// first and last key over every sampler
+			float end_time = 0.0f;
+
+			// a sample is value_count floats, channel c starts at value_offsets[c]
+			std::vector<std::uint32_t> value_offsets;
+			std::uint32_t value_count = 0;
+		};
+
+		// the key each sampler was at last time, so playback that moves forward finds the next key
+		// without a search. One per playing instance, they are not shared between threads
+		struct gltf_animation_cursor
+		{
+			std::vector<std::uint32_t> keys;
+		};
+
+		// samples every channel at time, clamped to the keys of each sampler. values holds value_count
+		// floats, rotations come out normalized. Keys are found with a binary search unless the cursor
+		// says where they are, lerp, slerp and the hermite curves use SSE where available
+		void sample_animation(const gltf_animation& animation, float time, float* values,
+			gltf_animation_cursor* cursor = nullptr);
+
+		std::vector<float> sample_animation(const gltf_animation& animation, float time,
+			gltf_animation_cursor* cursor = nullptr);
+
+		// rewrites the LINEAR and STEP samplers into FLOAT keys of the animation's own, build_animation
+		// does this when asked to. With reduce_keys a key is dropped when interpolating between the keys
+		// kept around it stays within the tolerance of the channel's path at every dropped key time, the
+		// first and last keys always stay. With quantize_rotations rotation values are stored as the three
+		// smallest components, 15 bits each, and the index of the largest one, about 0.0001 radians of
+		// error on top of the tolerance. CUBICSPLINE samplers are left as they are, and the buffers no
+		// sampler uses any more are dropped
+		void compress_animation(gltf_animation& animation, const gltf_animation_options& options);
+
+		// one playing instance, clips[clip] at time
+		struct gltf_animation_instance
+		{
+			std::uint32_t clip;
+			float time;
+		};
+
+		// the local poses of many instances as a structure of arrays, value v of instance i (v as in
+		// gltf_animation::value_offsets of its clip) is values[v * stride + i]. Rows are padded to a
+		// multiple of lane_width so a whole AVX register of instances is read without a remainder loop
+		struct gltf_pose_batch
+		{
+			static constexpr std::size_t lane_width = 8;
+
+			std::size_t instance_count = 0;
+			std::size_t stride = 0;
+			std::size_t value_count = 0;	// rows, the most values of any clip
+			std::vector<float> values;
+		};
+
+		// samples every instance into the batch, which is resized to fit. Instances of the same clip are
+		// evaluated lane_width at a time, the keys are searched per instance and the interpolation is done
+		// across instances with AVX (or two SSE halves when the build does not enable AVX, /arch:AVX or
+		// -mavx), and the groups of instances run in parallel.
+		// Results match sample_animation, values of an instance past its clip's value_count are 0
+		void sample_animations(const std::vector<gltf_animation>& clips,
+			const std::vector<gltf_animation_instance>& instances, gltf_pose_batch& batch);
+	}
+}
+
+#endif // !KNU_GLTF_ANIMATION_HPP
@@ -0,0 +1,184 @@
+#include "gltf_bounds.hpp"
+#include "gltf_detail.hpp"
+#include <algorithm>
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace knu
+{
+	namespace graphics
+	{
+		namespace
+		{
+			// grows the arrays by one lane of empty boxes, an empty box has its min above
+			// its max so it can never pass a plane test
+			template <typename Real>
+			void add_lane(basic_gltf_bounds_table<Real>& table)
+			{
+				const Real highest = std::numeric_limits<Real>::max();
+				const Real lowest = std::numeric_limits<Real>::lowest();
+				const std::size_t size = table.min_x.size() + basic_gltf_bounds_table<Real>::lane_width;
+
+				table.min_x.resize(size, highest);
+				table.min_y.resize(size, highest);
+				table.min_z.resize(size, highest);
+				table.max_x.resize(size, lowest);
+				table.max_y.resize(size, lowest);
+				table.max_z.resize(size, lowest);
+			}
+
+			// tests lanes [first, last) against every plane and appends the survivors
+			template <typename Real>
+			void cull_scalar(const basic_gltf_bounds_table<Real>& table, const basic_gltf_frustum<Real>& frustum,
+				std::size_t first, std::size_t last, std::vector<std::uint32_t>& visible)
+			{
+				for (std::size_t i = first; i < last && i < table.count; ++i)
+				{
+					bool inside = true;
+					for (const auto& plane : frustum)
+					{
+						// the corner furthest along the plane normal
+						const Real px = plane[0] >= 0 ? table.max_x[i] : table.min_x[i];
+						const Real py = plane[1] >= 0 ? table.max_y[i] : table.min_y[i];
+						const Real pz = plane[2] >= 0 ? table.max_z[i] : table.min_z[i];
+
+						if (plane[0] * px + plane[1] * py + plane[2] * pz + plane[3] < 0)
+						{
+							inside = false;
+							break;
+						}
+					}
+
+					if (inside)
+						visible.push_back(static_cast<std::uint32_t>(i));
+				}
+			}
+
+			template <typename Real>
+			void cull_lanes(const basic_gltf_bounds_table<Real>& table, const basic_gltf_frustum<Real>& frustum,
+				std::vector<std::uint32_t>& visible)
+			{
+				cull_scalar(table, frustum, 0, table.min_x.size(), visible);
+			}
+
+#if defined(__AVX__)
+			// 8 boxes per iteration, the choice between min and max for every plane is made
+			// once up front by picking which array to load from
+			template <>
+			void cull_lanes<float>(const basic_gltf_bounds_table<float>& table, const basic_gltf_frustum<float>& frustum,
+				std::vector<std::uint32_t>& visible)
+			{
+				const float* px[6];
+				const float* py[6];
+				const float* pz[6];
+				for (std::size_t p = 0; p < 6; ++p)
+				{
+					px[p] = frustum[p][0] >= 0 ? table.max_x.data() : table.min_x.data();
+					py[p] = frustum[p][1] >= 0 ? table.max_y.data() : table.min_y.data();
+					pz[p] = frustum[p][2] >= 0 ? table.max_z.data() : table.min_z.data();
+				}
+
+				const __m256 zero = _mm256_setzero_ps();
+				const std::size_t size = table.min_x.size();
+
+				for (std::size_t i = 0; i < size; i += 8)
+				{
+					__m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+					for (std::size_t p = 0; p < 6; ++p)
+					{
+						__m256 dist = _mm256_set1_ps(frustum[p][3]);
+						dist = _mm256_add_ps(dist, _mm256_mul_ps(_mm256_set1_ps(frustum[p][0]), _mm256_loadu_ps(px[p] + i)));
+						dist = _mm256_add_ps(dist, _mm256_mul_ps(_mm256_set1_ps(frustum[p][1]), _mm256_loadu_ps(py[p] + i)));
+						dist = _mm256_add_ps(dist, _mm256_mul_ps(_mm256_set1_ps(frustum[p][2]), _mm256_loadu_ps(pz[p] + i)));
+						mask = _mm256_and_ps(mask, _mm256_cmp_ps(dist, zero, _CMP_GE_OQ));
+					}
+
+					int bits = _mm256_movemask_ps(mask);
+					for (std::size_t lane = 0; bits != 0; ++lane, bits >>= 1)
+					{
+						if ((bits & 1) && i + lane < table.count)
+							visible.push_back(static_cast<std::uint32_t>(i + lane));
+					}
+				}
+			}
+#endif
+		}
+
+		template <typename Real>
+		std::size_t append_bounds(basic_gltf_bounds_table<Real>& table,
+			const std::array<Real, 3>& min_bounds, const std::array<Real, 3>& max_bounds)
+		{
+			const std::size_t index = table.count;
+			if (index == table.min_x.size())
+				add_lane(table);
+
+			table.min_x[index] = min_bounds[0];
+			table.min_y[index] = min_bounds[1];
+			table.min_z[index] = min_bounds[2];
+			table.max_x[index] = max_bounds[0];
+			table.max_y[index] = max_bounds[1];
+			table.max_z[index] = max_bounds[2];
+			++table.count;
+
+			return index;
+		}
+
+		template <typename Real>
+		std::size_t append_node_bounds(basic_gltf_bounds_table<Real>& table,
+			const basic_gltf_node<Real>& node)
+		{
+			const Real highest = std::numeric_limits<Real>::max();
+			const Real lowest = std::numeric_limits<Real>::lowest();
+
+			std::array<Real, 3> local_min = { highest, highest, highest };
+			std::array<Real, 3> local_max = { lowest, lowest, lowest };
+			bool has_bounds = false;
+
+			for (const auto& sub_mesh : node.mesh.sub_meshes)
+			{
+				if (!sub_mesh.position_info.valid)
+					continue;
+
+				has_bounds = true;
+				for (std::size_t i = 0; i < 3; ++i)
+				{
+					local_min[i] = std::min(local_min[i], sub_mesh.position_info.min_bounds[i]);
+					local_max[i] = std::max(local_max[i], sub_mesh.position_info.max_bounds[i]);
+				}
+			}
+
+			if (!has_bounds)
+				return append_bounds(table, local_min, local_max);
+
+			const detail::mat4 m = detail::compose_trs(node.translation, node.rotation, node.scale);
+
+			std::array<Real, 3> world_min;
+			std::array<Real, 3> world_max;
+			detail::transform_aabb(m, local_min, local_max, world_min, world_max);
+
+			return append_bounds(table, world_min, world_max);
+		}
+
+		template <typename Real>
+		std::vector<std::uint32_t> frustum_cull(const basic_gltf_bounds_table<Real>& table,
+			const basic_gltf_frustum<Real>& frustum)
+		{
+			std::vector<std::uint32_t> visible;
+			visible.reserve(table.count);
+
+			cull_lanes(table, frustum, visible);
+
+			return visible;
+		}
+
+		template std::size_t append_bounds(gltf_bounds_table&, const std::array<double, 3>&, const std::array<double, 3>&);
+		template std::size_t append_bounds(gltf_bounds_table_f&, const std::array<float, 3>&, const std::array<float, 3>&);
+		template std::size_t append_node_bounds(gltf_bounds_table&, const gltf_node&);
+		template std::size_t append_node_bounds(gltf_bounds_table_f&, const gltf_node_f&);
+		template std::vector<std::uint32_t> frustum_cull(const gltf_bounds_table&, const gltf_frustum&);
+		template std::vector<std::uint32_t> frustum_cull(const gltf_bounds_table_f&, const gltf_frustum_f&);
+	} // namespace graphics
+} // namespace knu
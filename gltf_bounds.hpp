@@ -0,0 +1,53 @@
+#ifndef KNU_GLTF_BOUNDS_HPP
+#define KNU_GLTF_BOUNDS_HPP
+
+#include "gltf.hpp"
+
+namespace knu
+{
+	namespace graphics
+	{
+		// structure of arrays table of axis aligned boxes used for culling.
+		// every component array is padded with empty boxes to a multiple of lane_width
+		// so a whole AVX register (8 floats) can be tested without a remainder loop
+		template <typename Real>
+		struct basic_gltf_bounds_table
+		{
+			static constexpr std::size_t lane_width = 8;
+
+			std::size_t count = 0;		// number of real boxes, the arrays may be longer
+			std::vector<Real> min_x, min_y, min_z;
+			std::vector<Real> max_x, max_y, max_z;
+		};
+
+		// a plane in form [nx, ny, nz, d], a point p is on the inside when dot(n, p) + d >= 0
+		template <typename Real>
+		using basic_gltf_frustum = std::array<std::array<Real, 4>, 6>;
+
+		using gltf_bounds_table = basic_gltf_bounds_table<double>;
+		using gltf_bounds_table_f = basic_gltf_bounds_table<float>;
+		using gltf_frustum = basic_gltf_frustum<double>;
+		using gltf_frustum_f = basic_gltf_frustum<float>;
+
+		// adds a box to the table and returns its index
+		template <typename Real>
+		std::size_t append_bounds(basic_gltf_bounds_table<Real>& table,
+			const std::array<Real, 3>& min_bounds, const std::array<Real, 3>& max_bounds);
+
+		// adds the box enclosing every sub mesh position of the node, moved by the node's
+		// scale, rotation and translation. A node without positions gets an empty box
+		// so that the returned index still lines up with the order of the calls
+		template <typename Real>
+		std::size_t append_node_bounds(basic_gltf_bounds_table<Real>& table,
+			const basic_gltf_node<Real>& node);
+
+		// returns the indices of the boxes that are inside or intersect the frustum. The 8 wide AVX test of
+		// the float table is chosen at compile time, builds without AVX enabled (/arch:AVX, -mavx) test
+		// one box at a time
+		template <typename Real>
+		std::vector<std::uint32_t> frustum_cull(const basic_gltf_bounds_table<Real>& table,
+			const basic_gltf_frustum<Real>& frustum);
+	}
+}
+
+#endif // !KNU_GLTF_BOUNDS_HPP
@@ -0,0 +1,771 @@
+#include "gltf_bvh.hpp"
+#include "gltf_detail.hpp"
+#include <algorithm>
+#include <atomic>
+#include <execution>
+#include <future>
+#include <thread>
+
+namespace knu
+{
+	namespace graphics
+	{
+		namespace
+		{
+			using vec3 = std::array<float, 3>;
+
+			const std::uint32_t bin_count = 16;
+			const std::uint32_t max_leaf_size = 4;
+			const std::uint32_t max_sah_leaf_size = 16;		// the sah may stop splitting up to this size
+			const std::uint32_t parallel_build_threshold = 4096;	// subtrees smaller than this stay on one thread
+
+			struct aabb
+			{
+				vec3 min_bounds = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+					std::numeric_limits<float>::max() };
+				vec3 max_bounds = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(),
+					std::numeric_limits<float>::lowest() };
+
+				void grow(const vec3& min_in, const vec3& max_in)
+				{
+					for (int i = 0; i < 3; ++i)
+					{
+						min_bounds[i] = std::min(min_bounds[i], min_in[i]);
+						max_bounds[i] = std::max(max_bounds[i], max_in[i]);
+					}
+				}
+
+				void grow(const vec3& p) { grow(p, p); }
+
+				float half_area() const
+				{
+					const float dx = max_bounds[0] - min_bounds[0];
+					const float dy = max_bounds[1] - min_bounds[1];
+					const float dz = max_bounds[2] - min_bounds[2];
+					if (dx < 0 || dy < 0 || dz < 0)
+						return 0.0f;
+
+					return dx * dy + dy * dz + dz * dx;
+				}
+			};
+
+			// builds a hierarchy over arbitrary boxes, used by both the scene and the triangle hierarchies.
+			// order ends up holding the item permutation that the leaves index into
+			class bvh_builder
+			{
+			public:
+				bvh_builder(const std::vector<vec3>& min_in, const std::vector<vec3>& max_in,
+					std::vector<gltf_bvh_node>& nodes_out, std::vector<std::uint32_t>& order_out) :
+					min_bounds{ min_in }, max_bounds{ max_in }, nodes{ nodes_out }, order{ order_out }
+				{
+					const std::size_t item_count = min_bounds.size();
+
+					nodes.clear();
+					order.resize(item_count);
+					if (item_count == 0)
+						return;
+
+					centroids.resize(item_count);
+					for (std::uint32_t i = 0; i < item_count; ++i)
+					{
+						order[i] = i;
+						for (int axis = 0; axis < 3; ++axis)
+							centroids[i][axis] = (min_bounds[i][axis] + max_bounds[i][axis]) * 0.5f;
+					}
+
+					// subtrees are handed to other threads only near the root, 2^parallel_depth of them at most
+					const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+					while ((1u << parallel_depth) < threads)
+						++parallel_depth;
+
+					// a binary tree with at least one item per leaf never has more than 2n - 1 nodes
+					nodes.resize(2 * item_count - 1);
+					node_count = 1;
+					build(0, 0, static_cast<std::uint32_t>(item_count), 0);
+					nodes.resize(node_count);
+				}
+
+			private:
+				void build(std::uint32_t node_index, std::uint32_t begin, std::uint32_t end, std::uint32_t depth)
+				{
+					gltf_bvh_node& node = nodes[node_index];
+
+					aabb bounds;
+					aabb centroid_bounds;
+					for (std::uint32_t i = begin; i < end; ++i)
+					{
+						bounds.grow(min_bounds[order[i]], max_bounds[order[i]]);
+						centroid_bounds.grow(centroids[order[i]]);
+					}
+
+					node.min_bounds = bounds.min_bounds;
+					node.max_bounds = bounds.max_bounds;
+
+					const std::uint32_t count = end - begin;
+					if (count <= max_leaf_size)
+					{
+						make_leaf(node, begin, count);
+						return;
+					}
+
+					std::uint32_t middle = split(begin, end, bounds, centroid_bounds);
+					if (middle == begin && count <= max_sah_leaf_size)
+					{
+						make_leaf(node, begin, count);
+						return;
+					}
+
+					if (middle == begin || middle == end)
+					{
+						// every centroid landed in one bin or the leaf would be too big,
+						// fall back to a median split on the widest axis
+						const int axis = widest_axis(centroid_bounds);
+						middle = begin + count / 2;
+						std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+							[this, axis](std::uint32_t a, std::uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+					}
+
+					const std::uint32_t left = node_count.fetch_add(2);
+					node.first = left;
+					node.count = 0;
+
+					if (depth < parallel_depth && count >= parallel_build_threshold)
+					{
+						auto left_task = std::async(std::launch::async,
+							[this, left, begin, middle, depth]() { build(left, begin, middle, depth + 1); });
+						build(left + 1, middle, end, depth + 1);
+						left_task.get();
+					}
+					else
+					{
+						build(left, begin, middle, depth + 1);
+						build(left + 1, middle, end, depth + 1);
+					}
+				}
+
+				// binned surface area heuristic, returns the partition point or begin when a leaf is cheaper
+				std::uint32_t split(std::uint32_t begin, std::uint32_t end, const aabb& bounds, const aabb& centroid_bounds)
+				{
+					const std::uint32_t count = end - begin;
+
+					float best_cost = std::numeric_limits<float>::max();
+					int best_axis = -1;
+					std::uint32_t best_bin = 0;
+
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						const float extent = centroid_bounds.max_bounds[axis] - centroid_bounds.min_bounds[axis];
+						if (extent <= 0.0f)
+							continue;
+
+						aabb bins[bin_count];
+						std::uint32_t bin_sizes[bin_count] = {};
+						const float scale = bin_count / extent;
+
+						for (std::uint32_t i = begin; i < end; ++i)
+						{
+							const std::uint32_t item = order[i];
+							const std::uint32_t bin = bin_index(centroids[item][axis], centroid_bounds.min_bounds[axis], scale);
+							bins[bin].grow(min_bounds[item], max_bounds[item]);
+							++bin_sizes[bin];
+						}
+
+						// sweep from the right to get the cost of every right hand side
+						float right_area[bin_count];
+						std::uint32_t right_size[bin_count];
+						aabb right;
+						std::uint32_t right_total = 0;
+						for (std::uint32_t bin = bin_count - 1; bin > 0; --bin)
+						{
+							right.grow(bins[bin].min_bounds, bins[bin].max_bounds);
+							right_total += bin_sizes[bin];
+							right_area[bin] = right.half_area();
+							right_size[bin] = right_total;
+						}
+
+						aabb left;
+						std::uint32_t left_total = 0;
+						for (std::uint32_t bin = 0; bin < bin_count - 1; ++bin)
+						{
+							left.grow(bins[bin].min_bounds, bins[bin].max_bounds);
+							left_total += bin_sizes[bin];
+
+							const float cost = left.half_area() * left_total + right_area[bin + 1] * right_size[bin + 1];
+							if (cost < best_cost)
+							{
+								best_cost = cost;
+								best_axis = axis;
+								best_bin = bin;
+							}
+						}
+					}
+
+					// compare against not splitting at all, intersection and traversal costs are taken as equal
+					const float leaf_cost = bounds.half_area() * count;
+					if (best_axis < 0 || best_cost >= leaf_cost)
+						return begin;
+
+					const float extent = centroid_bounds.max_bounds[best_axis] - centroid_bounds.min_bounds[best_axis];
+					const float scale = bin_count / extent;
+					const float offset = centroid_bounds.min_bounds[best_axis];
+
+					auto middle = std::partition(order.begin() + begin, order.begin() + end,
+						[&](std::uint32_t item) {
+						return bin_index(centroids[item][best_axis], offset, scale) <= best_bin; });
+
+					return static_cast<std::uint32_t>(middle - order.begin());
+				}
+
+				static std::uint32_t bin_index(float value, float offset, float scale)
+				{
+					const auto bin = static_cast<std::uint32_t>((value - offset) * scale);
+					return std::min(bin, bin_count - 1);
+				}
+
+				static int widest_axis(const aabb& box)
+				{
+					const float dx = box.max_bounds[0] - box.min_bounds[0];
+					const float dy = box.max_bounds[1] - box.min_bounds[1];
+					const float dz = box.max_bounds[2] - box.min_bounds[2];
+					if (dx >= dy && dx >= dz) return 0;
+					return dy >= dz ? 1 : 2;
+				}
+
+				static void make_leaf(gltf_bvh_node& node, std::uint32_t begin, std::uint32_t count)
+				{
+					node.first = begin;
+					node.count = count;
+				}
+
+			private:
+				const std::vector<vec3>& min_bounds;
+				const std::vector<vec3>& max_bounds;
+				std::vector<vec3> centroids;
+				std::vector<gltf_bvh_node>& nodes;
+				std::vector<std::uint32_t>& order;
+				std::atomic<std::uint32_t> node_count{ 0 };
+				std::uint32_t parallel_depth = 0;	// log2 of the hardware threads, rounded up
+			};
+
+			enum class plane_result { outside, intersects, inside };
+
+			plane_result classify(const gltf_frustum_f& frustum, const vec3& min_bounds, const vec3& max_bounds)
+			{
+				plane_result result = plane_result::inside;
+				for (const auto& plane : frustum)
+				{
+					// furthest corner along the normal decides outside, the nearest decides fully inside
+					const float far_dist = plane[3]
+						+ plane[0] * (plane[0] >= 0 ? max_bounds[0] : min_bounds[0])
+						+ plane[1] * (plane[1] >= 0 ? max_bounds[1] : min_bounds[1])
+						+ plane[2] * (plane[2] >= 0 ? max_bounds[2] : min_bounds[2]);
+					if (far_dist < 0)
+						return plane_result::outside;
+
+					const float near_dist = plane[3]
+						+ plane[0] * (plane[0] >= 0 ? min_bounds[0] : max_bounds[0])
+						+ plane[1] * (plane[1] >= 0 ? min_bounds[1] : max_bounds[1])
+						+ plane[2] * (plane[2] >= 0 ? min_bounds[2] : max_bounds[2]);
+					if (near_dist < 0)
+						result = plane_result::intersects;
+				}
+
+				return result;
+			}
+
+			// adds every item under node_index without testing them
+			void collect_subtree(const gltf_scene_bvh& bvh, std::uint32_t node_index, std::vector<std::uint32_t>& result)
+			{
+				std::vector<std::uint32_t> stack{ node_index };
+				while (!stack.empty())
+				{
+					const gltf_bvh_node& node = bvh.nodes[stack.back()];
+					stack.pop_back();
+
+					if (node.count > 0)
+					{
+						for (std::uint32_t i = node.first; i < node.first + node.count; ++i)
+							result.push_back(bvh.node_indices[i]);
+					}
+					else
+					{
+						stack.push_back(node.first);
+						stack.push_back(node.first + 1);
+					}
+				}
+			}
+
+			struct ray_precompute
+			{
+				vec3 origin;
+				vec3 direction;
+				vec3 inv_direction;
+				float t_max;
+
+				explicit ray_precompute(const gltf_ray& ray) : origin{ ray.origin }, direction{ ray.direction },
+					t_max{ ray.t_max }
+				{
+					for (int i = 0; i < 3; ++i)
+					{
+						// a zero component gets a huge reciprocal, so the slab on that axis is
+						// either everything or nothing depending on where the origin is
+						inv_direction[i] = ray.direction[i] != 0.0f ? 1.0f / ray.direction[i]
+							: std::numeric_limits<float>::max();
+					}
+				}
+
+				// returns the entry distance or a negative value on a miss
+				float intersect(const vec3& min_bounds, const vec3& max_bounds) const
+				{
+					float t_enter = 0.0f;
+					float t_exit = t_max;
+					for (int i = 0; i < 3; ++i)
+					{
+						float t0 = (min_bounds[i] - origin[i]) * inv_direction[i];
+						float t1 = (max_bounds[i] - origin[i]) * inv_direction[i];
+						if (t0 > t1) std::swap(t0, t1);
+						t_enter = std::max(t_enter, t0);
+						t_exit = std::min(t_exit, t1);
+					}
+
+					return t_enter <= t_exit ? t_enter : -1.0f;
+				}
+			};
+
+			const float parallel_epsilon = 1e-12f;		// determinant below which ray and triangle are parallel
+
+			// Moller-Trumbore against the four triangles of a group, t_best shrinks as closer hits are found.
+			// Returns the lane that was hit or -1
+			int intersect_group(const gltf_triangle_group& g, const ray_precompute& r, float t_best, float& t_out,
+				float& u_out, float& v_out)
+			{
+#if defined(KNU_GLTF_SSE)
+				const __m128 dx = _mm_set1_ps(r.direction[0]);
+				const __m128 dy = _mm_set1_ps(r.direction[1]);
+				const __m128 dz = _mm_set1_ps(r.direction[2]);
+
+				const __m128 e1x = _mm_loadu_ps(g.edge1[0]), e1y = _mm_loadu_ps(g.edge1[1]), e1z = _mm_loadu_ps(g.edge1[2]);
+				const __m128 e2x = _mm_loadu_ps(g.edge2[0]), e2y = _mm_loadu_ps(g.edge2[1]), e2z = _mm_loadu_ps(g.edge2[2]);
+
+				// p = d x e2
+				const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+				const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+				const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+
+				const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+				const __m128 abs_det = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+				const __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+				// s = o - v0
+				const __m128 sx = _mm_sub_ps(_mm_set1_ps(r.origin[0]), _mm_loadu_ps(g.v0[0]));
+				const __m128 sy = _mm_sub_ps(_mm_set1_ps(r.origin[1]), _mm_loadu_ps(g.v0[1]));
+				const __m128 sz = _mm_sub_ps(_mm_set1_ps(r.origin[2]), _mm_loadu_ps(g.v0[2]));
+
+				const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)),
+					_mm_mul_ps(sz, pz)), inv_det);
+
+				// q = s x e1
+				const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+				const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+				const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+
+				const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)),
+					_mm_mul_ps(dz, qz)), inv_det);
+				const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+					_mm_mul_ps(e2z, qz)), inv_det);
+
+				const __m128 zero = _mm_setzero_ps();
+				__m128 mask = _mm_cmpgt_ps(abs_det, _mm_set1_ps(parallel_epsilon));
+				mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+				mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+				mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+				mask = _mm_and_ps(mask, _mm_cmpge_ps(t, zero));
+				mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(t_best)));
+
+				int bits = _mm_movemask_ps(mask);
+				if (bits == 0)
+					return -1;
+
+				alignas(16) float t_lanes[4], u_lanes[4], v_lanes[4];
+				_mm_store_ps(t_lanes, t);
+				_mm_store_ps(u_lanes, u);
+				_mm_store_ps(v_lanes, v);
+
+				int best = -1;
+				for (int lane = 0; lane < 4; ++lane)
+				{
+					if ((bits & (1 << lane)) && t_lanes[lane] < t_best)
+					{
+						best = lane;
+						t_best = t_lanes[lane];
+					}
+				}
+
+				t_out = t_lanes[best];
+				u_out = u_lanes[best];
+				v_out = v_lanes[best];
+				return best;
+#else
+				int best = -1;
+				for (int lane = 0; lane < 4; ++lane)
+				{
+					const vec3 e1 = { g.edge1[0][lane], g.edge1[1][lane], g.edge1[2][lane] };
+					const vec3 e2 = { g.edge2[0][lane], g.edge2[1][lane], g.edge2[2][lane] };
+					const vec3& d = r.direction;
+
+					const vec3 p = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+					const float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+					if (std::abs(det) <= parallel_epsilon)
+						continue;
+
+					const float inv_det = 1.0f / det;
+					const vec3 sv = { r.origin[0] - g.v0[0][lane], r.origin[1] - g.v0[1][lane], r.origin[2] - g.v0[2][lane] };
+					const float u = (sv[0] * p[0] + sv[1] * p[1] + sv[2] * p[2]) * inv_det;
+					if (u < 0.0f)
+						continue;
+
+					const vec3 q = { sv[1] * e1[2] - sv[2] * e1[1], sv[2] * e1[0] - sv[0] * e1[2], sv[0] * e1[1] - sv[1] * e1[0] };
+					const float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv_det;
+					const float t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv_det;
+					if (v < 0.0f || u + v > 1.0f || t < 0.0f || t >= t_best)
+						continue;
+
+					best = lane;
+					t_best = t;
+					t_out = t;
+					u_out = u;
+					v_out = v;
+				}
+
+				return best;
+#endif
+			}
+
+			// shared traversal of intersect and occluded, any_hit stops at the first triangle found
+			gltf_triangle_hit trace(const gltf_triangle_bvh& bvh, const gltf_ray& ray, bool any_hit)
+			{
+				gltf_triangle_hit hit;
+				if (bvh.nodes.empty())
+					return hit;
+
+				ray_precompute r{ ray };
+
+				std::vector<std::uint32_t> stack;
+				stack.reserve(64);
+				stack.push_back(0);
+
+				while (!stack.empty())
+				{
+					const gltf_bvh_node& node = bvh.nodes[stack.back()];
+					stack.pop_back();
+
+					if (r.intersect(node.min_bounds, node.max_bounds) < 0.0f)
+						continue;
+
+					if (node.count > 0)
+					{
+						const std::uint32_t group_count = (node.count + 3) / 4;
+						for (std::uint32_t i = node.first; i < node.first + group_count; ++i)
+						{
+							float t, u, v;
+							const int lane = intersect_group(bvh.groups[i], r, r.t_max, t, u, v);
+							if (lane < 0)
+								continue;
+
+							hit = gltf_triangle_hit{ bvh.groups[i].triangle[lane], t, u, v };
+							r.t_max = t;		// only closer hits from here on
+							if (any_hit)
+								return hit;
+						}
+					}
+					else
+					{
+						// visit the nearer child first so t_max shrinks sooner
+						const gltf_bvh_node& left = bvh.nodes[node.first];
+						const gltf_bvh_node& right = bvh.nodes[node.first + 1];
+						const float t_left = r.intersect(left.min_bounds, left.max_bounds);
+						const float t_right = r.intersect(right.min_bounds, right.max_bounds);
+
+						if (t_left >= 0.0f && t_right >= 0.0f)
+						{
+							const bool left_first = t_left <= t_right;
+							stack.push_back(left_first ? node.first + 1 : node.first);
+							stack.push_back(left_first ? node.first : node.first + 1);
+						}
+						else if (t_left >= 0.0f)
+							stack.push_back(node.first);
+						else if (t_right >= 0.0f)
+							stack.push_back(node.first + 1);
+					}
+				}
+
+				return hit;
+			}
+
+			// the corners of every triangle the primitive draws, in the order it draws them. Strips and fans
+			// are walked the way the GPU does, 0xffff starts a new one when the primitive uses restart
+			template <typename Real>
+			std::vector<std::array<std::uint32_t, 3>> drawn_triangles(const basic_gltf_partial_mesh<Real>& sub_mesh,
+				std::size_t vertex_count)
+			{
+				const std::uint32_t triangles_mode = 4, triangle_fan_mode = 6;
+				const std::uint32_t restart_index = 0xffff;
+
+				// a primitive without indices draws its vertices in order
+				std::vector<std::uint32_t> sequence(std::begin(sub_mesh.indices), std::end(sub_mesh.indices));
+				if (sequence.empty())
+				{
+					sequence.resize(vertex_count);
+					for (std::uint32_t i = 0; i < sequence.size(); ++i)
+						sequence[i] = i;
+				}
+
+				std::vector<std::array<std::uint32_t, 3>> triangles;
+				if (sub_mesh.render_mode == triangles_mode)
+				{
+					for (std::size_t i = 0; i + 3 <= sequence.size(); i += 3)
+						triangles.push_back({ sequence[i], sequence[i + 1], sequence[i + 2] });
+					return triangles;
+				}
+
+				std::size_t first = 0;	// where the current strip or fan started
+				for (std::size_t i = 0; i < sequence.size(); ++i)
+				{
+					if (sub_mesh.primitive_restart && sequence[i] == restart_index)
+					{
+						first = i + 1;
+						continue;
+					}
+
+					const std::size_t k = i - first;
+					if (k < 2)
+						continue;
+
+					if (sub_mesh.render_mode == triangle_fan_mode)
+						triangles.push_back({ sequence[first], sequence[i - 1], sequence[i] });
+					else if (k % 2 == 0)
+						triangles.push_back({ sequence[i - 2], sequence[i - 1], sequence[i] });
+					else
+						triangles.push_back({ sequence[i - 1], sequence[i - 2], sequence[i] });
+				}
+
+				return triangles;
+			}
+		}
+
+		gltf_scene_bvh build_scene_bvh(const std::vector<std::uint32_t>& node_indices,
+			const std::vector<std::array<float, 3>>& min_bounds,
+			const std::vector<std::array<float, 3>>& max_bounds)
+		{
+			gltf_scene_bvh bvh;
+			std::vector<std::uint32_t> order;
+			bvh_builder builder(min_bounds, max_bounds, bvh.nodes, order);
+
+			// store the items in leaf order so a leaf touches one contiguous range
+			bvh.node_indices.resize(order.size());
+			bvh.item_min_bounds.resize(order.size());
+			bvh.item_max_bounds.resize(order.size());
+			for (std::size_t i = 0; i < order.size(); ++i)
+			{
+				bvh.node_indices[i] = node_indices[order[i]];
+				bvh.item_min_bounds[i] = min_bounds[order[i]];
+				bvh.item_max_bounds[i] = max_bounds[order[i]];
+			}
+
+			return bvh;
+		}
+
+		std::vector<std::uint32_t> frustum_cull(const gltf_scene_bvh& bvh, const gltf_frustum_f& frustum)
+		{
+			std::vector<std::uint32_t> visible;
+			if (bvh.nodes.empty())
+				return visible;
+
+			std::vector<std::uint32_t> stack{ 0 };
+			while (!stack.empty())
+			{
+				const std::uint32_t node_index = stack.back();
+				const gltf_bvh_node& node = bvh.nodes[node_index];
+				stack.pop_back();
+
+				const plane_result result = classify(frustum, node.min_bounds, node.max_bounds);
+				if (result == plane_result::outside)
+					continue;
+
+				if (result == plane_result::inside)
+				{
+					collect_subtree(bvh, node_index, visible);
+				}
+				else if (node.count > 0)
+				{
+					for (std::uint32_t i = node.first; i < node.first + node.count; ++i)
+					{
+						if (classify(frustum, bvh.item_min_bounds[i], bvh.item_max_bounds[i]) != plane_result::outside)
+							visible.push_back(bvh.node_indices[i]);
+					}
+				}
+				else
+				{
+					stack.push_back(node.first);
+					stack.push_back(node.first + 1);
+				}
+			}
+
+			return visible;
+		}
+
+		std::vector<std::vector<std::uint32_t>> frustum_cull(const gltf_scene_bvh& bvh,
+			const std::vector<gltf_frustum_f>& frustums)
+		{
+			std::vector<std::vector<std::uint32_t>> results(frustums.size());
+			std::transform(std::execution::par, std::begin(frustums), std::end(frustums), std::begin(results),
+				[&bvh](const gltf_frustum_f& frustum) { return frustum_cull(bvh, frustum); });
+
+			return results;
+		}
+
+		std::vector<gltf_ray_hit> ray_query(const gltf_scene_bvh& bvh, const gltf_ray& ray)
+		{
+			std::vector<gltf_ray_hit> hits;
+			if (bvh.nodes.empty())
+				return hits;
+
+			const ray_precompute r{ ray };
+
+			std::vector<std::uint32_t> stack{ 0 };
+			while (!stack.empty())
+			{
+				const gltf_bvh_node& node = bvh.nodes[stack.back()];
+				stack.pop_back();
+
+				if (r.intersect(node.min_bounds, node.max_bounds) < 0.0f)
+					continue;
+
+				if (node.count > 0)
+				{
+					for (std::uint32_t i = node.first; i < node.first + node.count; ++i)
+					{
+						const float t = r.intersect(bvh.item_min_bounds[i], bvh.item_max_bounds[i]);
+						if (t >= 0.0f)
+							hits.push_back(gltf_ray_hit{ bvh.node_indices[i], t });
+					}
+				}
+				else
+				{
+					stack.push_back(node.first);
+					stack.push_back(node.first + 1);
+				}
+			}
+
+			std::sort(std::begin(hits), std::end(hits),
+				[](const gltf_ray_hit& a, const gltf_ray_hit& b) { return a.t < b.t; });
+
+			return hits;
+		}
+
+		std::vector<std::vector<gltf_ray_hit>> ray_query(const gltf_scene_bvh& bvh,
+			const std::vector<gltf_ray>& rays)
+		{
+			std::vector<std::vector<gltf_ray_hit>> results(rays.size());
+			std::transform(std::execution::par, std::begin(rays), std::end(rays), std::begin(results),
+				[&bvh](const gltf_ray& ray) { return ray_query(bvh, ray); });
+
+			return results;
+		}
+
+		template <typename Real>
+		gltf_triangle_bvh build_triangle_bvh(const basic_gltf_mesh<Real>& mesh,
+			const basic_gltf_partial_mesh<Real>& sub_mesh)
+		{
+			const std::uint32_t triangles_mode = 4, triangle_strip_mode = 5, triangle_fan_mode = 6;
+
+			gltf_triangle_bvh bvh;
+			if ((sub_mesh.render_mode != triangles_mode && sub_mesh.render_mode != triangle_strip_mode
+				&& sub_mesh.render_mode != triangle_fan_mode) || !sub_mesh.position_info.valid)
+				return bvh;
+
+			const detail::attribute_reader positions{ mesh.buffers, sub_mesh.position_info };
+			const std::vector<std::array<std::uint32_t, 3>> triangles = drawn_triangles(sub_mesh, positions.size());
+			const std::size_t triangle_count = triangles.size();
+
+			std::vector<std::array<vec3, 3>> corners(triangle_count);
+			std::vector<vec3> min_bounds(triangle_count);
+			std::vector<vec3> max_bounds(triangle_count);
+
+			for (std::size_t i = 0; i < triangle_count; ++i)
+			{
+				aabb box;
+				for (std::size_t c = 0; c < 3; ++c)
+				{
+					corners[i][c] = positions.vec3(triangles[i][c]);
+					box.grow(corners[i][c]);
+				}
+
+				min_bounds[i] = box.min_bounds;
+				max_bounds[i] = box.max_bounds;
+			}
+
+			std::vector<std::uint32_t> order;
+			bvh_builder builder(min_bounds, max_bounds, bvh.nodes, order);
+
+			// repack every leaf into whole groups of four, padding lanes get a degenerate
+			// triangle that the determinant test always rejects
+			for (gltf_bvh_node& node : bvh.nodes)
+			{
+				if (node.count == 0)
+					continue;
+
+				const std::uint32_t first_group = static_cast<std::uint32_t>(bvh.groups.size());
+				bvh.groups.resize(first_group + (node.count + 3) / 4, gltf_triangle_group{});
+
+				for (std::uint32_t k = 0; k < (node.count + 3) / 4 * 4; ++k)
+				{
+					gltf_triangle_group& group = bvh.groups[first_group + k / 4];
+					const std::uint32_t lane = k % 4;
+
+					if (k >= node.count)
+					{
+						group.triangle[lane] = gltf_triangle_bvh::no_triangle;
+						continue;
+					}
+
+					const std::uint32_t triangle = order[node.first + k];
+					const auto& tri = corners[triangle];
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						group.v0[axis][lane] = tri[0][axis];
+						group.edge1[axis][lane] = tri[1][axis] - tri[0][axis];
+						group.edge2[axis][lane] = tri[2][axis] - tri[0][axis];
+					}
+					group.triangle[lane] = triangle;
+				}
+
+				node.first = first_group;
+			}
+
+			return bvh;
+		}
+
+		gltf_triangle_hit intersect(const gltf_triangle_bvh& bvh, const gltf_ray& ray)
+		{
+			return trace(bvh, ray, false);
+		}
+
+		std::vector<gltf_triangle_hit> intersect(const gltf_triangle_bvh& bvh, const std::vector<gltf_ray>& rays)
+		{
+			std::vector<gltf_triangle_hit> hits(rays.size());
+			std::transform(std::execution::par, std::begin(rays), std::end(rays), std::begin(hits),
+				[&bvh](const gltf_ray& ray) { return trace(bvh, ray, false); });
+
+			return hits;
+		}
+
+		bool occluded(const gltf_triangle_bvh& bvh, const gltf_ray& ray)
+		{
+			return trace(bvh, ray, true).triangle != gltf_triangle_bvh::no_triangle;
+		}
+
+		template gltf_triangle_bvh build_triangle_bvh(const gltf_mesh&, const gltf_partial_mesh&);
+		template gltf_triangle_bvh build_triangle_bvh(const gltf_mesh_f&, const gltf_partial_mesh_f&);
+	} // namespace graphics
+} // namespace knu
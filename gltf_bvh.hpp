@@ -0,0 +1,112 @@
+#ifndef KNU_GLTF_BVH_HPP
+#define KNU_GLTF_BVH_HPP
+
+#include "gltf.hpp"
+#include "gltf_bounds.hpp"
+#include <limits>
+
+namespace knu
+{
+	namespace graphics
+	{
+		// one node of a flattened bounding volume hierarchy, 32 bytes so two fit in a cache line.
+		// An interior node has count == 0 and its children at first and first + 1,
+		// a leaf covers the items [first, first + count) of the owning hierarchy
+		struct gltf_bvh_node
+		{
+			std::array<float, 3> min_bounds;
+			std::uint32_t first;
+			std::array<float, 3> max_bounds;
+			std::uint32_t count;
+		};
+
+		// a hierarchy over the world space boxes of the scene nodes, nodes[0] is the root
+		struct gltf_scene_bvh
+		{
+			std::vector<gltf_bvh_node> nodes;
+			std::vector<std::uint32_t> node_indices;			// gltf node index of every item, in leaf order
+			std::vector<std::array<float, 3>> item_min_bounds;	// box of every item, in leaf order
+			std::vector<std::array<float, 3>> item_max_bounds;
+		};
+
+		struct gltf_ray
+		{
+			std::array<float, 3> origin;
+			std::array<float, 3> direction;		// does not need to be normalized
+			float t_max = std::numeric_limits<float>::max();
+		};
+
+		struct gltf_ray_hit
+		{
+			std::uint32_t node_index;
+			float t;		// where the ray enters the node's box, origin + t * direction
+		};
+
+		// four triangles stored as structure of arrays so one SSE register tests all of them against a ray.
+		// Vertex 0 and the two edges leaving it are kept, which is what Moller-Trumbore needs
+		struct gltf_triangle_group
+		{
+			float v0[3][4];
+			float edge1[3][4];
+			float edge2[3][4];
+			std::uint32_t triangle[4];		// the triangle's place in draw order, no_triangle for padding
+		};
+
+		// a triangle hierarchy for one primitive. Leaves point at groups instead of single
+		// triangles, a leaf with count triangles covers (count + 3) / 4 groups starting at first
+		struct gltf_triangle_bvh
+		{
+			static constexpr std::uint32_t no_triangle = 0xffffffff;
+
+			std::vector<gltf_bvh_node> nodes;
+			std::vector<gltf_triangle_group> groups;
+		};
+
+		struct gltf_triangle_hit
+		{
+			std::uint32_t triangle = gltf_triangle_bvh::no_triangle;	// no_triangle when nothing was hit
+			float t = 0.0f;
+			float u = 0.0f;		// barycentric coordinates of the hit point
+			float v = 0.0f;
+		};
+
+		// builds a binned SAH hierarchy over the given boxes, large subtrees are built in parallel.
+		// Item i is reported as node_indices[i] by the queries
+		gltf_scene_bvh build_scene_bvh(const std::vector<std::uint32_t>& node_indices,
+			const std::vector<std::array<float, 3>>& min_bounds,
+			const std::vector<std::array<float, 3>>& max_bounds);
+
+		// gltf node indices of every box inside or intersecting the frustum
+		std::vector<std::uint32_t> frustum_cull(const gltf_scene_bvh& bvh, const gltf_frustum_f& frustum);
+
+		// culls many frustums (cameras, shadow cascades) at once, one result per frustum
+		std::vector<std::vector<std::uint32_t>> frustum_cull(const gltf_scene_bvh& bvh,
+			const std::vector<gltf_frustum_f>& frustums);
+
+		// every box the ray passes through, nearest first
+		std::vector<gltf_ray_hit> ray_query(const gltf_scene_bvh& bvh, const gltf_ray& ray);
+
+		// one result per ray, the rays are traced in parallel
+		std::vector<std::vector<gltf_ray_hit>> ray_query(const gltf_scene_bvh& bvh,
+			const std::vector<gltf_ray>& rays);
+
+		// builds the triangle hierarchy of a TRIANGLES, TRIANGLE_STRIP or TRIANGLE_FAN primitive from its
+		// POSITION accessor and indices, other render modes give an empty hierarchy. Triangles are numbered
+		// in the order the primitive draws them, for lists that is the index into indices divided by 3.
+		// Usually requested through gltf_build_options::build_triangle_bvh rather than called directly
+		template <typename Real>
+		gltf_triangle_bvh build_triangle_bvh(const basic_gltf_mesh<Real>& mesh,
+			const basic_gltf_partial_mesh<Real>& sub_mesh);
+
+		// nearest triangle along the ray, the ray is in the mesh's local space
+		gltf_triangle_hit intersect(const gltf_triangle_bvh& bvh, const gltf_ray& ray);
+
+		// one nearest hit per ray, the rays are traced in parallel
+		std::vector<gltf_triangle_hit> intersect(const gltf_triangle_bvh& bvh, const std::vector<gltf_ray>& rays);
+
+		// true as soon as any triangle is hit before t_max, cheaper than intersect for line of sight
+		bool occluded(const gltf_triangle_bvh& bvh, const gltf_ray& ray);
+	}
+}
+
+#endif // !KNU_GLTF_BVH_HPP
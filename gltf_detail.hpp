@@ -0,0 +1,460 @@
+#ifndef KNU_GLTF_DETAIL_HPP
+#define KNU_GLTF_DETAIL_HPP
+
+// helpers shared between the gltf source files, not meant to be used by clients
+
+#include "gltf.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <execution>
+#include <limits>
+
+// the SSE2 paths of the source files, every x64 target has it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KNU_GLTF_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace knu
+{
+	namespace graphics
+	{
+		namespace detail
+		{
+			// column major 4x4 matrix, same layout as the gltf "matrix" property
+			using mat4 = std::array<double, 16>;
+
+			inline mat4 identity_matrix()
+			{
+				return { 1, 0, 0, 0,
+					0, 1, 0, 0,
+					0, 0, 1, 0,
+					0, 0, 0, 1 };
+			}
+
+			// builds T * R * S, rotation is a unit quaternion in form [vec3, w]
+			template <typename Real>
+			mat4 compose_trs(const std::array<Real, 3>& translation,
+				const std::array<Real, 4>& rotation, const std::array<Real, 3>& scale)
+			{
+				const double x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+
+				mat4 m = identity_matrix();
+				m[0] = (1.0 - 2.0 * (y * y + z * z)) * scale[0];
+				m[1] = (2.0 * (x * y + z * w)) * scale[0];
+				m[2] = (2.0 * (x * z - y * w)) * scale[0];
+
+				m[4] = (2.0 * (x * y - z * w)) * scale[1];
+				m[5] = (1.0 - 2.0 * (x * x + z * z)) * scale[1];
+				m[6] = (2.0 * (y * z + x * w)) * scale[1];
+
+				m[8] = (2.0 * (x * z + y * w)) * scale[2];
+				m[9] = (2.0 * (y * z - x * w)) * scale[2];
+				m[10] = (1.0 - 2.0 * (x * x + y * y)) * scale[2];
+
+				m[12] = translation[0];
+				m[13] = translation[1];
+				m[14] = translation[2];
+
+				return m;
+			}
+
+			inline mat4 multiply(const mat4& a, const mat4& b)
+			{
+				mat4 r{};
+				for (int col = 0; col < 4; ++col)
+					for (int row = 0; row < 4; ++row)
+					{
+						double sum = 0.0;
+						for (int k = 0; k < 4; ++k)
+							sum += a[k * 4 + row] * b[col * 4 + k];
+						r[col * 4 + row] = sum;
+					}
+
+				return r;
+			}
+
+			// transforms an axis aligned box and returns the box enclosing the result
+			// (Arvo's method, works on the center and the half extents)
+			template <typename In, typename Out>
+			void transform_aabb(const mat4& m, const std::array<In, 3>& min_in, const std::array<In, 3>& max_in,
+				std::array<Out, 3>& min_out, std::array<Out, 3>& max_out)
+			{
+				const double center[3] = { (min_in[0] + max_in[0]) * 0.5, (min_in[1] + max_in[1]) * 0.5,
+					(min_in[2] + max_in[2]) * 0.5 };
+				const double extent[3] = { (max_in[0] - min_in[0]) * 0.5, (max_in[1] - min_in[1]) * 0.5,
+					(max_in[2] - min_in[2]) * 0.5 };
+
+				for (int row = 0; row < 3; ++row)
+				{
+					double c = m[12 + row];
+					double e = 0.0;
+					for (int col = 0; col < 3; ++col)
+					{
+						c += m[col * 4 + row] * center[col];
+						e += std::abs(m[col * 4 + row]) * extent[col];
+					}
+
+					min_out[row] = static_cast<Out>(c - e);
+					max_out[row] = static_cast<Out>(c + e);
+				}
+			}
+
+			// gl component types, same values the accessors use
+			enum gl_component_type : std::uint32_t {
+				GL_BYTE = 5120, GL_UBYTE = 5121, GL_SHORT = 5122, GL_USHORT = 5123, GL_UINT = 5125,
+				GL_FLOAT = 5126, GL_HALF_FLOAT = 5131,		// half floats are not a gltf type, quantization makes them
+				GL_SMALLEST_THREE = 0x10000		// not a gl type at all, compressed rotations, see gltf_animation.cpp
+			};
+
+			// IEEE half to float, denormals, infinities and NaN included
+			inline float half_to_float(std::uint16_t h)
+			{
+				const std::uint32_t sign = std::uint32_t(h & 0x8000) << 16;
+				const std::uint32_t exponent = (h >> 10) & 0x1f;
+				const std::uint32_t mantissa = h & 0x3ff;
+
+				float magnitude;
+				if (exponent == 0)
+					magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+				else if (exponent == 31)
+					magnitude = mantissa ? std::numeric_limits<float>::quiet_NaN() : std::numeric_limits<float>::infinity();
+				else
+					magnitude = std::ldexp(static_cast<float>(mantissa | 0x400), int(exponent) - 25);
+
+				std::uint32_t bits;
+				std::memcpy(&bits, &magnitude, sizeof(bits));
+				bits |= sign;
+
+				float f;
+				std::memcpy(&f, &bits, sizeof(f));
+				return f;
+			}
+
+			// one vertex index per distinct position, shared by every vertex at that position. Shows up
+			// seams, vertices with equal positions whose other attributes differ
+			inline std::vector<std::uint32_t> position_ids(const std::vector<std::array<float, 3>>& positions)
+			{
+				std::vector<std::uint32_t> order(positions.size());
+				for (std::uint32_t i = 0; i < order.size(); ++i)
+					order[i] = i;
+
+				std::sort(std::begin(order), std::end(order),
+					[&positions](std::uint32_t a, std::uint32_t b) { return positions[a] < positions[b]; });
+
+				std::vector<std::uint32_t> ids(positions.size());
+				for (std::size_t i = 0; i < order.size(); ++i)
+					ids[order[i]] = (i > 0 && positions[order[i]] == positions[order[i - 1]]) ? ids[order[i - 1]] : order[i];
+
+				return ids;
+			}
+
+			// calls fn on every valid vertex attribute of a primitive, the morph target displacements last
+			template <typename Real, typename Fn>
+			void for_each_attribute(basic_gltf_partial_mesh<Real>& sub_mesh, Fn fn)
+			{
+				if (sub_mesh.position_info.valid) fn(sub_mesh.position_info);
+				if (sub_mesh.normal_info.valid) fn(sub_mesh.normal_info);
+				if (sub_mesh.tangent_info.valid) fn(sub_mesh.tangent_info);
+				for (auto& info : sub_mesh.texcoord_infos)
+					if (info.valid) fn(info);
+				for (auto& e : sub_mesh.attributes)
+					if (e.info.valid) fn(e.info);
+				for (auto& target : sub_mesh.targets)
+				{
+					if (target.position_info.valid) fn(target.position_info);
+					if (target.normal_info.valid) fn(target.normal_info);
+					if (target.tangent_info.valid) fn(target.tangent_info);
+				}
+			}
+
+			template <typename Real, typename Fn>
+			void for_each_attribute(const basic_gltf_partial_mesh<Real>& sub_mesh, Fn fn)
+			{
+				if (sub_mesh.position_info.valid) fn(sub_mesh.position_info);
+				if (sub_mesh.normal_info.valid) fn(sub_mesh.normal_info);
+				if (sub_mesh.tangent_info.valid) fn(sub_mesh.tangent_info);
+				for (const auto& info : sub_mesh.texcoord_infos)
+					if (info.valid) fn(info);
+				for (const auto& e : sub_mesh.attributes)
+					if (e.info.valid) fn(e.info);
+				for (const auto& target : sub_mesh.targets)
+				{
+					if (target.position_info.valid) fn(target.position_info);
+					if (target.normal_info.valid) fn(target.normal_info);
+					if (target.tangent_info.valid) fn(target.tangent_info);
+				}
+			}
+
+			// the POSITION count, without one the largest attribute count, and without any attribute
+			// the largest index plus one
+			template <typename Real>
+			std::size_t vertex_count_of(const basic_gltf_partial_mesh<Real>& sub_mesh)
+			{
+				if (sub_mesh.position_info.valid)
+					return sub_mesh.position_info.count;
+
+				std::size_t count = 0;
+				for_each_attribute(sub_mesh, [&count](const basic_gltf_component_info<Real>& info)
+				{
+					count = std::max<std::size_t>(count, info.count);
+				});
+
+				if (count == 0 && !sub_mesh.indices.empty())
+					count = *std::max_element(std::begin(sub_mesh.indices), std::end(sub_mesh.indices)) + std::size_t(1);
+
+				return count;
+			}
+
+			// any attribute of a primitive by semantic, the ones with a field of their own included
+			template <typename Real>
+			const basic_gltf_component_info<Real>* find_attribute(const basic_gltf_partial_mesh<Real>& sub_mesh,
+				gltf_semantic semantic)
+			{
+				const basic_gltf_component_info<Real>* info = nullptr;
+				switch (semantic)
+				{
+				case gltf_semantics::position: info = &sub_mesh.position_info; break;
+				case gltf_semantics::normal: info = &sub_mesh.normal_info; break;
+				case gltf_semantics::tangent: info = &sub_mesh.tangent_info; break;
+				case gltf_semantics::texcoord_0:
+					info = sub_mesh.texcoord_infos.size() > 0 ? &sub_mesh.texcoord_infos[0] : nullptr; break;
+				case gltf_semantics::texcoord_1:
+					info = sub_mesh.texcoord_infos.size() > 1 ? &sub_mesh.texcoord_infos[1] : nullptr; break;
+				default:
+				{
+					info = sub_mesh.attributes.find(semantic);
+
+					// sets past TEXCOORD_1 have no fixed id
+					const std::string name = info ? std::string{} : gltf_semantic_name(semantic);
+					const std::string prefix = "TEXCOORD_";
+					if (name.compare(0, prefix.size(), prefix) == 0 && name.size() > prefix.size())
+					{
+						const std::size_t set = std::stoul(name.substr(prefix.size()));
+						info = set < sub_mesh.texcoord_infos.size() ? &sub_mesh.texcoord_infos[set] : nullptr;
+					}
+				} break;
+				}
+
+				return info && info->valid ? info : nullptr;
+			}
+
+			// read access to one attribute inside the mesh's buffers. Integer components are
+			// treated as normalized, which is what gltf requires for every float attribute
+			// that is not stored as float
+			class attribute_reader
+			{
+			public:
+				template <typename Real>
+				attribute_reader(const std::vector<gltf_buffer>& buffers, const basic_gltf_component_info<Real>& info) :
+					attribute_reader{ info, buffers[info.buffer_index] }
+				{}
+
+				// reads from buffer no matter what info.buffer_index says, for buffers not added to a mesh yet
+				template <typename Real>
+				attribute_reader(const basic_gltf_component_info<Real>& info, const gltf_buffer& buffer) :
+					attribute_reader{ info, buffer.data.data() }
+				{}
+
+				// reads from the bytes of a buffer that is not a gltf_buffer at all
+				template <typename Real>
+				attribute_reader(const basic_gltf_component_info<Real>& info, const std::uint8_t* data) :
+					base{ data + info.byte_offset },
+					component_type{ info.component_type },
+					component_count{ info.component_count },
+					count{ info.count }
+				{
+					stride = info.byte_stride != 0 ? info.byte_stride : component_size() * component_count;
+				}
+
+				std::size_t size() const { return count; }
+				std::uint32_t components() const { return component_count; }
+				std::uint32_t element_size() const { return component_size() * component_count; }
+
+				// the raw bytes of one element, element_size() long
+				const std::uint8_t* element(std::size_t i) const { return base + i * stride; }
+
+				float component(std::size_t element, std::uint32_t c) const
+				{
+					const std::uint8_t* p = base + element * stride + c * component_size();
+					switch (component_type)
+					{
+					case GL_FLOAT: { float f; std::memcpy(&f, p, sizeof(f)); return f; }
+					case GL_UBYTE: return *p / 255.0f;
+					case GL_BYTE: return std::max(static_cast<std::int8_t>(*p) / 127.0f, -1.0f);
+					case GL_USHORT: { std::uint16_t v; std::memcpy(&v, p, sizeof(v)); return v / 65535.0f; }
+					case GL_SHORT: { std::int16_t v; std::memcpy(&v, p, sizeof(v)); return std::max(v / 32767.0f, -1.0f); }
+					case GL_HALF_FLOAT: { std::uint16_t v; std::memcpy(&v, p, sizeof(v)); return half_to_float(v); }
+					default: return 0.0f;
+					}
+				}
+
+				// the stored integer as it is, for JOINTS and other values that are not normalized
+				std::uint32_t integer(std::size_t element, std::uint32_t c) const
+				{
+					const std::uint8_t* p = base + element * stride + c * component_size();
+					switch (component_type)
+					{
+					case GL_UBYTE: case GL_BYTE: return *p;
+					case GL_USHORT: case GL_SHORT: { std::uint16_t v; std::memcpy(&v, p, sizeof(v)); return v; }
+					case GL_UINT: { std::uint32_t v; std::memcpy(&v, p, sizeof(v)); return v; }
+					default: return static_cast<std::uint32_t>(component(element, c));
+					}
+				}
+
+				std::uint32_t type() const { return component_type; }
+
+				std::array<float, 3> vec3(std::size_t element) const
+				{
+					return { component(element, 0), component(element, 1), component(element, 2) };
+				}
+
+			private:
+				std::uint32_t component_size() const
+				{
+					switch (component_type)
+					{
+					case GL_BYTE: case GL_UBYTE: return 1;
+					case GL_SHORT: case GL_USHORT: case GL_HALF_FLOAT: return 2;
+					default: return 4;
+					}
+				}
+
+				const std::uint8_t* base;
+				std::uint32_t component_type;
+				std::uint32_t component_count;
+				std::uint32_t count;
+				std::uint32_t stride;
+			};
+
+			// the xyz of every element of an attribute as floats
+			template <typename Real>
+			std::vector<std::array<float, 3>> read_vec3(const std::vector<gltf_buffer>& buffers, const basic_gltf_component_info<Real>& info)
+			{
+				const attribute_reader reader{ buffers, info };
+				std::vector<std::array<float, 3>> values(reader.size());
+				for (std::size_t i = 0; i < values.size(); ++i)
+					values[i] = reader.vec3(i);
+
+				return values;
+			}
+
+			// gathers source_vertices of every attribute of the primitive into one new, tightly packed
+			// buffer and points the attributes at it as buffer_index. The buffer is returned instead of
+			// added to the mesh so that primitives can be processed in parallel
+			template <typename Real>
+			gltf_buffer gather_vertices(const std::vector<gltf_buffer>& buffers, basic_gltf_partial_mesh<Real>& sub_mesh,
+				const std::vector<std::uint32_t>& source_vertices, std::uint32_t buffer_index)
+			{
+				std::size_t byte_length = 0;
+				for_each_attribute(sub_mesh, [&](const basic_gltf_component_info<Real>& info)
+				{
+					const attribute_reader reader{ buffers, info };
+					byte_length += (reader.element_size() * source_vertices.size() + 3) & ~std::size_t(3);
+				});
+
+				gltf_buffer buffer{ byte_length, std::vector<std::uint8_t>(byte_length) };
+				std::size_t offset = 0;
+
+				for_each_attribute(sub_mesh, [&](basic_gltf_component_info<Real>& info)
+				{
+					const attribute_reader reader{ buffers, info };
+					const std::uint32_t element_size = reader.element_size();
+
+					std::uint8_t* out = buffer.data.data() + offset;
+					for (std::size_t i = 0; i < source_vertices.size(); ++i)
+						std::memcpy(out + i * element_size, reader.element(source_vertices[i]), element_size);
+
+					info.buffer_index = buffer_index;
+					info.byte_offset = static_cast<std::uint32_t>(offset);
+					info.byte_stride = 0;
+					info.count = static_cast<std::uint32_t>(source_vertices.size());
+
+					// float bounds have to stay exact, so they follow the vertices that are left
+					if (info.component_type == GL_FLOAT && !source_vertices.empty())
+					{
+						const attribute_reader packed{ info, buffer };
+						const std::uint32_t components = std::min<std::uint32_t>(info.component_count, 3);
+						for (std::uint32_t c = 0; c < components; ++c)
+						{
+							info.min_bounds[c] = std::numeric_limits<Real>::max();
+							info.max_bounds[c] = std::numeric_limits<Real>::lowest();
+						}
+
+						for (std::size_t i = 0; i < source_vertices.size(); ++i)
+							for (std::uint32_t c = 0; c < components; ++c)
+							{
+								const Real value = static_cast<Real>(packed.component(i, c));
+								info.min_bounds[c] = std::min(info.min_bounds[c], value);
+								info.max_bounds[c] = std::max(info.max_bounds[c], value);
+							}
+					}
+
+					offset += (element_size * source_vertices.size() + 3) & ~std::size_t(3);
+				});
+
+				return buffer;
+			}
+
+			// drops the buffers no attribute points at any more and renumbers the rest
+			template <typename Real>
+			void remove_unused_buffers(basic_gltf_mesh<Real>& mesh)
+			{
+				std::vector<bool> used(mesh.buffers.size(), false);
+				for (const auto& sub_mesh : mesh.sub_meshes)
+					for_each_attribute(sub_mesh, [&used](const basic_gltf_component_info<Real>& info) { used[info.buffer_index] = true; });
+
+				std::vector<std::uint32_t> new_index(mesh.buffers.size(), 0);
+				std::vector<gltf_buffer> kept;
+				for (std::size_t i = 0; i < mesh.buffers.size(); ++i)
+				{
+					if (!used[i])
+						continue;
+
+					new_index[i] = static_cast<std::uint32_t>(kept.size());
+					kept.emplace_back(std::move(mesh.buffers[i]));
+				}
+
+				mesh.buffers = std::move(kept);
+				for (auto& sub_mesh : mesh.sub_meshes)
+					for_each_attribute(sub_mesh, [&new_index](basic_gltf_component_info<Real>& info) { info.buffer_index = new_index[info.buffer_index]; });
+			}
+
+			// runs select_vertices on every primitive in parallel. When it returns true the primitive's
+			// attributes are rebuilt from the vertex list it filled in, into a buffer of its own
+			template <typename Real, typename Fn>
+			void rebuild_vertices(basic_gltf_mesh<Real>& mesh, Fn select_vertices)
+			{
+				// every primitive writes its own buffer slot, they are appended once all are done
+				const std::size_t first_new_buffer = mesh.buffers.size();
+				std::vector<gltf_buffer> new_buffers(mesh.sub_meshes.size());
+
+				std::vector<std::size_t> slots(mesh.sub_meshes.size());
+				for (std::size_t i = 0; i < slots.size(); ++i)
+					slots[i] = i;
+
+				std::for_each(std::execution::par, std::begin(slots), std::end(slots), [&](std::size_t slot)
+				{
+					basic_gltf_partial_mesh<Real>& sub_mesh = mesh.sub_meshes[slot];
+
+					std::vector<std::uint32_t> source_vertices;
+					if (!select_vertices(sub_mesh, source_vertices))
+						return;
+
+					new_buffers[slot] = gather_vertices(mesh.buffers, sub_mesh, source_vertices,
+						static_cast<std::uint32_t>(first_new_buffer + slot));
+				});
+
+				// skipped primitives leave an empty buffer behind, which the clean up removes
+				for (std::size_t slot = 0; slot < new_buffers.size(); ++slot)
+					mesh.buffers.emplace_back(std::move(new_buffers[slot]));
+
+				remove_unused_buffers(mesh);
+			}
+		}
+	}
+}
+
+#endif // !KNU_GLTF_DETAIL_HPP
@@ -0,0 +1,130 @@
+#include "gltf_indirect.hpp"
+#include "gltf_detail.hpp"
+#include <algorithm>
+#include <execution>
+#include <stdexcept>
+#include <tuple>
+
+namespace knu
+{
+	namespace graphics
+	{
+		namespace
+		{
+			// one primitive of one node, where its data goes in the arenas
+			struct draw_source
+			{
+				std::uint32_t node;
+				std::uint32_t sub_mesh;
+				std::uint32_t vertex_count;
+				std::uint32_t first_vertex;
+				std::uint32_t first_index;
+				std::uint32_t index_count;
+			};
+		}
+
+		template <typename Real>
+		gltf_indirect_draws build_indirect_draws(const std::vector<basic_gltf_node<Real>>& nodes,
+			const gltf_vertex_layout& layout, const std::vector<std::array<float, 16>>& transforms)
+		{
+			// up front, an exception out of the parallel writes would terminate
+			if (!is_valid_layout(layout))
+				throw std::invalid_argument("vertex layout has an element past its stride");
+
+			gltf_indirect_draws draws;
+			draws.layout = layout;
+
+			for (std::size_t n = 0; n < nodes.size(); ++n)
+			{
+				if (n < transforms.size())
+				{
+					draws.transforms.push_back(transforms[n]);
+					continue;
+				}
+
+				const detail::mat4 m = detail::compose_trs(nodes[n].translation, nodes[n].rotation, nodes[n].scale);
+				std::array<float, 16> transform;
+				std::transform(std::begin(m), std::end(m), std::begin(transform), [](double v) { return static_cast<float>(v); });
+				draws.transforms.push_back(transform);
+			}
+
+			// the arena ranges of every primitive first, in node order
+			std::vector<draw_source> sources;
+			std::size_t vertex_total = 0;
+			std::size_t index_total = 0;
+			for (std::uint32_t n = 0; n < nodes.size(); ++n)
+			{
+				const auto& sub_meshes = nodes[n].mesh.sub_meshes;
+				for (std::uint32_t s = 0; s < sub_meshes.size(); ++s)
+				{
+					const std::size_t vertex_count = detail::vertex_count_of(sub_meshes[s]);
+					const std::size_t index_count = sub_meshes[s].indices.empty() ? vertex_count : sub_meshes[s].indices.size();
+					if (vertex_count == 0 || index_count == 0 || (sub_meshes[s].indices.empty() && vertex_count > 0x10000))
+						continue;
+
+					sources.push_back(draw_source{ n, s, static_cast<std::uint32_t>(vertex_count),
+						static_cast<std::uint32_t>(vertex_total), static_cast<std::uint32_t>(index_total),
+						static_cast<std::uint32_t>(index_count) });
+					vertex_total += vertex_count;
+					index_total += index_count;
+				}
+			}
+
+			draws.vertices.resize(vertex_total * layout.stride);
+			draws.indices.resize(index_total);
+
+			std::for_each(std::execution::par, std::begin(sources), std::end(sources), [&](const draw_source& source)
+			{
+				const basic_gltf_mesh<Real>& mesh = nodes[source.node].mesh;
+				const basic_gltf_partial_mesh<Real>& sub_mesh = mesh.sub_meshes[source.sub_mesh];
+
+				write_vertex_buffer(mesh, sub_mesh, layout, draws.vertices.data() + std::size_t(source.first_vertex) * layout.stride);
+
+				// indices stay relative to the primitive, base_vertex moves them
+				std::uint16_t* out = draws.indices.data() + source.first_index;
+				if (sub_mesh.indices.empty())
+				{
+					for (std::uint32_t i = 0; i < source.index_count; ++i)
+						out[i] = static_cast<std::uint16_t>(i);
+				}
+				else
+				{
+					std::copy(std::begin(sub_mesh.indices), std::end(sub_mesh.indices), out);
+				}
+			});
+
+			// commands in the order the multi draw calls want them
+			auto key = [&nodes](const draw_source& source)
+			{
+				const auto& sub_mesh = nodes[source.node].mesh.sub_meshes[source.sub_mesh];
+				return std::make_tuple(sub_mesh.render_mode, sub_mesh.primitive_restart, sub_mesh.material_index);
+			};
+
+			std::stable_sort(std::begin(sources), std::end(sources),
+				[&key](const draw_source& a, const draw_source& b) { return key(a) < key(b); });
+
+			for (const draw_source& source : sources)
+			{
+				const auto& sub_mesh = nodes[source.node].mesh.sub_meshes[source.sub_mesh];
+				const std::uint32_t draw = static_cast<std::uint32_t>(draws.commands.size());
+
+				draws.commands.push_back(gltf_draw_command{ source.index_count, 1, source.first_index,
+					static_cast<std::int32_t>(source.first_vertex), draw });
+				draws.records.push_back(gltf_draw_record{ sub_mesh.material_index, source.node });
+
+				if (draws.groups.empty() || draws.groups.back().render_mode != sub_mesh.render_mode
+					|| draws.groups.back().primitive_restart != sub_mesh.primitive_restart)
+					draws.groups.push_back(gltf_draw_group{ sub_mesh.render_mode, sub_mesh.primitive_restart, draw, 0 });
+
+				++draws.groups.back().command_count;
+			}
+
+			return draws;
+		}
+
+		template gltf_indirect_draws build_indirect_draws(const std::vector<gltf_node>&, const gltf_vertex_layout&,
+			const std::vector<std::array<float, 16>>&);
+		template gltf_indirect_draws build_indirect_draws(const std::vector<gltf_node_f>&, const gltf_vertex_layout&,
+			const std::vector<std::array<float, 16>>&);
+	} // namespace graphics
+} // namespace knu
@@ -0,0 +1,64 @@
+#ifndef KNU_GLTF_INDIRECT_HPP
+#define KNU_GLTF_INDIRECT_HPP
+
+#include "gltf.hpp"
+#include "gltf_interleave.hpp"
+
+namespace knu
+{
+	namespace graphics
+	{
+		// same layout as DrawElementsIndirectCommand (GL) and VkDrawIndexedIndirectCommand, the
+		// array can be copied into the indirect buffer as it is
+		struct gltf_draw_command
+		{
+			std::uint32_t count;			// indices
+			std::uint32_t instance_count;
+			std::uint32_t first_index;		// into the index arena
+			std::int32_t base_vertex;		// into the vertex arena
+			std::uint32_t base_instance;	// the draw's record, shaders find it through gl_BaseInstance
+		};
+
+		static_assert(sizeof(gltf_draw_command) == 20, "gltf_draw_command has to match the GPU layout");
+
+		// what a shader needs per draw besides the vertices
+		struct gltf_draw_record
+		{
+			std::uint32_t material_index;
+			std::uint32_t transform_index;	// into gltf_indirect_draws::transforms
+		};
+
+		// commands that one multi draw call can issue, they share the primitive mode and restart state
+		struct gltf_draw_group
+		{
+			std::uint32_t render_mode;
+			bool primitive_restart;		// 0xffff restarts, enable it for the call
+			std::uint32_t first_command;
+			std::uint32_t command_count;
+		};
+
+		// everything a GPU driven renderer uploads once for a scene, one vertex arena, one 16 bit index
+		// arena and the commands into them. Commands are sorted by mode, restart and then material
+		struct gltf_indirect_draws
+		{
+			gltf_vertex_layout layout;
+			std::vector<std::uint8_t> vertices;
+			std::vector<std::uint16_t> indices;
+			std::vector<gltf_draw_command> commands;
+			std::vector<gltf_draw_record> records;				// one per command, in the same order
+			std::vector<std::array<float, 16>> transforms;		// one per node, column major
+			std::vector<gltf_draw_group> groups;
+		};
+
+		// builds the arenas and commands for the primitives of the nodes, vertices in the layout. The node
+		// transform is transforms[i] when given (world matrices, say), else its own scale, rotation and
+		// translation. Primitives without indices get them when their vertices fit 16 bit indices and are
+		// skipped otherwise. Vertices and indices are written in parallel, a layout that fails
+		// is_valid_layout throws std::invalid_argument
+		template <typename Real>
+		gltf_indirect_draws build_indirect_draws(const std::vector<basic_gltf_node<Real>>& nodes,
+			const gltf_vertex_layout& layout, const std::vector<std::array<float, 16>>& transforms = {});
+	}
+}
+
+#endif // !KNU_GLTF_INDIRECT_HPP
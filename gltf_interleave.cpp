@@ -0,0 +1,331 @@
+#include "gltf_interleave.hpp"
+#include "gltf_detail.hpp"
+#include "gltf_quantize.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <execution>
+#include <stdexcept>
+
+namespace knu
+{
+	namespace graphics
+	{
+		namespace
+		{
+			// vertices are put together here before they are streamed out, small enough to stay in L1
+			const std::size_t block_bytes = 4096;
+
+			std::uint32_t format_components(gltf_vertex_format format)
+			{
+				switch (format)
+				{
+				case gltf_vertex_format::float1: return 1;
+				case gltf_vertex_format::float2: case gltf_vertex_format::half2:
+				case gltf_vertex_format::unorm16x2: case gltf_vertex_format::snorm16x2: return 2;
+				case gltf_vertex_format::float3: return 3;
+				default: return 4;
+				}
+			}
+
+			// the source component type and count that can be copied byte for byte into the format
+			bool same_layout(gltf_vertex_format format, std::uint32_t component_type, std::uint32_t component_count)
+			{
+				const std::uint32_t components = format_components(format);
+				switch (format)
+				{
+				case gltf_vertex_format::float1: case gltf_vertex_format::float2:
+				case gltf_vertex_format::float3: case gltf_vertex_format::float4:
+					return component_type == detail::GL_FLOAT && component_count == components;
+				case gltf_vertex_format::half2: case gltf_vertex_format::half4:
+					return component_type == detail::GL_HALF_FLOAT && component_count == components;
+				case gltf_vertex_format::unorm8x4: case gltf_vertex_format::uint8x4:
+					return component_type == detail::GL_UBYTE && component_count == 4;
+				case gltf_vertex_format::snorm8x4:
+					return component_type == detail::GL_BYTE && component_count == 4;
+				case gltf_vertex_format::unorm16x2: case gltf_vertex_format::unorm16x4: case gltf_vertex_format::uint16x4:
+					return component_type == detail::GL_USHORT && component_count == components;
+				case gltf_vertex_format::snorm16x2: case gltf_vertex_format::snorm16x4:
+					return component_type == detail::GL_SHORT && component_count == components;
+				}
+
+				return false;
+			}
+
+			// how an attribute written by quantize_vertices is turned back into what it stood for
+			enum class decoding { none, position, octahedral, octahedral_tangent };
+
+			// one element of the layout bound to the primitive's attribute, if it has one
+			struct element_source
+			{
+				gltf_vertex_format format;
+				std::uint32_t offset;
+				std::uint32_t size;
+				bool present;
+				bool copy;			// same bytes in the source, memcpy will do
+				detail::attribute_reader reader;
+				decoding decode;
+				gltf_quantization quantization;
+			};
+
+			template <typename T>
+			void store(std::uint8_t* out, const T* values, std::uint32_t count)
+			{
+				std::memcpy(out, values, sizeof(T) * count);
+			}
+
+			void convert(const element_source& element, std::size_t vertex, std::uint8_t* out)
+			{
+				const std::uint32_t components = format_components(element.format);
+				const std::uint32_t source_components = element.reader.components();
+
+				// missing components are 0, a missing fourth one 1 (alpha of an rgb color)
+				float values[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+				std::uint32_t integers[4] = { 0, 0, 0, 0 };
+				if (element.decode == decoding::position)
+				{
+					for (std::uint32_t c = 0; c < 3; ++c)
+						values[c] = element.quantization.position_offset[c]
+							+ element.quantization.position_scale[c] * element.reader.component(vertex, c);
+				}
+				else if (element.decode != decoding::none)
+				{
+					const std::array<float, 3> v = decode_octahedral(element.reader.component(vertex, 0), element.reader.component(vertex, 1));
+					std::copy(std::begin(v), std::end(v), values);
+					if (element.decode == decoding::octahedral_tangent)
+						values[3] = element.reader.component(vertex, 2) < 0.0f ? -1.0f : 1.0f;
+				}
+				else
+				{
+					for (std::uint32_t c = 0; c < components && c < source_components; ++c)
+					{
+						values[c] = element.reader.component(vertex, c);
+						integers[c] = element.reader.integer(vertex, c);
+					}
+				}
+
+				auto unorm = [](float v, float max_value) { return std::nearbyint(std::min(std::max(v, 0.0f), 1.0f) * max_value); };
+				auto snorm = [](float v, float max_value) { return std::nearbyint(std::min(std::max(v, -1.0f), 1.0f) * max_value); };
+
+				switch (element.format)
+				{
+				case gltf_vertex_format::float1: case gltf_vertex_format::float2:
+				case gltf_vertex_format::float3: case gltf_vertex_format::float4:
+					store(out, values, components);
+					break;
+
+				case gltf_vertex_format::half2: case gltf_vertex_format::half4:
+				{
+					std::uint16_t halves[4];
+					float_to_half(values, halves, components);
+					store(out, halves, components);
+				} break;
+
+				case gltf_vertex_format::unorm8x4:
+				case gltf_vertex_format::snorm8x4:
+				case gltf_vertex_format::uint8x4:
+				{
+					std::uint8_t bytes[4];
+					for (int c = 0; c < 4; ++c)
+					{
+						if (element.format == gltf_vertex_format::unorm8x4)
+							bytes[c] = static_cast<std::uint8_t>(unorm(values[c], 255.0f));
+						else if (element.format == gltf_vertex_format::snorm8x4)
+							bytes[c] = static_cast<std::uint8_t>(static_cast<std::int8_t>(snorm(values[c], 127.0f)));
+						else
+							bytes[c] = static_cast<std::uint8_t>(std::min<std::uint32_t>(integers[c], 255));
+					}
+					store(out, bytes, 4);
+				} break;
+
+				case gltf_vertex_format::unorm16x2: case gltf_vertex_format::unorm16x4:
+				case gltf_vertex_format::snorm16x2: case gltf_vertex_format::snorm16x4:
+				case gltf_vertex_format::uint16x4:
+				{
+					std::uint16_t shorts[4];
+					for (std::uint32_t c = 0; c < components; ++c)
+					{
+						if (element.format == gltf_vertex_format::unorm16x2 || element.format == gltf_vertex_format::unorm16x4)
+							shorts[c] = static_cast<std::uint16_t>(unorm(values[c], 65535.0f));
+						else if (element.format == gltf_vertex_format::uint16x4)
+							shorts[c] = static_cast<std::uint16_t>(std::min<std::uint32_t>(integers[c], 65535));
+						else
+							shorts[c] = static_cast<std::uint16_t>(static_cast<std::int16_t>(snorm(values[c], 32767.0f)));
+					}
+					store(out, shorts, components);
+				} break;
+				}
+			}
+
+			// copies with non-temporal stores where the destination is aligned, so the output
+			// does not push the source data out of the cache
+			void stream_copy(std::uint8_t* destination, const std::uint8_t* source, std::size_t bytes)
+			{
+#if defined(KNU_GLTF_SSE)
+				const std::size_t misalignment = reinterpret_cast<std::uintptr_t>(destination) & 15;
+				const std::size_t head = std::min(bytes, misalignment ? 16 - misalignment : 0);
+				std::memcpy(destination, source, head);
+				destination += head;
+				source += head;
+				bytes -= head;
+
+				for (; bytes >= 16; bytes -= 16, destination += 16, source += 16)
+					_mm_stream_si128(reinterpret_cast<__m128i*>(destination), _mm_loadu_si128(reinterpret_cast<const __m128i*>(source)));
+#endif
+				std::memcpy(destination, source, bytes);
+			}
+
+			void check_layout(const gltf_vertex_layout& layout)
+			{
+				if (!is_valid_layout(layout))
+					throw std::invalid_argument("vertex layout has an element past its stride");
+			}
+		}
+
+		std::uint32_t format_size(gltf_vertex_format format)
+		{
+			switch (format)
+			{
+			case gltf_vertex_format::float1: return 4;
+			case gltf_vertex_format::float2: return 8;
+			case gltf_vertex_format::float3: return 12;
+			case gltf_vertex_format::float4: return 16;
+			case gltf_vertex_format::half2: return 4;
+			case gltf_vertex_format::half4: return 8;
+			case gltf_vertex_format::unorm8x4: case gltf_vertex_format::snorm8x4: case gltf_vertex_format::uint8x4: return 4;
+			case gltf_vertex_format::unorm16x2: case gltf_vertex_format::snorm16x2: return 4;
+			default: return 8;
+			}
+		}
+
+		bool is_valid_layout(const gltf_vertex_layout& layout)
+		{
+			return std::all_of(std::begin(layout.elements), std::end(layout.elements), [&layout](const gltf_vertex_element& element)
+			{
+				return std::uint64_t(element.offset) + format_size(element.format) <= layout.stride;
+			});
+		}
+
+		template <typename Real>
+		std::size_t write_vertex_buffer(const basic_gltf_mesh<Real>& mesh, const basic_gltf_partial_mesh<Real>& sub_mesh,
+			const gltf_vertex_layout& layout, void* destination)
+		{
+			check_layout(layout);
+			const std::size_t vertex_count = detail::vertex_count_of(sub_mesh);
+			const std::size_t stride = layout.stride;
+			if (vertex_count == 0 || stride == 0)
+				return vertex_count;
+
+			// resolve every element once, not once per vertex
+			std::vector<element_source> elements;
+			const basic_gltf_component_info<Real> missing{};
+			const gltf_buffer no_buffer{};
+			for (const gltf_vertex_element& element : layout.elements)
+			{
+				const basic_gltf_component_info<Real>* info = detail::find_attribute(sub_mesh, element.semantic);
+				const bool present = info != nullptr && info->count >= vertex_count;
+				const detail::attribute_reader reader = present ? detail::attribute_reader{ mesh.buffers, *info }
+					: detail::attribute_reader{ missing, no_buffer };
+
+				// quantized streams are decoded with the primitive's quantization, never copied
+				decoding decode = decoding::none;
+				if (present && sub_mesh.quantization.valid)
+				{
+					if (info == &sub_mesh.position_info && info->component_type == detail::GL_USHORT)
+						decode = decoding::position;
+					else if (info == &sub_mesh.normal_info && sub_mesh.quantization.normal_bits != 0 && info->component_count == 2)
+						decode = decoding::octahedral;
+					else if (info == &sub_mesh.tangent_info && sub_mesh.quantization.normal_bits != 0 && info->component_count == 3)
+						decode = decoding::octahedral_tangent;
+				}
+
+				elements.push_back(element_source{ element.format, element.offset, format_size(element.format), present,
+					present && decode == decoding::none && same_layout(element.format, info->component_type, info->component_count),
+					reader, decode, sub_mesh.quantization });
+			}
+
+			const std::size_t block_vertices = std::max<std::size_t>(1, block_bytes / stride);
+			std::vector<std::uint8_t> block(block_vertices * stride);
+			std::uint8_t* out = static_cast<std::uint8_t*>(destination);
+
+			for (std::size_t first = 0; first < vertex_count; first += block_vertices)
+			{
+				const std::size_t count = std::min(block_vertices, vertex_count - first);
+				std::fill(std::begin(block), std::begin(block) + count * stride, std::uint8_t(0));
+
+				for (const element_source& element : elements)
+				{
+					if (!element.present)
+						continue;
+
+					std::uint8_t* vertex = block.data() + element.offset;
+					if (element.copy)
+					{
+						for (std::size_t i = 0; i < count; ++i, vertex += stride)
+							std::memcpy(vertex, element.reader.element(first + i), element.size);
+					}
+					else
+					{
+						for (std::size_t i = 0; i < count; ++i, vertex += stride)
+							convert(element, first + i, vertex);
+					}
+				}
+
+				stream_copy(out + first * stride, block.data(), count * stride);
+			}
+
+#if defined(KNU_GLTF_SSE)
+			_mm_sfence();	// streamed data is visible before anyone hands the memory on
+#endif
+
+			return vertex_count;
+		}
+
+		template <typename Real>
+		std::vector<std::uint8_t> build_vertex_buffer(const basic_gltf_mesh<Real>& mesh,
+			const basic_gltf_partial_mesh<Real>& sub_mesh, const gltf_vertex_layout& layout)
+		{
+			check_layout(layout);
+			std::vector<std::uint8_t> vertices(detail::vertex_count_of(sub_mesh) * layout.stride);
+			write_vertex_buffer(mesh, sub_mesh, layout, vertices.data());
+
+			return vertices;
+		}
+
+		template <typename Real>
+		std::vector<std::uint8_t> build_vertex_buffer(const basic_gltf_mesh<Real>& mesh, const gltf_vertex_layout& layout,
+			std::vector<std::uint32_t>& first_vertices)
+		{
+			// up front, an exception out of the parallel writes would terminate
+			check_layout(layout);
+			first_vertices.clear();
+			std::size_t total = 0;
+			for (const auto& sub_mesh : mesh.sub_meshes)
+			{
+				first_vertices.push_back(static_cast<std::uint32_t>(total));
+				total += detail::vertex_count_of(sub_mesh);
+			}
+
+			std::vector<std::uint8_t> vertices(total * layout.stride);
+
+			std::vector<std::size_t> slots(mesh.sub_meshes.size());
+			for (std::size_t i = 0; i < slots.size(); ++i)
+				slots[i] = i;
+
+			std::for_each(std::execution::par, std::begin(slots), std::end(slots), [&](std::size_t slot)
+			{
+				write_vertex_buffer(mesh, mesh.sub_meshes[slot], layout,
+					vertices.data() + std::size_t(first_vertices[slot]) * layout.stride);
+			});
+
+			return vertices;
+		}
+
+		template std::size_t write_vertex_buffer(const gltf_mesh&, const gltf_partial_mesh&, const gltf_vertex_layout&, void*);
+		template std::size_t write_vertex_buffer(const gltf_mesh_f&, const gltf_partial_mesh_f&, const gltf_vertex_layout&, void*);
+		template std::vector<std::uint8_t> build_vertex_buffer(const gltf_mesh&, const gltf_partial_mesh&, const gltf_vertex_layout&);
+		template std::vector<std::uint8_t> build_vertex_buffer(const gltf_mesh_f&, const gltf_partial_mesh_f&, const gltf_vertex_layout&);
+		template std::vector<std::uint8_t> build_vertex_buffer(const gltf_mesh&, const gltf_vertex_layout&, std::vector<std::uint32_t>&);
+		template std::vector<std::uint8_t> build_vertex_buffer(const gltf_mesh_f&, const gltf_vertex_layout&, std::vector<std::uint32_t>&);
+	} // namespace graphics
+} // namespace knu
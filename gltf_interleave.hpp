@@ -0,0 +1,64 @@
+#ifndef KNU_GLTF_INTERLEAVE_HPP
+#define KNU_GLTF_INTERLEAVE_HPP
+
+#include "gltf.hpp"
+
+namespace knu
+{
+	namespace graphics
+	{
+		// what one vertex element is stored as. Normalized formats map [0, 1] or [-1, 1] onto the
+		// integer range, uint formats keep integers as they are (JOINTS)
+		enum class gltf_vertex_format
+		{
+			float1, float2, float3, float4,
+			half2, half4,
+			unorm8x4, snorm8x4, uint8x4,
+			unorm16x2, unorm16x4, snorm16x2, snorm16x4, uint16x4
+		};
+
+		// bytes one element of the format takes
+		std::uint32_t format_size(gltf_vertex_format format);
+
+		struct gltf_vertex_element
+		{
+			gltf_semantic semantic;			// gltf_semantics::position, gltf_semantic_id("COLOR_0") and so on
+			gltf_vertex_format format;
+			std::uint32_t offset;			// from the start of the vertex
+		};
+
+		// the vertex a renderer wants, elements the primitive does not have are written as zero. The
+		// POSITION, NORMAL and TANGENT of a primitive quantize_vertices ran on are decoded with its
+		// quantization first, so every format holds the values they stand for
+		struct gltf_vertex_layout
+		{
+			std::vector<gltf_vertex_element> elements;
+			std::uint32_t stride = 0;
+		};
+
+		// true when every element fits inside the stride. The functions that write vertices throw
+		// std::invalid_argument for any other layout, before anything is written
+		bool is_valid_layout(const gltf_vertex_layout& layout);
+
+		// writes the vertices of one primitive in the layout to destination, which has to hold
+		// vertex count * stride bytes. One pass over the vertices, assembled in small blocks that are
+		// streamed out with non-temporal stores, meant for mapped upload memory the CPU never reads.
+		// Returns the vertex count
+		template <typename Real>
+		std::size_t write_vertex_buffer(const basic_gltf_mesh<Real>& mesh, const basic_gltf_partial_mesh<Real>& sub_mesh,
+			const gltf_vertex_layout& layout, void* destination);
+
+		// the vertices of one primitive in the layout
+		template <typename Real>
+		std::vector<std::uint8_t> build_vertex_buffer(const basic_gltf_mesh<Real>& mesh,
+			const basic_gltf_partial_mesh<Real>& sub_mesh, const gltf_vertex_layout& layout);
+
+		// the vertices of every primitive one after the other, written in parallel. first_vertices
+		// gets the first vertex of every primitive, the base vertex for its draws
+		template <typename Real>
+		std::vector<std::uint8_t> build_vertex_buffer(const basic_gltf_mesh<Real>& mesh, const gltf_vertex_layout& layout,
+			std::vector<std::uint32_t>& first_vertices);
+	}
+}
+
+#endif // !KNU_GLTF_INTERLEAVE_HPP
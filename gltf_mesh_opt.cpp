@@ -0,0 +1,2125 @@
+#include "gltf_mesh_opt.hpp"
+#include "gltf_detail.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <execution>
+#include <limits>
+
+namespace knu
+{
+	namespace graphics
+	{
+		namespace
+		{
+			// gltf primitive modes, same values as GL_LINES and so on
+			const std::uint32_t lines_mode = 1;
+			const std::uint32_t line_loop_mode = 2;
+			const std::uint32_t line_strip_mode = 3;
+			const std::uint32_t triangles_mode = 4;
+			const std::uint32_t triangle_strip_mode = 5;
+			const std::uint32_t triangle_fan_mode = 6;
+
+			const std::uint16_t restart_index = 0xffff;
+			const std::size_t max_vertices_16 = std::size_t(std::numeric_limits<std::uint16_t>::max()) + 1;
+
+			// triangle i of a strip is (s[i], s[i + 1], s[i + 2]), with the first two swapped for odd i
+			// to keep the winding. Degenerate triangles, used to stitch strips together, are dropped
+			std::vector<std::uint16_t> expand_strip(const std::vector<std::uint16_t>& strip)
+			{
+				if (strip.size() < 3)
+					return {};
+
+				const std::size_t triangle_count = strip.size() - 2;
+				std::vector<std::uint16_t> list(triangle_count * 3 + 4);		// room for the last 64 bit store
+				const std::uint16_t* s = strip.data();
+				std::uint16_t* out = list.data();
+				std::size_t i = 0;
+
+#if defined(KNU_GLTF_SSE)
+				// four triangles from eight loaded indices, s0 s1 s2 | s2 s1 s3 | s2 s3 s4 | s4 s3 s5
+				for (; i + 8 <= strip.size() && i + 4 <= triangle_count; i += 4, out += 12)
+				{
+					const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+					const __m128i low = _mm_unpacklo_epi64(x, x);
+					const __m128i first = _mm_shufflehi_epi16(_mm_shufflelo_epi16(low, _MM_SHUFFLE(2, 2, 1, 0)),
+						_MM_SHUFFLE(3, 2, 3, 1));
+					const __m128i second = _mm_shufflelo_epi16(_mm_srli_si128(x, 6), _MM_SHUFFLE(2, 0, 1, 1));
+
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out), first);
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(out + 8), second);
+				}
+#endif
+				for (; i < triangle_count; ++i, out += 3)
+				{
+					const std::size_t odd = i & 1;
+					out[0] = s[i + odd];
+					out[1] = s[i + 1 - odd];
+					out[2] = s[i + 2];
+				}
+
+				list.resize(triangle_count * 3);
+
+				std::size_t write = 0;
+				for (std::size_t t = 0; t < list.size(); t += 3)
+				{
+					const std::uint16_t a = list[t], b = list[t + 1], c = list[t + 2];
+					if (a == b || b == c || c == a)
+						continue;
+
+					list[write++] = a;
+					list[write++] = b;
+					list[write++] = c;
+				}
+				list.resize(write);
+
+				return list;
+			}
+
+			std::uint64_t directed_edge(std::uint32_t from, std::uint32_t to)
+			{
+				return (std::uint64_t(from) << 32) | to;
+			}
+
+			// Forsyth's tuning values, the simulated cache is an LRU of forsyth_cache_size entries
+			const std::uint32_t forsyth_cache_size = 32;
+			const float cache_decay_power = 1.5f;
+			const float last_triangle_score = 0.75f;
+			const float valence_boost_scale = 2.0f;
+			const float valence_boost_power = 0.5f;
+
+			float vertex_score(int cache_position, std::uint32_t remaining_triangles)
+			{
+				if (remaining_triangles == 0)
+					return -1.0f;		// nothing left to draw with this vertex
+
+				float score = 0.0f;
+				if (cache_position >= 0)
+				{
+					if (cache_position < 3)
+					{
+						// the triangle just drawn, fixed score so no preference between its vertices
+						score = last_triangle_score;
+					}
+					else
+					{
+						const float scaler = 1.0f / (forsyth_cache_size - 3);
+						score = std::pow(1.0f - (cache_position - 3) * scaler, cache_decay_power);
+					}
+				}
+
+				// favour vertices with few triangles left so they get finished off
+				score += valence_boost_scale * std::pow(static_cast<float>(remaining_triangles), -valence_boost_power);
+				return score;
+			}
+
+			template <typename Index>
+			gltf_vertex_cache_stats analyze_fifo(const Index* indices, std::size_t index_count,
+				std::size_t vertex_count, std::uint32_t cache_size)
+			{
+				gltf_vertex_cache_stats stats;
+				if (index_count < 3)
+					return stats;
+
+				// a vertex is in the cache while its timestamp is within cache_size misses of now
+				std::vector<std::size_t> timestamps(vertex_count, 0);
+				std::vector<bool> referenced(vertex_count, false);
+				std::size_t time = cache_size + 1;
+				std::size_t misses = 0;
+				std::size_t unique = 0;
+
+				for (std::size_t i = 0; i < index_count; ++i)
+				{
+					const Index v = indices[i];
+					if (time - timestamps[v] > cache_size)
+					{
+						timestamps[v] = time++;
+						++misses;
+					}
+
+					if (!referenced[v])
+					{
+						referenced[v] = true;
+						++unique;
+					}
+				}
+
+				stats.acmr = static_cast<float>(misses) / (index_count / 3);
+				stats.atvr = unique > 0 ? static_cast<float>(misses) / unique : 0.0f;
+				return stats;
+			}
+
+			template <typename Index>
+			void forsyth_reorder(Index* indices, std::size_t index_count, std::size_t vertex_count)
+			{
+				const std::size_t triangle_count = index_count / 3;
+				if (triangle_count < 2)
+					return;
+
+				// vertex to triangle adjacency in compressed rows
+				std::vector<std::uint32_t> remaining(vertex_count, 0);
+				for (std::size_t i = 0; i < triangle_count * 3; ++i)
+					++remaining[indices[i]];
+
+				std::vector<std::uint32_t> offsets(vertex_count + 1, 0);
+				for (std::size_t v = 0; v < vertex_count; ++v)
+					offsets[v + 1] = offsets[v] + remaining[v];
+
+				std::vector<std::uint32_t> adjacency(triangle_count * 3);
+				{
+					std::vector<std::uint32_t> fill(std::begin(offsets), std::end(offsets) - 1);
+					for (std::size_t t = 0; t < triangle_count; ++t)
+						for (std::size_t c = 0; c < 3; ++c)
+							adjacency[fill[indices[t * 3 + c]]++] = static_cast<std::uint32_t>(t);
+				}
+
+				std::vector<int> cache_position(vertex_count, -1);
+				std::vector<float> scores(vertex_count);
+				for (std::size_t v = 0; v < vertex_count; ++v)
+					scores[v] = vertex_score(-1, remaining[v]);
+
+				std::vector<bool> emitted(triangle_count, false);
+
+				// remove each emitted triangle from its vertices' adjacency lists as we go
+				auto remove_adjacent = [&](Index v, std::uint32_t t)
+				{
+					const std::uint32_t first = offsets[v];
+					const std::uint32_t last = first + remaining[v];
+					for (std::uint32_t i = first; i < last; ++i)
+					{
+						if (adjacency[i] == t)
+						{
+							std::swap(adjacency[i], adjacency[last - 1]);
+							break;
+						}
+					}
+					--remaining[v];
+				};
+
+				std::vector<Index> output;
+				output.reserve(triangle_count * 3);
+
+				// the cache has room for 3 extra entries while the new triangle is pushed in
+				std::vector<Index> cache;
+				std::vector<Index> next_cache;
+				cache.reserve(forsyth_cache_size + 3);
+				next_cache.reserve(forsyth_cache_size + 3);
+
+				std::size_t best_triangle = 0;
+				std::size_t scan_position = 0;		// lowest triangle that may not be emitted yet
+
+				for (std::size_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count)
+				{
+					if (best_triangle == triangle_count)
+					{
+						// no candidate in the cache, pick the next unemitted triangle in input order
+						while (emitted[scan_position])
+							++scan_position;
+						best_triangle = scan_position;
+					}
+
+					emitted[best_triangle] = true;
+
+					next_cache.clear();
+					for (std::size_t c = 0; c < 3; ++c)
+					{
+						const Index v = indices[best_triangle * 3 + c];
+						output.push_back(v);
+						next_cache.push_back(v);
+						remove_adjacent(v, static_cast<std::uint32_t>(best_triangle));
+					}
+
+					for (Index v : cache)
+					{
+						if (std::find(std::begin(next_cache), std::begin(next_cache) + 3, v) == std::begin(next_cache) + 3)
+							next_cache.push_back(v);
+					}
+
+					// vertices pushed out of the cache lose their position bonus
+					for (std::size_t i = forsyth_cache_size; i < next_cache.size(); ++i)
+					{
+						cache_position[next_cache[i]] = -1;
+						scores[next_cache[i]] = vertex_score(-1, remaining[next_cache[i]]);
+					}
+					if (next_cache.size() > forsyth_cache_size)
+						next_cache.resize(forsyth_cache_size);
+
+					std::swap(cache, next_cache);
+
+					// rescore the cache and every triangle touching it, the best of those goes next
+					for (std::size_t i = 0; i < cache.size(); ++i)
+					{
+						cache_position[cache[i]] = static_cast<int>(i);
+						scores[cache[i]] = vertex_score(static_cast<int>(i), remaining[cache[i]]);
+					}
+
+					float best_score = -1.0f;
+					best_triangle = triangle_count;
+					for (Index v : cache)
+					{
+						for (std::uint32_t i = offsets[v]; i < offsets[v] + remaining[v]; ++i)
+						{
+							const std::uint32_t t = adjacency[i];
+							const float score = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+							if (score > best_score)
+							{
+								best_score = score;
+								best_triangle = t;
+							}
+						}
+					}
+				}
+
+				std::copy(std::begin(output), std::end(output), indices);
+			}
+
+			const std::uint32_t overdraw_cache_size = 16;
+
+			// FIFO cache used to find the cluster boundaries, reset() empties it in constant time
+			class fifo_cache
+			{
+			public:
+				explicit fifo_cache(std::size_t vertex_count) : timestamps(vertex_count, 0) {}
+
+				void reset() { time += overdraw_cache_size + 1; }
+
+				// returns how many of the triangle's vertices missed
+				template <typename Index>
+				std::uint32_t add_triangle(const Index* triangle)
+				{
+					std::uint32_t misses = 0;
+					for (int c = 0; c < 3; ++c)
+					{
+						if (time - timestamps[triangle[c]] > overdraw_cache_size)
+						{
+							timestamps[triangle[c]] = time++;
+							++misses;
+						}
+					}
+
+					return misses;
+				}
+
+			private:
+				std::vector<std::size_t> timestamps;
+				std::size_t time = overdraw_cache_size + 1;
+			};
+
+			template <typename Index>
+			void overdraw_reorder(Index* indices, std::size_t index_count, const std::vector<std::array<float, 3>>& positions,
+				float threshold)
+			{
+				using vec3 = std::array<float, 3>;
+
+				const std::size_t triangle_count = index_count / 3;
+				if (triangle_count < 2)
+					return;
+
+				fifo_cache cache{ positions.size() };
+
+				// hard boundaries, where the cache effectively starts over (all three vertices miss)
+				std::vector<std::size_t> hard;
+				for (std::size_t t = 0; t < triangle_count; ++t)
+				{
+					if (cache.add_triangle(indices + t * 3) == 3)
+						hard.push_back(t);
+				}
+				hard.push_back(triangle_count);
+
+				// soft boundaries, close a cluster as soon as its own miss ratio is good enough
+				std::vector<std::size_t> clusters;
+				for (std::size_t h = 0; h + 1 < hard.size(); ++h)
+				{
+					const std::size_t begin = hard[h];
+					const std::size_t end = hard[h + 1];
+
+					cache.reset();
+					std::size_t misses = 0;
+					for (std::size_t t = begin; t < end; ++t)
+						misses += cache.add_triangle(indices + t * 3);
+
+					const float limit = threshold * static_cast<float>(misses) / (end - begin);
+
+					cache.reset();
+					std::size_t cluster_start = begin;
+					std::size_t cluster_misses = 0;
+					clusters.push_back(begin);
+
+					for (std::size_t t = begin; t < end; ++t)
+					{
+						cluster_misses += cache.add_triangle(indices + t * 3);
+
+						if (t + 1 < end && cluster_misses <= limit * (t + 1 - cluster_start))
+						{
+							cluster_start = t + 1;
+							cluster_misses = 0;
+							clusters.push_back(cluster_start);
+							cache.reset();
+						}
+					}
+
+					// a tail that never got under the limit joins the cluster before it
+					if (cluster_start != begin && cluster_misses > limit * (end - cluster_start))
+						clusters.pop_back();
+				}
+				clusters.push_back(triangle_count);
+
+				// area weighted centroid and normal of every cluster and of the whole mesh
+				const std::size_t cluster_count = clusters.size() - 1;
+				std::vector<vec3> centroids(cluster_count, vec3{ 0, 0, 0 });
+				std::vector<vec3> normals(cluster_count, vec3{ 0, 0, 0 });
+				vec3 mesh_centroid = { 0, 0, 0 };
+				float mesh_area = 0.0f;
+
+				for (std::size_t c = 0; c < cluster_count; ++c)
+				{
+					float cluster_area = 0.0f;
+					for (std::size_t t = clusters[c]; t < clusters[c + 1]; ++t)
+					{
+						const vec3& p0 = positions[indices[t * 3]];
+						const vec3& p1 = positions[indices[t * 3 + 1]];
+						const vec3& p2 = positions[indices[t * 3 + 2]];
+
+						const vec3 e1 = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+						const vec3 e2 = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+						const vec3 n = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+						const float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+						for (int axis = 0; axis < 3; ++axis)
+						{
+							centroids[c][axis] += (p0[axis] + p1[axis] + p2[axis]) * (area / 3.0f);
+							normals[c][axis] += n[axis];
+						}
+						cluster_area += area;
+					}
+
+					for (int axis = 0; axis < 3; ++axis)
+						mesh_centroid[axis] += centroids[c][axis];
+					mesh_area += cluster_area;
+
+					const float inverse_area = cluster_area > 0.0f ? 1.0f / cluster_area : 0.0f;
+					for (int axis = 0; axis < 3; ++axis)
+						centroids[c][axis] *= inverse_area;
+				}
+
+				const float inverse_mesh_area = mesh_area > 0.0f ? 1.0f / mesh_area : 0.0f;
+				for (int axis = 0; axis < 3; ++axis)
+					mesh_centroid[axis] *= inverse_mesh_area;
+
+				// clusters that face outwards from the center are the most likely to cover the rest
+				std::vector<float> sort_keys(cluster_count);
+				for (std::size_t c = 0; c < cluster_count; ++c)
+				{
+					const vec3& n = normals[c];
+					const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					const float inverse_length = length > 0.0f ? 1.0f / length : 0.0f;
+
+					float key = 0.0f;
+					for (int axis = 0; axis < 3; ++axis)
+						key += (centroids[c][axis] - mesh_centroid[axis]) * n[axis] * inverse_length;
+					sort_keys[c] = key;
+				}
+
+				std::vector<std::size_t> order(cluster_count);
+				for (std::size_t c = 0; c < cluster_count; ++c)
+					order[c] = c;
+				std::stable_sort(std::begin(order), std::end(order),
+					[&sort_keys](std::size_t a, std::size_t b) { return sort_keys[a] > sort_keys[b]; });
+
+				std::vector<Index> output;
+				output.reserve(triangle_count * 3);
+				for (std::size_t c : order)
+					output.insert(std::end(output), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+
+				std::copy(std::begin(output), std::end(output), indices);
+			}
+
+			// turns a vertex into a string of 32 bit words, two vertices weld when their words match.
+			// Float components are rounded to the nearest grid point, a 64 bit cell in two words (or taken bit
+			// for bit with -0 folded into 0), anything else is compared byte for byte
+			class vertex_key
+			{
+			public:
+				template <typename Real>
+				vertex_key(const std::vector<gltf_buffer>& buffers, const basic_gltf_partial_mesh<Real>& sub_mesh,
+					float epsilon) :
+					inverse_epsilon{ epsilon > 0.0f ? 1.0f / epsilon : 0.0f }
+				{
+					detail::for_each_attribute(sub_mesh, [&](const basic_gltf_component_info<Real>& info)
+					{
+						readers.emplace_back(buffers, info);
+						is_float.push_back(info.component_type == detail::GL_FLOAT);
+						word_count += is_float.back() ? info.component_count * (inverse_epsilon > 0.0f ? 2 : 1)
+							: (readers.back().element_size() + 3) / 4;
+					});
+				}
+
+				std::size_t words() const { return word_count; }
+
+				void build(std::size_t vertex, std::uint32_t* out) const
+				{
+					for (std::size_t r = 0; r < readers.size(); ++r)
+					{
+						const detail::attribute_reader& reader = readers[r];
+						if (is_float[r])
+						{
+							for (std::uint32_t c = 0; c < reader.components(); ++c)
+							{
+								float value = reader.component(vertex, c);
+								if (inverse_epsilon > 0.0f)
+								{
+									// in double so the cell cannot overflow before the range check. Values too far
+									// out for a cell, and infinities and NaNs, keep their bits under a high word
+									// no cell has
+									const double scaled = std::floor(static_cast<double>(value) * inverse_epsilon + 0.5);
+									if (std::abs(scaled) < 4611686018427387904.0)		// 2^62
+									{
+										const auto cell = static_cast<std::int64_t>(scaled);
+										const auto bits = static_cast<std::uint64_t>(cell);
+										*out++ = static_cast<std::uint32_t>(bits);
+										*out++ = static_cast<std::uint32_t>(bits >> 32);
+									}
+									else
+									{
+										std::memcpy(out++, &value, sizeof(value));
+										*out++ = 0x80000000u;
+									}
+								}
+								else
+								{
+									if (value == 0.0f)
+										value = 0.0f;
+									std::memcpy(out++, &value, sizeof(value));
+								}
+							}
+						}
+						else
+						{
+							const std::uint32_t size = reader.element_size();
+							const std::uint32_t padded_words = (size + 3) / 4;
+							std::fill(out, out + padded_words, 0u);
+							std::memcpy(out, reader.element(vertex), size);
+							out += padded_words;
+						}
+					}
+				}
+
+			private:
+				std::vector<detail::attribute_reader> readers;
+				std::vector<bool> is_float;
+				std::size_t word_count = 0;
+				float inverse_epsilon;
+			};
+
+			std::uint32_t hash_words(const std::uint32_t* words, std::size_t count)
+			{
+				// murmur style mixing of every word, then a final avalanche
+				std::uint32_t h = 0x9747b28c;
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					std::uint32_t k = words[i] * 0xcc9e2d51;
+					k = (k << 15) | (k >> 17);
+					h ^= k * 0x1b873593;
+					h = ((h << 13) | (h >> 19)) * 5 + 0xe6546b64;
+				}
+
+				h ^= h >> 16;
+				h *= 0x85ebca6b;
+				h ^= h >> 13;
+				h *= 0xc2b2ae35;
+				h ^= h >> 16;
+				return h;
+			}
+
+			// one pass over the vertices with a flat, linearly probed table of vertex numbers.
+			// remap gets the new number of every vertex, the return value is the kept vertices
+			std::vector<std::uint32_t> weld(const vertex_key& key, std::size_t vertex_count, std::vector<std::uint32_t>& remap)
+			{
+				const std::uint32_t empty = 0xffffffff;
+
+				std::size_t table_size = 16;
+				while (table_size < vertex_count * 2)
+					table_size *= 2;
+				const std::size_t mask = table_size - 1;
+
+				std::vector<std::uint32_t> table(table_size, empty);		// index into kept
+				std::vector<std::uint32_t> table_hashes(table_size, 0);
+				std::vector<std::uint32_t> kept;
+
+				std::vector<std::uint32_t> words(key.words());
+				std::vector<std::uint32_t> other_words(key.words());
+				const std::size_t word_bytes = key.words() * sizeof(std::uint32_t);
+
+				remap.resize(vertex_count);
+				for (std::size_t v = 0; v < vertex_count; ++v)
+				{
+					key.build(v, words.data());
+					const std::uint32_t h = hash_words(words.data(), words.size());
+
+					std::size_t slot = h & mask;
+					while (table[slot] != empty)
+					{
+						if (table_hashes[slot] == h)
+						{
+							key.build(kept[table[slot]], other_words.data());
+							if (std::memcmp(words.data(), other_words.data(), word_bytes) == 0)
+								break;
+						}
+
+						slot = (slot + 1) & mask;
+					}
+
+					if (table[slot] == empty)
+					{
+						table[slot] = static_cast<std::uint32_t>(kept.size());
+						table_hashes[slot] = h;
+						kept.push_back(static_cast<std::uint32_t>(v));
+					}
+
+					remap[v] = table[slot];
+				}
+
+				return kept;
+			}
+
+			// symmetric 4x4 error quadric, stored as its upper triangle
+			struct quadric
+			{
+				double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+
+				// squared distance to the plane n.p + d = 0, n has to be unit length
+				void add_plane(double nx, double ny, double nz, double d, double weight)
+				{
+					xx += weight * nx * nx; xy += weight * nx * ny; xz += weight * nx * nz; xw += weight * nx * d;
+					yy += weight * ny * ny; yz += weight * ny * nz; yw += weight * ny * d;
+					zz += weight * nz * nz; zw += weight * nz * d;
+					ww += weight * d * d;
+				}
+
+				double error(const std::array<float, 3>& p) const
+				{
+					const double x = p[0], y = p[1], z = p[2];
+					const double e = xx * x * x + 2 * xy * x * y + 2 * xz * x * z + 2 * xw * x
+						+ yy * y * y + 2 * yz * y * z + 2 * yw * y
+						+ zz * z * z + 2 * zw * z
+						+ ww;
+					return e > 0 ? e : 0;
+				}
+			};
+
+			const double border_weight = 10.0;			// keeps open borders from shrinking
+			const float flip_threshold = 0.25f;		// smallest cosine between a triangle's normal before and after
+
+			enum class vertex_kind : std::uint8_t { manifold, border, locked };
+
+			std::array<float, 3> triangle_normal(const std::array<float, 3>& p0, const std::array<float, 3>& p1,
+				const std::array<float, 3>& p2)
+			{
+				const std::array<float, 3> e1 = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				const std::array<float, 3> e2 = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				return { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			}
+
+			std::uint64_t edge_key(std::uint32_t a, std::uint32_t b)
+			{
+				return a < b ? (std::uint64_t(a) << 32) | b : (std::uint64_t(b) << 32) | a;
+			}
+
+			// pass based edge collapse, every pass recomputes the quadrics and the topology of what is
+			// left and then collapses the cheapest edges whose neighbourhoods do not overlap
+			std::vector<std::uint32_t> simplify_triangles(std::vector<std::uint32_t> indices,
+				const std::vector<std::array<float, 3>>& positions, std::size_t target_index_count, float& result_error)
+			{
+				using vec3 = std::array<float, 3>;
+
+				const std::size_t vertex_count = positions.size();
+				const std::vector<std::uint32_t> pos_id = detail::position_ids(positions);
+
+				// bounding box of what is referenced, the error is reported relative to its diagonal
+				vec3 lower = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+				vec3 upper = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+				for (std::uint32_t v : indices)
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						lower[axis] = std::min(lower[axis], positions[v][axis]);
+						upper[axis] = std::max(upper[axis], positions[v][axis]);
+					}
+				const double diagonal = indices.empty() ? 1.0 : std::sqrt(double(upper[0] - lower[0]) * (upper[0] - lower[0])
+					+ double(upper[1] - lower[1]) * (upper[1] - lower[1]) + double(upper[2] - lower[2]) * (upper[2] - lower[2]));
+
+				double max_error = 0.0;
+				target_index_count = target_index_count / 3 * 3;
+
+				struct collapse
+				{
+					std::uint32_t from;
+					std::uint32_t to;
+					double cost;
+				};
+
+				while (indices.size() > target_index_count)
+				{
+					const std::size_t triangle_count = indices.size() / 3;
+
+					// triangles around every vertex
+					std::vector<std::uint32_t> offsets(vertex_count + 1, 0);
+					for (std::uint32_t v : indices)
+						++offsets[v + 1];
+					for (std::size_t v = 0; v < vertex_count; ++v)
+						offsets[v + 1] += offsets[v];
+
+					std::vector<std::uint32_t> adjacency(indices.size());
+					{
+						std::vector<std::uint32_t> fill(std::begin(offsets), std::end(offsets) - 1);
+						for (std::size_t i = 0; i < indices.size(); ++i)
+							adjacency[fill[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+					}
+
+					// how many triangles use every edge, counted on positions so seams are not borders
+					std::vector<std::uint64_t> edges;
+					edges.reserve(indices.size());
+					for (std::size_t t = 0; t < triangle_count; ++t)
+						for (int c = 0; c < 3; ++c)
+							edges.push_back(edge_key(pos_id[indices[t * 3 + c]], pos_id[indices[t * 3 + (c + 1) % 3]]));
+					std::sort(std::begin(edges), std::end(edges));
+
+					auto edge_uses = [&edges](std::uint32_t a, std::uint32_t b)
+					{
+						auto range = std::equal_range(std::begin(edges), std::end(edges), edge_key(a, b));
+						return static_cast<std::size_t>(range.second - range.first);
+					};
+
+					// vertices sharing a position with another referenced vertex sit on a seam
+					std::vector<std::uint32_t> wedges(vertex_count, 0);
+					std::vector<bool> referenced(vertex_count, false);
+					for (std::uint32_t v : indices)
+					{
+						if (!referenced[v])
+						{
+							referenced[v] = true;
+							++wedges[pos_id[v]];
+						}
+					}
+
+					std::vector<vertex_kind> kind(vertex_count, vertex_kind::manifold);
+					std::vector<quadric> quadrics(vertex_count);
+
+					for (std::size_t v = 0; v < vertex_count; ++v)
+					{
+						if (referenced[v] && wedges[pos_id[v]] > 1)
+							kind[v] = vertex_kind::locked;
+					}
+
+					for (std::size_t t = 0; t < triangle_count; ++t)
+					{
+						const std::uint32_t* tri = indices.data() + t * 3;
+						vec3 n = triangle_normal(positions[tri[0]], positions[tri[1]], positions[tri[2]]);
+						const double length = std::sqrt(double(n[0]) * n[0] + double(n[1]) * n[1] + double(n[2]) * n[2]);
+						if (length <= 0.0)
+							continue;
+
+						const double nx = n[0] / length, ny = n[1] / length, nz = n[2] / length;
+						const vec3& p0 = positions[tri[0]];
+						const double d = -(nx * p0[0] + ny * p0[1] + nz * p0[2]);
+						for (int c = 0; c < 3; ++c)
+							quadrics[pos_id[tri[c]]].add_plane(nx, ny, nz, d, 1.0);
+
+						for (int c = 0; c < 3; ++c)
+						{
+							const std::uint32_t a = tri[c];
+							const std::uint32_t b = tri[(c + 1) % 3];
+							const std::size_t uses = edge_uses(pos_id[a], pos_id[b]);
+							if (uses == 2)
+								continue;
+
+							if (uses > 2)
+							{
+								// non manifold edge, leave it alone
+								kind[a] = kind[b] = vertex_kind::locked;
+								continue;
+							}
+
+							if (kind[a] != vertex_kind::locked) kind[a] = vertex_kind::border;
+							if (kind[b] != vertex_kind::locked) kind[b] = vertex_kind::border;
+
+							// a plane through the border edge, at right angles to the triangle
+							const vec3& pa = positions[a];
+							const vec3& pb = positions[b];
+							const double ex = pb[0] - pa[0], ey = pb[1] - pa[1], ez = pb[2] - pa[2];
+							double px = ey * nz - ez * ny, py = ez * nx - ex * nz, pz = ex * ny - ey * nx;
+							const double plength = std::sqrt(px * px + py * py + pz * pz);
+							if (plength <= 0.0)
+								continue;
+
+							px /= plength; py /= plength; pz /= plength;
+							const double pd = -(px * pa[0] + py * pa[1] + pz * pa[2]);
+							quadrics[pos_id[a]].add_plane(px, py, pz, pd, border_weight);
+							quadrics[pos_id[b]].add_plane(px, py, pz, pd, border_weight);
+						}
+					}
+
+					// every allowed direction of every edge
+					std::vector<collapse> candidates;
+					for (std::size_t t = 0; t < triangle_count; ++t)
+						for (int c = 0; c < 3; ++c)
+						{
+							const std::uint32_t a = indices[t * 3 + c];
+							const std::uint32_t b = indices[t * 3 + (c + 1) % 3];
+							for (int direction = 0; direction < 2; ++direction)
+							{
+								const std::uint32_t from = direction == 0 ? a : b;
+								const std::uint32_t to = direction == 0 ? b : a;
+								if (pos_id[from] == pos_id[to] || kind[from] == vertex_kind::locked)
+									continue;
+								if (kind[from] == vertex_kind::border && edge_uses(pos_id[from], pos_id[to]) != 1)
+									continue;
+
+								candidates.push_back(collapse{ from, to, quadrics[pos_id[from]].error(positions[to]) });
+							}
+						}
+
+					std::sort(std::begin(candidates), std::end(candidates),
+						[](const collapse& x, const collapse& y) { return x.cost < y.cost; });
+
+					std::vector<std::uint32_t> remap(vertex_count);
+					for (std::uint32_t v = 0; v < vertex_count; ++v)
+						remap[v] = v;
+
+					std::vector<bool> touched(vertex_count, false);
+					std::size_t remaining = triangle_count;
+					std::size_t collapses = 0;
+
+					for (const collapse& candidate : candidates)
+					{
+						if (remaining * 3 <= target_index_count)
+							break;
+
+						const std::uint32_t from = candidate.from;
+						const std::uint32_t to = candidate.to;
+						if (touched[from] || touched[to])
+							continue;
+
+						// reject the collapse if any triangle that survives it would flip or turn into a sliver
+						bool flips = false;
+						std::size_t removed = 0;
+						for (std::uint32_t i = offsets[from]; i < offsets[from + 1] && !flips; ++i)
+						{
+							const std::uint32_t* tri = indices.data() + adjacency[i] * 3;
+							if (tri[0] == to || tri[1] == to || tri[2] == to)
+							{
+								++removed;
+								continue;
+							}
+
+							vec3 moved[3];
+							for (int c = 0; c < 3; ++c)
+								moved[c] = positions[tri[c] == from ? to : tri[c]];
+
+							const vec3 before = triangle_normal(positions[tri[0]], positions[tri[1]], positions[tri[2]]);
+							const vec3 after = triangle_normal(moved[0], moved[1], moved[2]);
+							const double dot = double(before[0]) * after[0] + double(before[1]) * after[1] + double(before[2]) * after[2];
+							const double lengths = std::sqrt((double(before[0]) * before[0] + double(before[1]) * before[1] + double(before[2]) * before[2])
+								* (double(after[0]) * after[0] + double(after[1]) * after[1] + double(after[2]) * after[2]));
+							flips = dot <= flip_threshold * lengths;
+						}
+
+						if (flips)
+							continue;
+
+						remap[from] = to;
+						remaining -= removed;
+						max_error = std::max(max_error, candidate.cost);
+						++collapses;
+
+						// nothing around the moved vertex may change again in this pass
+						for (std::uint32_t i = offsets[from]; i < offsets[from + 1]; ++i)
+						{
+							const std::uint32_t* tri = indices.data() + adjacency[i] * 3;
+							touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+						}
+					}
+
+					if (collapses == 0)
+						break;
+
+					// apply the pass and drop the triangles that collapsed
+					std::size_t write = 0;
+					for (std::size_t t = 0; t < triangle_count; ++t)
+					{
+						const std::uint32_t a = remap[indices[t * 3]];
+						const std::uint32_t b = remap[indices[t * 3 + 1]];
+						const std::uint32_t c = remap[indices[t * 3 + 2]];
+						if (pos_id[a] == pos_id[b] || pos_id[b] == pos_id[c] || pos_id[c] == pos_id[a])
+							continue;
+
+						indices[write++] = a;
+						indices[write++] = b;
+						indices[write++] = c;
+					}
+					indices.resize(write);
+				}
+
+				result_error = static_cast<float>(std::sqrt(max_error) / (diagonal > 0.0 ? diagonal : 1.0));
+				return indices;
+			}
+
+			const std::uint32_t meshlet_vertex_limit = 256;		// micro indices are bytes
+
+			// bounding sphere and normal cone of a finished meshlet
+			void meshlet_bounds(gltf_meshlet& meshlet, const gltf_meshlets& result,
+				const std::vector<std::array<float, 3>>& positions)
+			{
+				using vec3 = std::array<float, 3>;
+
+				vec3 lower = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+				vec3 upper = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+				for (std::uint32_t i = 0; i < meshlet.vertex_count; ++i)
+				{
+					const vec3& p = positions[result.vertices[meshlet.vertex_offset + i]];
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						lower[axis] = std::min(lower[axis], p[axis]);
+						upper[axis] = std::max(upper[axis], p[axis]);
+					}
+				}
+
+				meshlet.center = { (lower[0] + upper[0]) * 0.5f, (lower[1] + upper[1]) * 0.5f, (lower[2] + upper[2]) * 0.5f };
+				float radius_squared = 0.0f;
+				for (std::uint32_t i = 0; i < meshlet.vertex_count; ++i)
+				{
+					const vec3& p = positions[result.vertices[meshlet.vertex_offset + i]];
+					const float dx = p[0] - meshlet.center[0], dy = p[1] - meshlet.center[1], dz = p[2] - meshlet.center[2];
+					radius_squared = std::max(radius_squared, dx * dx + dy * dy + dz * dz);
+				}
+				meshlet.radius = std::sqrt(radius_squared);
+
+				// the cone axis is the average of the unit triangle normals
+				std::vector<vec3> normals;
+				normals.reserve(meshlet.triangle_count);
+				vec3 axis = { 0, 0, 0 };
+				for (std::uint32_t t = 0; t < meshlet.triangle_count; ++t)
+				{
+					const std::uint8_t* tri = result.triangles.data() + meshlet.triangle_offset + t * 3;
+					const std::uint32_t* vertices = result.vertices.data() + meshlet.vertex_offset;
+					vec3 n = triangle_normal(positions[vertices[tri[0]]], positions[vertices[tri[1]]], positions[vertices[tri[2]]]);
+					const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					if (length <= 0.0f)
+						continue;
+
+					n = { n[0] / length, n[1] / length, n[2] / length };
+					normals.push_back(n);
+					for (int c = 0; c < 3; ++c)
+						axis[c] += n[c];
+				}
+
+				const float axis_length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+				if (normals.empty() || axis_length <= 0.0f)
+					return;
+
+				axis = { axis[0] / axis_length, axis[1] / axis_length, axis[2] / axis_length };
+
+				float min_dot = 1.0f;
+				for (const vec3& n : normals)
+					min_dot = std::min(min_dot, n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]);
+
+				meshlet.cone_axis = axis;
+
+				// normals spread over more than a hemisphere (give or take) can not be culled as a whole
+				if (min_dot <= 0.1f)
+					return;
+
+				// move the apex back along the axis until every triangle's plane is in front of it
+				float max_t = 0.0f;
+				for (std::uint32_t t = 0; t < meshlet.triangle_count; ++t)
+				{
+					const std::uint8_t* tri = result.triangles.data() + meshlet.triangle_offset + t * 3;
+					const vec3& p0 = positions[result.vertices[meshlet.vertex_offset + tri[0]]];
+					vec3 n = triangle_normal(p0, positions[result.vertices[meshlet.vertex_offset + tri[1]]],
+						positions[result.vertices[meshlet.vertex_offset + tri[2]]]);
+
+					const float along_normal = (meshlet.center[0] - p0[0]) * n[0] + (meshlet.center[1] - p0[1]) * n[1]
+						+ (meshlet.center[2] - p0[2]) * n[2];
+					const float along_axis = axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2];
+					if (along_axis > 0.0f)
+						max_t = std::max(max_t, along_normal / along_axis);
+				}
+
+				meshlet.cone_apex = { meshlet.center[0] - axis[0] * max_t, meshlet.center[1] - axis[1] * max_t,
+					meshlet.center[2] - axis[2] * max_t };
+				meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+			}
+
+			template <typename Index>
+			std::vector<std::uint32_t> first_use_order(Index* indices, std::size_t index_count, std::size_t vertex_count)
+			{
+				const std::uint32_t unassigned = 0xffffffff;
+
+				std::vector<std::uint32_t> new_index(vertex_count, unassigned);
+				std::vector<std::uint32_t> source_vertices;
+				source_vertices.reserve(vertex_count);
+
+				for (std::size_t i = 0; i < index_count; ++i)
+				{
+					std::uint32_t& remapped = new_index[indices[i]];
+					if (remapped == unassigned)
+					{
+						remapped = static_cast<std::uint32_t>(source_vertices.size());
+						source_vertices.push_back(indices[i]);
+					}
+
+					indices[i] = static_cast<Index>(remapped);
+				}
+
+				return source_vertices;
+			}
+
+			// the list of a strip, fan or loop with 32 bit indices, which are never restarted in gltf
+			std::uint32_t expand_to_list(std::vector<std::uint32_t>& indices, std::uint32_t render_mode)
+			{
+				std::vector<std::uint32_t> list;
+				switch (render_mode)
+				{
+				case triangle_strip_mode:
+					for (std::size_t i = 0; i + 2 < indices.size(); ++i)
+					{
+						const std::uint32_t a = indices[i + (i & 1)], b = indices[i + 1 - (i & 1)], c = indices[i + 2];
+						if (a != b && b != c && a != c)
+							list.insert(std::end(list), { a, b, c });
+					}
+					break;
+
+				case triangle_fan_mode:
+					for (std::size_t i = 1; i + 1 < indices.size(); ++i)
+						list.insert(std::end(list), { indices[0], indices[i], indices[i + 1] });
+					break;
+
+				case line_strip_mode:
+				case line_loop_mode:
+					for (std::size_t i = 0; i + 1 < indices.size(); ++i)
+						list.insert(std::end(list), { indices[i], indices[i + 1] });
+					if (render_mode == line_loop_mode && indices.size() > 2)
+						list.insert(std::end(list), { indices.back(), indices.front() });
+					break;
+
+				default:
+					return render_mode;
+				}
+
+				indices = std::move(list);
+				return render_mode == triangle_strip_mode || render_mode == triangle_fan_mode ? triangles_mode : lines_mode;
+			}
+
+			// spreads the low 10 bits of v out to every third bit
+			std::uint32_t spread_bits(std::uint32_t v)
+			{
+				v &= 0x3ff;
+				v = (v | (v << 16)) & 0x030000ff;
+				v = (v | (v << 8)) & 0x0300f00f;
+				v = (v | (v << 4)) & 0x030c30c3;
+				v = (v | (v << 2)) & 0x09249249;
+				return v;
+			}
+
+			// turns every triangle around. Lists swap two corners, strips start one vertex later with a
+			// repeated first vertex so every triangle lands on the other parity, fans go the other way round
+			void flip_winding(std::vector<std::uint16_t>& indices, std::uint32_t mode, bool primitive_restart)
+			{
+				if (mode == triangles_mode)
+				{
+					for (std::size_t t = 0; t + 2 < indices.size(); t += 3)
+						std::swap(indices[t + 1], indices[t + 2]);
+				}
+				else if (mode == triangle_strip_mode)
+				{
+					std::vector<std::uint16_t> flipped;
+					flipped.reserve(indices.size() + indices.size() / 8 + 1);
+					bool strip_start = true;
+					for (std::uint16_t index : indices)
+					{
+						const bool restart = primitive_restart && index == restart_index;
+						if (strip_start && !restart)
+							flipped.push_back(index);
+
+						flipped.push_back(index);
+						strip_start = restart;
+					}
+
+					indices = std::move(flipped);
+				}
+				else if (mode == triangle_fan_mode && indices.size() > 2)
+				{
+					std::reverse(std::begin(indices) + 1, std::end(indices));
+				}
+			}
+
+			// the attributes of a primitive ordered by a key that is the same for the same semantic
+			// in every primitive, so two primitives with equal keys line up attribute by attribute
+			template <typename Real, typename Info>
+			std::vector<std::pair<std::uint64_t, Info*>> keyed_attributes(Info& position, Info& normal, Info& tangent,
+				std::vector<Info>& texcoords, basic_gltf_attribute_map<Real>& attributes)
+			{
+				std::vector<std::pair<std::uint64_t, Info*>> keyed;
+				if (position.valid) keyed.emplace_back(0, &position);
+				if (normal.valid) keyed.emplace_back(1, &normal);
+				if (tangent.valid) keyed.emplace_back(2, &tangent);
+				for (std::size_t set = 0; set < texcoords.size(); ++set)
+					if (texcoords[set].valid) keyed.emplace_back(0x100 + set, &texcoords[set]);
+				for (auto& e : attributes)
+					if (e.info.valid) keyed.emplace_back(0x10000 + std::uint64_t(e.semantic), &e.info);
+
+				std::sort(std::begin(keyed), std::end(keyed),
+					[](const auto& a, const auto& b) { return a.first < b.first; });
+				return keyed;
+			}
+
+			template <typename Real>
+			std::vector<std::pair<std::uint64_t, basic_gltf_component_info<Real>*>> keyed_attributes(basic_gltf_partial_mesh<Real>& sub_mesh)
+			{
+				return keyed_attributes<Real>(sub_mesh.position_info, sub_mesh.normal_info, sub_mesh.tangent_info,
+					sub_mesh.texcoord_infos, sub_mesh.attributes);
+			}
+
+			// what has to match for two primitives to merge, the attribute formats included
+			template <typename Real>
+			std::vector<std::uint64_t> merge_signature(basic_gltf_partial_mesh<Real>& sub_mesh)
+			{
+				std::vector<std::uint64_t> signature = { sub_mesh.material_index, sub_mesh.render_mode };
+				for (const auto& keyed : keyed_attributes(sub_mesh))
+				{
+					signature.push_back(keyed.first);
+					signature.push_back((std::uint64_t(keyed.second->component_type) << 32) | keyed.second->component_count);
+				}
+
+				return signature;
+			}
+
+			// concatenates members into one primitive whose attributes live in buffer, buffer_index
+			template <typename Real>
+			basic_gltf_partial_mesh<Real> merge_group(const std::vector<gltf_buffer>& buffers,
+				std::vector<basic_gltf_partial_mesh<Real>*>& members, std::uint32_t buffer_index, gltf_buffer& buffer)
+			{
+				basic_gltf_partial_mesh<Real> merged;
+				merged.render_mode = members.front()->render_mode;
+				merged.material_index = members.front()->material_index;
+				merged.position_info = members.front()->position_info;
+				merged.normal_info = members.front()->normal_info;
+				merged.tangent_info = members.front()->tangent_info;
+				merged.texcoord_infos = members.front()->texcoord_infos;
+				merged.attributes = members.front()->attributes;
+
+				std::vector<std::size_t> vertex_counts;
+				std::size_t vertex_total = 0;
+				for (auto* member : members)
+				{
+					vertex_counts.push_back(detail::vertex_count_of(*member));
+					vertex_total += vertex_counts.back();
+				}
+
+				auto merged_attributes = keyed_attributes(merged);
+				std::vector<std::vector<std::pair<std::uint64_t, basic_gltf_component_info<Real>*>>> member_attributes;
+				for (auto* member : members)
+					member_attributes.push_back(keyed_attributes(*member));
+
+				// one packed stream per attribute
+				std::size_t byte_length = 0;
+				std::vector<std::size_t> offsets;
+				for (const auto& keyed : merged_attributes)
+				{
+					offsets.push_back(byte_length);
+					const detail::attribute_reader reader{ buffers, *keyed.second };
+					byte_length += (reader.element_size() * vertex_total + 3) & ~std::size_t(3);
+				}
+
+				buffer = gltf_buffer{ byte_length, std::vector<std::uint8_t>(byte_length) };
+
+				for (std::size_t a = 0; a < merged_attributes.size(); ++a)
+				{
+					basic_gltf_component_info<Real>& info = *merged_attributes[a].second;
+					std::uint8_t* out = buffer.data.data() + offsets[a];
+
+					for (std::size_t m = 0; m < members.size(); ++m)
+					{
+						const basic_gltf_component_info<Real>& source = *member_attributes[m][a].second;
+						const detail::attribute_reader reader{ buffers, source };
+						const std::uint32_t element_size = reader.element_size();
+						for (std::size_t i = 0; i < vertex_counts[m]; ++i, out += element_size)
+							std::memcpy(out, reader.element(i), element_size);
+
+						// the bounds of the union
+						const int components = static_cast<int>(std::min<std::uint32_t>(info.component_count, 3));
+						for (int c = 0; c < components && m > 0; ++c)
+						{
+							info.min_bounds[c] = std::min(info.min_bounds[c], source.min_bounds[c]);
+							info.max_bounds[c] = std::max(info.max_bounds[c], source.max_bounds[c]);
+						}
+					}
+
+					info.buffer_index = buffer_index;
+					info.byte_offset = static_cast<std::uint32_t>(offsets[a]);
+					info.byte_stride = 0;
+					info.count = static_cast<std::uint32_t>(vertex_total);
+				}
+
+				// indices rebased onto where each member's vertices went, members without get them here
+				std::size_t base = 0;
+				for (std::size_t m = 0; m < members.size(); ++m)
+				{
+					const std::vector<std::uint16_t>& indices = members[m]->indices;
+					if (indices.empty())
+					{
+						for (std::size_t i = 0; i < vertex_counts[m]; ++i)
+							merged.indices.push_back(static_cast<std::uint16_t>(base + i));
+					}
+					else
+					{
+						for (std::uint16_t index : indices)
+							merged.indices.push_back(static_cast<std::uint16_t>(base + index));
+					}
+
+					base += vertex_counts[m];
+				}
+
+				return merged;
+			}
+		}
+
+		template <typename Real>
+		void weld_vertices(basic_gltf_mesh<Real>& mesh, float epsilon)
+		{
+			const std::vector<gltf_buffer>& buffers = mesh.buffers;
+
+			detail::rebuild_vertices(mesh, [&buffers, epsilon](basic_gltf_partial_mesh<Real>& sub_mesh,
+				std::vector<std::uint32_t>& source_vertices)
+			{
+				const std::size_t vertex_count = detail::vertex_count_of(sub_mesh);
+				const std::size_t max_vertices = std::size_t(std::numeric_limits<std::uint16_t>::max()) + 1;
+
+				// a primitive without indices gets them here, as long as they fit
+				if (vertex_count == 0 || (sub_mesh.indices.empty() && vertex_count > max_vertices))
+					return false;
+
+				const vertex_key key{ buffers, sub_mesh, epsilon };
+				std::vector<std::uint32_t> remap;
+				source_vertices = weld(key, vertex_count, remap);
+
+				if (sub_mesh.indices.empty())
+				{
+					sub_mesh.indices.resize(vertex_count);
+					for (std::size_t i = 0; i < vertex_count; ++i)
+						sub_mesh.indices[i] = static_cast<std::uint16_t>(i);
+				}
+
+				for (auto& index : sub_mesh.indices)
+					index = static_cast<std::uint16_t>(remap[index]);
+
+				sub_mesh.weld_report.valid = true;
+				sub_mesh.weld_report.vertices_before = static_cast<std::uint32_t>(vertex_count);
+				sub_mesh.weld_report.vertices_after = static_cast<std::uint32_t>(source_vertices.size());
+				return true;
+			});
+		}
+
+		gltf_vertex_cache_stats analyze_vertex_cache(const std::vector<std::uint16_t>& indices,
+			std::size_t vertex_count, std::uint32_t cache_size)
+		{
+			return analyze_fifo(indices.data(), indices.size() / 3 * 3, vertex_count, cache_size);
+		}
+
+		void optimize_vertex_cache(std::vector<std::uint16_t>& indices, std::size_t vertex_count)
+		{
+			forsyth_reorder(indices.data(), indices.size(), vertex_count);
+		}
+
+		template <typename Real>
+		void optimize_vertex_cache(basic_gltf_partial_mesh<Real>& sub_mesh)
+		{
+			if (sub_mesh.render_mode != triangles_mode || sub_mesh.indices.empty())
+				return;
+
+			const std::size_t vertex_count = detail::vertex_count_of(sub_mesh);
+
+			gltf_vertex_cache_report& report = sub_mesh.vertex_cache_report;
+			report.before = analyze_vertex_cache(sub_mesh.indices, vertex_count);
+			optimize_vertex_cache(sub_mesh.indices, vertex_count);
+			report.after = analyze_vertex_cache(sub_mesh.indices, vertex_count);
+			report.valid = true;
+		}
+
+		template <typename Real>
+		void optimize_vertex_cache(basic_gltf_mesh<Real>& mesh)
+		{
+			std::for_each(std::execution::par, std::begin(mesh.sub_meshes), std::end(mesh.sub_meshes),
+				[](basic_gltf_partial_mesh<Real>& sub_mesh) { optimize_vertex_cache(sub_mesh); });
+		}
+
+		void optimize_overdraw(std::vector<std::uint16_t>& indices, const std::vector<std::array<float, 3>>& positions,
+			float threshold)
+		{
+			overdraw_reorder(indices.data(), indices.size(), positions, threshold);
+		}
+
+		template <typename Real>
+		void optimize_overdraw(basic_gltf_mesh<Real>& mesh, float threshold)
+		{
+			std::for_each(std::execution::par, std::begin(mesh.sub_meshes), std::end(mesh.sub_meshes),
+				[&mesh, threshold](basic_gltf_partial_mesh<Real>& sub_mesh)
+			{
+				if (sub_mesh.render_mode != triangles_mode || sub_mesh.indices.empty() || !sub_mesh.position_info.valid)
+					return;
+
+				// blended primitives need their own back to front order
+				if (sub_mesh.material_index < mesh.materials.size()
+					&& mesh.materials[sub_mesh.material_index].alpha_mode == "BLEND")
+					return;
+
+				const detail::attribute_reader reader{ mesh.buffers, sub_mesh.position_info };
+				std::vector<std::array<float, 3>> positions(reader.size());
+				for (std::size_t i = 0; i < positions.size(); ++i)
+					positions[i] = reader.vec3(i);
+
+				optimize_overdraw(sub_mesh.indices, positions, threshold);
+			});
+		}
+
+		std::vector<std::uint16_t> simplify(const std::vector<std::uint16_t>& indices,
+			const std::vector<std::array<float, 3>>& positions, std::size_t target_index_count, float* error)
+		{
+			float result_error = 0.0f;
+			const std::vector<std::uint32_t> simplified = simplify_triangles(
+				std::vector<std::uint32_t>(std::begin(indices), std::end(indices)), positions, target_index_count, result_error);
+
+			if (error)
+				*error = result_error;
+
+			return std::vector<std::uint16_t>(std::begin(simplified), std::end(simplified));
+		}
+
+		template <typename Real>
+		void generate_lods(basic_gltf_mesh<Real>& mesh, const std::vector<float>& ratios, bool optimize_cache)
+		{
+			std::for_each(std::execution::par, std::begin(mesh.sub_meshes), std::end(mesh.sub_meshes),
+				[&mesh, &ratios, optimize_cache](basic_gltf_partial_mesh<Real>& sub_mesh)
+			{
+				sub_mesh.lods.clear();
+				if (sub_mesh.render_mode != triangles_mode || sub_mesh.indices.empty() || !sub_mesh.position_info.valid)
+					return;
+
+				const detail::attribute_reader reader{ mesh.buffers, sub_mesh.position_info };
+				std::vector<std::array<float, 3>> positions(reader.size());
+				for (std::size_t i = 0; i < positions.size(); ++i)
+					positions[i] = reader.vec3(i);
+
+				// each level starts from the previous one, which is a lot less work than the original
+				const std::vector<std::uint16_t>* source = &sub_mesh.indices;
+				float error = 0.0f;
+				for (float ratio : ratios)
+				{
+					const auto target = static_cast<std::size_t>(sub_mesh.indices.size() / 3 * ratio) * 3;
+
+					float step_error = 0.0f;
+					gltf_lod lod;
+					lod.indices = simplify(*source, positions, target, &step_error);
+					if (optimize_cache)
+						optimize_vertex_cache(lod.indices, positions.size());
+
+					// the errors of the steps are upper bounded by their sum
+					error += step_error;
+					lod.error = error;
+					lod.ratio = static_cast<float>(lod.indices.size()) / sub_mesh.indices.size();
+
+					sub_mesh.lods.emplace_back(std::move(lod));
+					source = &sub_mesh.lods.back().indices;
+				}
+			});
+		}
+
+		gltf_meshlets build_meshlets(const std::vector<std::uint16_t>& indices,
+			const std::vector<std::array<float, 3>>& positions, std::uint32_t max_vertices, std::uint32_t max_triangles)
+		{
+			max_vertices = std::max<std::uint32_t>(3, std::min(max_vertices, meshlet_vertex_limit));
+			max_triangles = std::max<std::uint32_t>(1, max_triangles);
+
+			const std::size_t triangle_count = indices.size() / 3;
+			const std::size_t vertex_count = positions.size();
+
+			// triangles around every vertex
+			std::vector<std::uint32_t> offsets(vertex_count + 1, 0);
+			for (std::size_t i = 0; i < triangle_count * 3; ++i)
+				++offsets[indices[i] + 1];
+			for (std::size_t v = 0; v < vertex_count; ++v)
+				offsets[v + 1] += offsets[v];
+
+			std::vector<std::uint32_t> adjacency(triangle_count * 3);
+			{
+				std::vector<std::uint32_t> fill(std::begin(offsets), std::end(offsets) - 1);
+				for (std::size_t i = 0; i < triangle_count * 3; ++i)
+					adjacency[fill[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+			}
+
+			gltf_meshlets result;
+			result.vertices.reserve(indices.size());
+			result.triangles.reserve(triangle_count * 3);
+
+			std::vector<std::uint8_t> emitted(triangle_count, 0);
+			std::vector<std::int16_t> local_index(vertex_count, -1);		// -1 when not in the current meshlet
+			std::size_t next_unused = 0;
+			std::size_t remaining = triangle_count;
+
+			while (remaining > 0)
+			{
+				gltf_meshlet meshlet;
+				meshlet.vertex_offset = static_cast<std::uint32_t>(result.vertices.size());
+				meshlet.triangle_offset = static_cast<std::uint32_t>(result.triangles.size());
+
+				auto new_vertices = [&](std::size_t t)
+				{
+					std::uint32_t count = 0;
+					for (int c = 0; c < 3; ++c)
+						count += local_index[indices[t * 3 + c]] < 0;
+					return count;
+				};
+
+				while (remaining > 0 && meshlet.triangle_count < max_triangles)
+				{
+					// the neighbour of the meshlet adding the fewest vertices, else the next unused triangle
+					std::size_t best = triangle_count;
+					std::uint32_t best_cost = 4;
+					for (std::uint32_t i = 0; i < meshlet.vertex_count && best_cost > 0; ++i)
+					{
+						const std::uint32_t v = result.vertices[meshlet.vertex_offset + i];
+						for (std::uint32_t a = offsets[v]; a < offsets[v + 1]; ++a)
+						{
+							const std::uint32_t t = adjacency[a];
+							if (emitted[t])
+								continue;
+
+							const std::uint32_t cost = new_vertices(t);
+							if (cost < best_cost)
+							{
+								best = t;
+								best_cost = cost;
+							}
+						}
+					}
+
+					if (best == triangle_count)
+					{
+						while (emitted[next_unused])
+							++next_unused;
+						best = next_unused;
+						best_cost = new_vertices(best);
+					}
+
+					if (meshlet.vertex_count + best_cost > max_vertices)
+						break;
+
+					for (int c = 0; c < 3; ++c)
+					{
+						const std::uint16_t v = indices[best * 3 + c];
+						if (local_index[v] < 0)
+						{
+							local_index[v] = static_cast<std::int16_t>(meshlet.vertex_count++);
+							result.vertices.push_back(v);
+						}
+						result.triangles.push_back(static_cast<std::uint8_t>(local_index[v]));
+					}
+
+					emitted[best] = 1;
+					++meshlet.triangle_count;
+					--remaining;
+				}
+
+				for (std::uint32_t i = 0; i < meshlet.vertex_count; ++i)
+					local_index[result.vertices[meshlet.vertex_offset + i]] = -1;
+
+				meshlet_bounds(meshlet, result, positions);
+				result.meshlets.push_back(meshlet);
+			}
+
+			return result;
+		}
+
+		template <typename Real>
+		void build_meshlets(basic_gltf_mesh<Real>& mesh, std::uint32_t max_vertices, std::uint32_t max_triangles)
+		{
+			std::for_each(std::execution::par, std::begin(mesh.sub_meshes), std::end(mesh.sub_meshes),
+				[&mesh, max_vertices, max_triangles](basic_gltf_partial_mesh<Real>& sub_mesh)
+			{
+				sub_mesh.meshlets = {};
+				if (sub_mesh.render_mode != triangles_mode || sub_mesh.indices.empty() || !sub_mesh.position_info.valid)
+					return;
+
+				const detail::attribute_reader reader{ mesh.buffers, sub_mesh.position_info };
+				std::vector<std::array<float, 3>> positions(reader.size());
+				for (std::size_t i = 0; i < positions.size(); ++i)
+					positions[i] = reader.vec3(i);
+
+				sub_mesh.meshlets = build_meshlets(sub_mesh.indices, positions, max_vertices, max_triangles);
+			});
+		}
+
+		std::uint32_t convert_to_list(std::vector<std::uint16_t>& indices, std::uint32_t render_mode)
+		{
+			switch (render_mode)
+			{
+			case triangle_strip_mode:
+				indices = expand_strip(indices);
+				return triangles_mode;
+
+			case triangle_fan_mode:
+			{
+				std::vector<std::uint16_t> list;
+				if (indices.size() >= 3)
+				{
+					list.resize((indices.size() - 2) * 3);
+					for (std::size_t i = 0; i + 2 < indices.size(); ++i)
+					{
+						list[i * 3] = indices[0];
+						list[i * 3 + 1] = indices[i + 1];
+						list[i * 3 + 2] = indices[i + 2];
+					}
+				}
+				indices = std::move(list);
+				return triangles_mode;
+			}
+
+			case line_strip_mode:
+			case line_loop_mode:
+			{
+				std::vector<std::uint16_t> list;
+				if (indices.size() >= 2)
+				{
+					list.reserve(indices.size() * 2);
+					for (std::size_t i = 0; i + 1 < indices.size(); ++i)
+					{
+						list.push_back(indices[i]);
+						list.push_back(indices[i + 1]);
+					}
+
+					// two points already are the whole loop, closing it again would draw the edge twice
+					if (render_mode == line_loop_mode && indices.size() > 2)
+					{
+						list.push_back(indices.back());
+						list.push_back(indices.front());
+					}
+				}
+				indices = std::move(list);
+				return lines_mode;
+			}
+
+			default:
+				return render_mode;
+			}
+		}
+
+		template <typename Real>
+		void convert_to_lists(basic_gltf_mesh<Real>& mesh)
+		{
+			std::for_each(std::execution::par, std::begin(mesh.sub_meshes), std::end(mesh.sub_meshes),
+				[](basic_gltf_partial_mesh<Real>& sub_mesh)
+			{
+				if (sub_mesh.primitive_restart)
+					return;		// made by stripify, already as small as it gets
+
+				if (sub_mesh.indices.empty())
+				{
+					// a primitive without indices draws its vertices in order, as long as they fit 16 bits
+					const std::size_t vertex_count = sub_mesh.position_info.valid ? sub_mesh.position_info.count : 0;
+					if (vertex_count == 0 || vertex_count > std::size_t(std::numeric_limits<std::uint16_t>::max()) + 1)
+						return;
+
+					sub_mesh.indices.resize(vertex_count);
+					for (std::size_t i = 0; i < vertex_count; ++i)
+						sub_mesh.indices[i] = static_cast<std::uint16_t>(i);
+				}
+
+				sub_mesh.render_mode = convert_to_list(sub_mesh.indices, sub_mesh.render_mode);
+			});
+		}
+
+		std::vector<std::uint16_t> stripify(const std::vector<std::uint16_t>& indices)
+		{
+			const std::size_t triangle_count = indices.size() / 3;
+
+			// every directed edge with the triangle it belongs to, the winding decides which
+			// neighbour can follow in a strip
+			std::vector<std::pair<std::uint64_t, std::uint32_t>> edges;
+			edges.reserve(triangle_count * 3);
+			for (std::uint32_t t = 0; t < triangle_count; ++t)
+				for (int c = 0; c < 3; ++c)
+					edges.emplace_back(directed_edge(indices[t * 3 + c], indices[t * 3 + (c + 1) % 3]), t);
+			std::sort(std::begin(edges), std::end(edges));
+
+			std::vector<std::uint8_t> used(triangle_count, 0);
+
+			// an unused triangle with the directed edge from -> to, or triangle_count
+			auto find = [&](std::uint32_t from, std::uint32_t to)
+			{
+				auto it = std::lower_bound(std::begin(edges), std::end(edges),
+					std::make_pair(directed_edge(from, to), std::uint32_t(0)));
+				for (; it != std::end(edges) && it->first == directed_edge(from, to); ++it)
+				{
+					if (!used[it->second])
+						return static_cast<std::size_t>(it->second);
+				}
+				return triangle_count;
+			};
+
+			auto third = [&](std::size_t t, std::uint32_t a, std::uint32_t b)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					const std::uint16_t v = indices[t * 3 + c];
+					if (v != a && v != b)
+						return v;
+				}
+				return indices[t * 3];
+			};
+
+			std::vector<std::uint16_t> strips;
+			strips.reserve(indices.size());
+
+			// strips start in triangle order, which keeps most of the vertex cache optimization
+			for (std::size_t start = 0; start < triangle_count; ++start)
+			{
+				if (used[start])
+					continue;
+
+				// pick the rotation whose second triangle exists, (a, b, c) is followed by (c, b, w)
+				const std::uint16_t* tri = indices.data() + start * 3;
+				int rotation = 0;
+				for (int r = 0; r < 3; ++r)
+				{
+					if (find(tri[(r + 2) % 3], tri[(r + 1) % 3]) != triangle_count)
+					{
+						rotation = r;
+						break;
+					}
+				}
+
+				if (!strips.empty())
+					strips.push_back(restart_index);
+
+				const std::size_t first = strips.size();
+				for (int c = 0; c < 3; ++c)
+					strips.push_back(tri[(rotation + c) % 3]);
+				used[start] = 1;
+
+				for (std::size_t k = 1;; ++k)
+				{
+					const std::uint16_t v1 = strips[first + k];
+					const std::uint16_t v2 = strips[first + k + 1];
+
+					// even triangles are drawn (v1, v2, w), odd ones (v2, v1, w)
+					const std::size_t next = (k & 1) ? find(v2, v1) : find(v1, v2);
+					if (next == triangle_count)
+						break;
+
+					strips.push_back(third(next, v1, v2));
+					used[next] = 1;
+				}
+			}
+
+			return strips;
+		}
+
+		template <typename Real>
+		void stripify(basic_gltf_mesh<Real>& mesh)
+		{
+			std::for_each(std::execution::par, std::begin(mesh.sub_meshes), std::end(mesh.sub_meshes),
+				[](basic_gltf_partial_mesh<Real>& sub_mesh)
+			{
+				if (sub_mesh.render_mode != triangles_mode || sub_mesh.indices.empty())
+					return;
+
+				// the restart value can not be a vertex as well
+				if (detail::vertex_count_of(sub_mesh) > restart_index)
+					return;
+
+				std::vector<std::uint16_t> strips = stripify(sub_mesh.indices);
+				if (strips.size() >= sub_mesh.indices.size())
+					return;
+
+				sub_mesh.indices = std::move(strips);
+				sub_mesh.render_mode = triangle_strip_mode;
+				sub_mesh.primitive_restart = true;
+			});
+		}
+
+		template <typename Real>
+		void merge_primitives(basic_gltf_mesh<Real>& mesh)
+		{
+			// greedy groups in the order the primitives come, a group that is full starts another one
+			struct group
+			{
+				std::vector<std::uint64_t> signature;
+				std::vector<std::size_t> members;
+				std::size_t vertex_count;
+			};
+
+			std::vector<group> groups;
+			std::vector<bool> grouped(mesh.sub_meshes.size(), false);
+			for (std::size_t i = 0; i < mesh.sub_meshes.size(); ++i)
+			{
+				basic_gltf_partial_mesh<Real>& sub_mesh = mesh.sub_meshes[i];
+				const bool list_mode = sub_mesh.render_mode == 0 || sub_mesh.render_mode == lines_mode
+					|| sub_mesh.render_mode == triangles_mode;
+				const std::size_t vertex_count = detail::vertex_count_of(sub_mesh);
+				if (!list_mode || sub_mesh.primitive_restart || sub_mesh.quantization.valid || !sub_mesh.position_info.valid
+					|| !sub_mesh.targets.empty() || vertex_count > max_vertices_16)
+					continue;
+
+				std::vector<std::uint64_t> signature = merge_signature(sub_mesh);
+				auto open = std::find_if(std::rbegin(groups), std::rend(groups), [&](const group& g)
+				{
+					return g.signature == signature && g.vertex_count + vertex_count <= max_vertices_16;
+				});
+
+				if (open == std::rend(groups))
+				{
+					groups.push_back(group{ std::move(signature), {}, 0 });
+					open = std::rbegin(groups);
+				}
+
+				open->members.push_back(i);
+				open->vertex_count += vertex_count;
+			}
+
+			groups.erase(std::remove_if(std::begin(groups), std::end(groups),
+				[](const group& g) { return g.members.size() < 2; }), std::end(groups));
+			if (groups.empty())
+				return;
+
+			// every group writes its own buffer slot, they are appended once all are done
+			const std::size_t first_new_buffer = mesh.buffers.size();
+			std::vector<gltf_buffer> new_buffers(groups.size());
+			std::vector<basic_gltf_partial_mesh<Real>> merged(groups.size());
+
+			std::vector<std::size_t> slots(groups.size());
+			for (std::size_t i = 0; i < slots.size(); ++i)
+				slots[i] = i;
+
+			std::for_each(std::execution::par, std::begin(slots), std::end(slots), [&](std::size_t slot)
+			{
+				std::vector<basic_gltf_partial_mesh<Real>*> members;
+				for (std::size_t i : groups[slot].members)
+					members.push_back(&mesh.sub_meshes[i]);
+
+				merged[slot] = merge_group(mesh.buffers, members, static_cast<std::uint32_t>(first_new_buffer + slot),
+					new_buffers[slot]);
+			});
+
+			for (std::size_t slot = 0; slot < new_buffers.size(); ++slot)
+				mesh.buffers.emplace_back(std::move(new_buffers[slot]));
+
+			// the merged primitive takes the first member's place, the other members go
+			std::vector<int> replacement(mesh.sub_meshes.size(), -1);
+			std::vector<bool> removed(mesh.sub_meshes.size(), false);
+			for (std::size_t slot = 0; slot < groups.size(); ++slot)
+			{
+				replacement[groups[slot].members.front()] = static_cast<int>(slot);
+				for (std::size_t m = 1; m < groups[slot].members.size(); ++m)
+					removed[groups[slot].members[m]] = true;
+			}
+
+			std::vector<basic_gltf_partial_mesh<Real>> sub_meshes;
+			for (std::size_t i = 0; i < mesh.sub_meshes.size(); ++i)
+			{
+				if (replacement[i] >= 0)
+					sub_meshes.emplace_back(std::move(merged[replacement[i]]));
+				else if (!removed[i])
+					sub_meshes.emplace_back(std::move(mesh.sub_meshes[i]));
+			}
+
+			mesh.sub_meshes = std::move(sub_meshes);
+			detail::remove_unused_buffers(mesh);
+		}
+
+		template <typename Real>
+		void split_primitive(basic_gltf_mesh<Real>& mesh, basic_gltf_partial_mesh<Real> sub_mesh,
+			const std::vector<std::uint32_t>& indices, std::size_t max_vertices)
+		{
+			max_vertices = std::min(std::max<std::size_t>(max_vertices, 3), max_vertices_16);
+
+			std::vector<std::uint32_t> list = indices;
+			sub_mesh.render_mode = expand_to_list(list, sub_mesh.render_mode);
+			const std::size_t corners = sub_mesh.render_mode == triangles_mode ? 3 : sub_mesh.render_mode == lines_mode ? 2 : 1;
+			const std::size_t primitive_count = list.size() / corners;
+
+			std::size_t vertex_count = 0;
+			for (std::uint32_t index : list)
+				vertex_count = std::max<std::size_t>(vertex_count, std::size_t(index) + 1);
+
+			// primitives along a Morton curve of their centers, so that a chunk is a compact region and
+			// shares as many vertices as possible with itself instead of with the next chunk
+			std::vector<std::uint32_t> order(primitive_count);
+			for (std::uint32_t i = 0; i < order.size(); ++i)
+				order[i] = i;
+
+			if (sub_mesh.position_info.valid && sub_mesh.position_info.count >= vertex_count)
+			{
+				const detail::attribute_reader positions{ mesh.buffers, sub_mesh.position_info };
+
+				std::vector<std::array<float, 3>> centers(primitive_count);
+				std::array<float, 3> low = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+					std::numeric_limits<float>::max() };
+				std::array<float, 3> high = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(),
+					std::numeric_limits<float>::lowest() };
+
+				for (std::size_t p = 0; p < primitive_count; ++p)
+				{
+					std::array<float, 3> center = { 0.0f, 0.0f, 0.0f };
+					for (std::size_t k = 0; k < corners; ++k)
+					{
+						const std::array<float, 3> v = positions.vec3(list[p * corners + k]);
+						for (int c = 0; c < 3; ++c)
+							center[c] += v[c] / corners;
+					}
+
+					for (int c = 0; c < 3; ++c)
+					{
+						low[c] = std::min(low[c], center[c]);
+						high[c] = std::max(high[c], center[c]);
+					}
+					centers[p] = center;
+				}
+
+				std::vector<std::uint32_t> codes(primitive_count);
+				for (std::size_t p = 0; p < primitive_count; ++p)
+				{
+					std::uint32_t code = 0;
+					for (int c = 0; c < 3; ++c)
+					{
+						const float extent = high[c] - low[c];
+						const float t = extent > 0.0f ? (centers[p][c] - low[c]) / extent : 0.0f;
+						code |= spread_bits(static_cast<std::uint32_t>(t * 1023.0f)) << c;
+					}
+					codes[p] = code;
+				}
+
+				std::stable_sort(std::begin(order), std::end(order),
+					[&codes](std::uint32_t a, std::uint32_t b) { return codes[a] < codes[b]; });
+			}
+
+			// greedy chunks, a chunk is closed when the next primitive's new vertices would not fit
+			struct chunk
+			{
+				std::vector<std::uint32_t> source_vertices;
+				std::vector<std::uint16_t> indices;
+			};
+
+			std::vector<chunk> chunks(1);
+			std::vector<std::uint32_t> local(vertex_count, 0);	// local index + 1 in the current chunk
+			std::vector<std::uint32_t> stamp(vertex_count, 0);	// chunk number + 1 that local belongs to
+
+			for (std::uint32_t p : order)
+			{
+				std::size_t new_vertices = 0;
+				for (std::size_t k = 0; k < corners; ++k)
+				{
+					const std::uint32_t v = list[p * corners + k];
+					bool repeated = stamp[v] == chunks.size();
+					for (std::size_t j = 0; j < k && !repeated; ++j)
+						repeated = list[p * corners + j] == v;
+					new_vertices += repeated ? 0 : 1;
+				}
+
+				if (chunks.back().source_vertices.size() + new_vertices > max_vertices)
+					chunks.emplace_back();
+
+				chunk& current = chunks.back();
+				const std::uint32_t chunk_number = static_cast<std::uint32_t>(chunks.size());
+				for (std::size_t k = 0; k < corners; ++k)
+				{
+					const std::uint32_t v = list[p * corners + k];
+					if (stamp[v] != chunk_number)
+					{
+						stamp[v] = chunk_number;
+						local[v] = static_cast<std::uint32_t>(current.source_vertices.size());
+						current.source_vertices.push_back(v);
+					}
+
+					current.indices.push_back(static_cast<std::uint16_t>(local[v]));
+				}
+			}
+
+			if (chunks.back().indices.empty())
+				chunks.pop_back();
+
+			// every chunk gathers its own vertices, in parallel
+			sub_mesh.indices.clear();
+			sub_mesh.primitive_restart = false;
+
+			const std::size_t first_new_buffer = mesh.buffers.size();
+			std::vector<basic_gltf_partial_mesh<Real>> pieces(chunks.size(), sub_mesh);
+			std::vector<gltf_buffer> new_buffers(chunks.size());
+
+			std::vector<std::size_t> slots(chunks.size());
+			for (std::size_t i = 0; i < slots.size(); ++i)
+				slots[i] = i;
+
+			std::for_each(std::execution::par, std::begin(slots), std::end(slots), [&](std::size_t slot)
+			{
+				pieces[slot].indices = std::move(chunks[slot].indices);
+				new_buffers[slot] = detail::gather_vertices(mesh.buffers, pieces[slot], chunks[slot].source_vertices,
+					static_cast<std::uint32_t>(first_new_buffer + slot));
+			});
+
+			for (std::size_t slot = 0; slot < chunks.size(); ++slot)
+			{
+				mesh.buffers.emplace_back(std::move(new_buffers[slot]));
+				mesh.sub_meshes.emplace_back(std::move(pieces[slot]));
+			}
+		}
+
+		template <typename Real>
+		void pre_transform(basic_gltf_mesh<Real>& mesh, const std::array<double, 16>& matrix)
+		{
+			// normals go through the inverse transpose of the upper 3x3, the cofactor matrix is the
+			// same up to the determinant, the normalize removes its size and the sign is put back
+			const double* m = matrix.data();
+			double cofactor[9] = {
+				m[5] * m[10] - m[6] * m[9], m[6] * m[8] - m[4] * m[10], m[4] * m[9] - m[5] * m[8],
+				m[2] * m[9] - m[1] * m[10], m[0] * m[10] - m[2] * m[8], m[1] * m[8] - m[0] * m[9],
+				m[1] * m[6] - m[2] * m[5], m[2] * m[4] - m[0] * m[6], m[0] * m[5] - m[1] * m[4] };
+			const double determinant = m[0] * cofactor[0] + m[4] * cofactor[3] + m[8] * cofactor[6];
+			const bool mirrored = determinant < 0.0;
+			if (mirrored)
+				for (double& c : cofactor)
+					c = -c;
+
+			auto transform = [m](const std::array<float, 3>& v, double w)
+			{
+				std::array<float, 3> r;
+				for (int row = 0; row < 3; ++row)
+					r[row] = static_cast<float>(m[row] * v[0] + m[4 + row] * v[1] + m[8 + row] * v[2] + m[12 + row] * w);
+				return r;
+			};
+
+			auto normalized = [](std::array<double, 3> v)
+			{
+				const double length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+				if (length > 0.0)
+					v = { v[0] / length, v[1] / length, v[2] / length };
+				return std::array<float, 3>{ static_cast<float>(v[0]), static_cast<float>(v[1]), static_cast<float>(v[2]) };
+			};
+
+			const std::size_t first_new_buffer = mesh.buffers.size();
+			std::vector<gltf_buffer> new_buffers(mesh.sub_meshes.size());
+
+			std::vector<std::size_t> slots(mesh.sub_meshes.size());
+			for (std::size_t i = 0; i < slots.size(); ++i)
+				slots[i] = i;
+
+			std::for_each(std::execution::par, std::begin(slots), std::end(slots), [&](std::size_t slot)
+			{
+				basic_gltf_partial_mesh<Real>& sub_mesh = mesh.sub_meshes[slot];
+
+				// only float streams can be transformed in place, quantized ones would need new bounds
+				std::vector<basic_gltf_component_info<Real>*> streams;
+				if (sub_mesh.position_info.valid && sub_mesh.position_info.component_type == detail::GL_FLOAT)
+					streams.push_back(&sub_mesh.position_info);
+				if (sub_mesh.normal_info.valid && sub_mesh.normal_info.component_type == detail::GL_FLOAT)
+					streams.push_back(&sub_mesh.normal_info);
+				if (sub_mesh.tangent_info.valid && sub_mesh.tangent_info.component_type == detail::GL_FLOAT)
+					streams.push_back(&sub_mesh.tangent_info);
+
+				// target displacements of the streams that move: positions through the upper 3x3, normals and
+				// tangents like their base vector and divided by its transformed length, so base plus weighted
+				// deltas points where the transformed morph would before morph_vertices normalizes it
+				std::vector<std::pair<basic_gltf_component_info<Real>*, std::vector<float>>> target_streams;
+				auto add_target_stream = [&](basic_gltf_component_info<Real>& delta_info, const basic_gltf_component_info<Real>& base_info,
+					bool is_normal)
+				{
+					if (!delta_info.valid || !base_info.valid || base_info.component_type != detail::GL_FLOAT)
+						return;
+
+					const detail::attribute_reader delta{ mesh.buffers, delta_info };
+					const detail::attribute_reader base{ mesh.buffers, base_info };
+					const bool is_position = &base_info == &sub_mesh.position_info;
+					std::vector<float> deltas(delta.size() * 3);
+					for (std::size_t i = 0; i < delta.size(); ++i)
+					{
+						const std::array<float, 3> d = delta.vec3(i);
+						std::array<float, 3> moved;
+						if (is_normal)
+						{
+							for (int row = 0; row < 3; ++row)
+								moved[row] = static_cast<float>(cofactor[row] * d[0] + cofactor[3 + row] * d[1] + cofactor[6 + row] * d[2]);
+						}
+						else
+						{
+							moved = transform(d, 0.0);
+						}
+
+						if (!is_position && i < base.size())
+						{
+							const std::array<float, 3> b = base.vec3(i);
+							std::array<double, 3> moved_base;
+							for (int row = 0; row < 3; ++row)
+								moved_base[row] = is_normal ? cofactor[row] * b[0] + cofactor[3 + row] * b[1] + cofactor[6 + row] * b[2]
+									: m[row] * b[0] + m[4 + row] * b[1] + m[8 + row] * b[2];
+							const double length = std::sqrt(moved_base[0] * moved_base[0] + moved_base[1] * moved_base[1]
+								+ moved_base[2] * moved_base[2]);
+							if (length > 0.0)
+								for (float& c : moved)
+									c = static_cast<float>(c / length);
+						}
+
+						std::copy(std::begin(moved), std::end(moved), deltas.data() + i * 3);
+					}
+
+					target_streams.emplace_back(&delta_info, std::move(deltas));
+				};
+
+				for (basic_gltf_morph_target<Real>& target : sub_mesh.targets)
+				{
+					add_target_stream(target.position_info, sub_mesh.position_info, false);
+					add_target_stream(target.normal_info, sub_mesh.normal_info, true);
+					add_target_stream(target.tangent_info, sub_mesh.tangent_info, false);
+				}
+
+				std::size_t byte_length = 0;
+				for (auto* info : streams)
+					byte_length += std::size_t(info->count) * info->component_count * sizeof(float);
+				for (const auto& target_stream : target_streams)
+					byte_length += target_stream.second.size() * sizeof(float);
+
+				gltf_buffer& buffer = new_buffers[slot];
+				buffer = gltf_buffer{ byte_length, std::vector<std::uint8_t>(byte_length) };
+
+				// new exact bounds of a stream already in the buffer
+				auto rebound = [&buffer](basic_gltf_component_info<Real>& info)
+				{
+					const detail::attribute_reader packed{ info, buffer };
+					for (int c = 0; c < 3; ++c)
+					{
+						info.min_bounds[c] = std::numeric_limits<Real>::max();
+						info.max_bounds[c] = std::numeric_limits<Real>::lowest();
+					}
+					for (std::size_t i = 0; i < packed.size(); ++i)
+						for (int c = 0; c < 3; ++c)
+						{
+							info.min_bounds[c] = std::min(info.min_bounds[c], static_cast<Real>(packed.component(i, c)));
+							info.max_bounds[c] = std::max(info.max_bounds[c], static_cast<Real>(packed.component(i, c)));
+						}
+				};
+
+				std::size_t offset = 0;
+				for (auto* info : streams)
+				{
+					const detail::attribute_reader reader{ mesh.buffers, *info };
+					float* out = reinterpret_cast<float*>(buffer.data.data() + offset);
+					const std::uint32_t components = info->component_count;
+
+					for (std::size_t i = 0; i < reader.size(); ++i, out += components)
+					{
+						std::array<float, 3> v = reader.vec3(i);
+						if (info == &sub_mesh.position_info)
+						{
+							v = transform(v, 1.0);
+						}
+						else if (info == &sub_mesh.normal_info)
+						{
+							v = normalized({ cofactor[0] * v[0] + cofactor[3] * v[1] + cofactor[6] * v[2],
+								cofactor[1] * v[0] + cofactor[4] * v[1] + cofactor[7] * v[2],
+								cofactor[2] * v[0] + cofactor[5] * v[1] + cofactor[8] * v[2] });
+						}
+						else
+						{
+							const std::array<float, 3> t = transform(v, 0.0);
+							v = normalized({ t[0], t[1], t[2] });
+						}
+
+						std::copy(std::begin(v), std::end(v), out);
+						if (components == 4)
+							out[3] = reader.component(i, 3) * (mirrored && info == &sub_mesh.tangent_info ? -1.0f : 1.0f);
+					}
+
+					info->buffer_index = static_cast<std::uint32_t>(first_new_buffer + slot);
+					info->byte_offset = static_cast<std::uint32_t>(offset);
+					info->byte_stride = 0;
+					rebound(*info);
+
+					offset += std::size_t(info->count) * components * sizeof(float);
+				}
+
+				for (auto& [info, deltas] : target_streams)
+				{
+					std::memcpy(buffer.data.data() + offset, deltas.data(), deltas.size() * sizeof(float));
+					info->buffer_index = static_cast<std::uint32_t>(first_new_buffer + slot);
+					info->byte_offset = static_cast<std::uint32_t>(offset);
+					info->byte_stride = 0;
+					info->component_type = detail::GL_FLOAT;
+					info->component_count = 3;
+					rebound(*info);
+
+					offset += deltas.size() * sizeof(float);
+				}
+
+				// a mirror turns the triangles inside out
+				const bool triangles = sub_mesh.render_mode == triangles_mode
+					|| sub_mesh.render_mode == triangle_strip_mode || sub_mesh.render_mode == triangle_fan_mode;
+				if (mirrored && triangles)
+				{
+					if (sub_mesh.indices.empty() && detail::vertex_count_of(sub_mesh) <= max_vertices_16)
+					{
+						sub_mesh.indices.resize(detail::vertex_count_of(sub_mesh));
+						for (std::size_t i = 0; i < sub_mesh.indices.size(); ++i)
+							sub_mesh.indices[i] = static_cast<std::uint16_t>(i);
+					}
+
+					flip_winding(sub_mesh.indices, sub_mesh.render_mode, sub_mesh.primitive_restart);
+				}
+			});
+
+			for (std::size_t slot = 0; slot < new_buffers.size(); ++slot)
+				mesh.buffers.emplace_back(std::move(new_buffers[slot]));
+
+			detail::remove_unused_buffers(mesh);
+		}
+
+		std::vector<std::uint32_t> optimize_vertex_fetch(std::vector<std::uint16_t>& indices, std::size_t vertex_count)
+		{
+			return first_use_order(indices.data(), indices.size(), vertex_count);
+		}
+
+		template <typename Real>
+		void optimize_vertex_fetch(basic_gltf_mesh<Real>& mesh)
+		{
+			detail::rebuild_vertices(mesh, [](basic_gltf_partial_mesh<Real>& sub_mesh, std::vector<std::uint32_t>& source_vertices)
+			{
+				if (sub_mesh.indices.empty())
+					return false;
+
+				source_vertices = optimize_vertex_fetch(sub_mesh.indices, detail::vertex_count_of(sub_mesh));
+				return true;
+			});
+		}
+
+		template void weld_vertices(gltf_mesh&, float);
+		template void weld_vertices(gltf_mesh_f&, float);
+		template void optimize_vertex_cache(gltf_partial_mesh&);
+		template void optimize_vertex_cache(gltf_partial_mesh_f&);
+		template void optimize_vertex_cache(gltf_mesh&);
+		template void optimize_vertex_cache(gltf_mesh_f&);
+		template void optimize_overdraw(gltf_mesh&, float);
+		template void optimize_overdraw(gltf_mesh_f&, float);
+		template void generate_lods(gltf_mesh&, const std::vector<float>&, bool);
+		template void generate_lods(gltf_mesh_f&, const std::vector<float>&, bool);
+		template void build_meshlets(gltf_mesh&, std::uint32_t, std::uint32_t);
+		template void build_meshlets(gltf_mesh_f&, std::uint32_t, std::uint32_t);
+		template void convert_to_lists(gltf_mesh&);
+		template void convert_to_lists(gltf_mesh_f&);
+		template void stripify(gltf_mesh&);
+		template void stripify(gltf_mesh_f&);
+		template void merge_primitives(gltf_mesh&);
+		template void merge_primitives(gltf_mesh_f&);
+		template void split_primitive(gltf_mesh&, gltf_partial_mesh, const std::vector<std::uint32_t>&, std::size_t);
+		template void split_primitive(gltf_mesh_f&, gltf_partial_mesh_f, const std::vector<std::uint32_t>&, std::size_t);
+		template void pre_transform(gltf_mesh&, const std::array<double, 16>&);
+		template void pre_transform(gltf_mesh_f&, const std::array<double, 16>&);
+		template void optimize_vertex_fetch(gltf_mesh&);
+		template void optimize_vertex_fetch(gltf_mesh_f&);
+	} // namespace graphics
+} // namespace knu
@@ -0,0 +1,124 @@
+#ifndef KNU_GLTF_MESH_OPT_HPP
+#define KNU_GLTF_MESH_OPT_HPP
+
+#include "gltf.hpp"
+
+namespace knu
+{
+	namespace graphics
+	{
+		// turns an index list of the given mode into the matching list mode and returns that mode.
+		// TRIANGLE_STRIP and TRIANGLE_FAN become TRIANGLES (strips with SSE2 where available, dropping
+		// the degenerate stitching triangles), LINE_STRIP and LINE_LOOP become LINES, the rest is unchanged
+		std::uint32_t convert_to_list(std::vector<std::uint16_t>& indices, std::uint32_t render_mode);
+
+		// converts every primitive of the mesh in parallel, so consumers only see POINTS, LINES and
+		// TRIANGLES. Primitives without indices get them first, if their vertices fit 16 bit indices
+		template <typename Real>
+		void convert_to_lists(basic_gltf_mesh<Real>& mesh);
+
+		// joins the triangles of a list into strips, separated by the restart index 0xffff. Each
+		// strip follows the winding of its triangles, so no degenerate triangles are needed
+		std::vector<std::uint16_t> stripify(const std::vector<std::uint16_t>& indices);
+
+		// stripifies every indexed TRIANGLES primitive in parallel and sets its primitive_restart. A primitive
+		// keeps its list when the strips would not be smaller or when one of its vertices is 0xffff
+		template <typename Real>
+		void stripify(basic_gltf_mesh<Real>& mesh);
+
+		// concatenates compatible primitives, same material, render mode and attributes (semantics and
+		// formats), into one primitive each, rebasing the indices. POINTS, LINES and TRIANGLES merge,
+		// anything else (and primitives with morph targets) is left alone, and a merged primitive never goes past 65536 vertices, the group
+		// is split instead. Merged primitives get a buffer of their own and take the place of their
+		// first member, the derived data (lods, meshlets, hierarchies) of the members is dropped
+		template <typename Real>
+		void merge_primitives(basic_gltf_mesh<Real>& mesh);
+
+		// appends sub_mesh to the mesh as primitives of at most max_vertices vertices each, so that its
+		// 32 bit indices fit the 16 bit ones of gltf_partial_mesh. Strips, fans and loops are turned into
+		// lists, the lines and triangles are sorted along a Morton curve of their centers so that each
+		// chunk is a compact piece of the surface, and every chunk gets its vertices in a buffer of its own
+		template <typename Real>
+		void split_primitive(basic_gltf_mesh<Real>& mesh, basic_gltf_partial_mesh<Real> sub_mesh,
+			const std::vector<std::uint32_t>& indices, std::size_t max_vertices = 65536);
+
+		// bakes a column major transform into the float POSITION, NORMAL and TANGENT of every primitive,
+		// and into the displacements of its morph targets, in owned buffers. Mirroring transforms flip the
+		// triangle winding back and the bitangent signs
+		template <typename Real>
+		void pre_transform(basic_gltf_mesh<Real>& mesh, const std::array<double, 16>& matrix);
+
+		// merges the vertices of each primitive whose attributes are all identical, rewriting the indices
+		// (or creating them for a primitive that had none) and the attribute streams into an owned
+		// buffer. With epsilon > 0 float components are compared on a grid of that size instead, so
+		// values that differ by rounding weld too. One hashing pass per primitive, primitives in
+		// parallel, and every primitive's weld_report says how many vertices were removed
+		template <typename Real>
+		void weld_vertices(basic_gltf_mesh<Real>& mesh, float epsilon = 0.0f);
+
+		// simulates a FIFO post transform cache of cache_size entries over a triangle list
+		gltf_vertex_cache_stats analyze_vertex_cache(const std::vector<std::uint16_t>& indices,
+			std::size_t vertex_count, std::uint32_t cache_size = 16);
+
+		// reorders the triangles of a triangle list for vertex cache locality (Forsyth's
+		// linear speed algorithm), the triangles themselves and their winding are unchanged
+		void optimize_vertex_cache(std::vector<std::uint16_t>& indices, std::size_t vertex_count);
+
+		// optimizes one TRIANGLES primitive and fills in its vertex_cache_report,
+		// other render modes and primitives without indices are left alone
+		template <typename Real>
+		void optimize_vertex_cache(basic_gltf_partial_mesh<Real>& sub_mesh);
+
+		// every primitive of the mesh, in parallel
+		template <typename Real>
+		void optimize_vertex_cache(basic_gltf_mesh<Real>& mesh);
+
+		// splits a vertex cache optimized triangle list into clusters, as small as possible while their
+		// cache miss ratio stays within threshold times the original, then orders the clusters so the ones
+		// facing away from the mesh center (the likely occluders) are drawn first. View independent
+		void optimize_overdraw(std::vector<std::uint16_t>& indices, const std::vector<std::array<float, 3>>& positions,
+			float threshold = 1.05f);
+
+		// every indexed TRIANGLES primitive of the mesh in parallel, using its POSITION accessor.
+		// Primitives with a BLEND material are skipped, their order is up to the renderer
+		template <typename Real>
+		void optimize_overdraw(basic_gltf_mesh<Real>& mesh, float threshold = 1.05f);
+
+		// quadric error edge collapse down to about target_index_count indices. Vertices only ever
+		// move onto other existing vertices, so the result indexes the same vertex buffer. Borders only
+		// collapse along themselves and vertices on attribute seams (several vertices at one position)
+		// stay where they are. error receives the largest deviation relative to the bounding box diagonal
+		std::vector<std::uint16_t> simplify(const std::vector<std::uint16_t>& indices,
+			const std::vector<std::array<float, 3>>& positions, std::size_t target_index_count,
+			float* error = nullptr);
+
+		// fills in the lods of every indexed TRIANGLES primitive in parallel, one per ratio. Each lod
+		// is simplified from the one before it, and vertex cache optimized when optimize_cache is set
+		template <typename Real>
+		void generate_lods(basic_gltf_mesh<Real>& mesh, const std::vector<float>& ratios, bool optimize_cache = true);
+
+		// splits a triangle list into meshlets of at most max_vertices vertices (256 at most) and
+		// max_triangles triangles. Triangles are added greedily, preferring ones next to the meshlet
+		// that bring the fewest new vertices, so the input order matters less than with a plain split
+		gltf_meshlets build_meshlets(const std::vector<std::uint16_t>& indices,
+			const std::vector<std::array<float, 3>>& positions, std::uint32_t max_vertices = 64,
+			std::uint32_t max_triangles = 124);
+
+		// fills in the meshlets of every indexed TRIANGLES primitive in parallel
+		template <typename Real>
+		void build_meshlets(basic_gltf_mesh<Real>& mesh, std::uint32_t max_vertices = 64,
+			std::uint32_t max_triangles = 124);
+
+		// renumbers the vertices in the order the indices first use them and rewrites the indices to
+		// match. Returns the old vertex for every new one, unreferenced vertices are left out
+		std::vector<std::uint32_t> optimize_vertex_fetch(std::vector<std::uint16_t>& indices, std::size_t vertex_count);
+
+		// applies the above to every indexed primitive of the mesh in parallel. Each primitive gets
+		// its own compact buffer with every attribute stream in the new order, and buffers that no
+		// attribute uses afterwards are removed from the mesh. Best run after optimize_vertex_cache
+		template <typename Real>
+		void optimize_vertex_fetch(basic_gltf_mesh<Real>& mesh);
+	}
+}
+
+#endif // !KNU_GLTF_MESH_OPT_HPP
@@ -0,0 +1,157 @@
+#include "gltf_morph.hpp"
+#include "gltf_detail.hpp"
+#include <algorithm>
+#include <cmath>
+#include <execution>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace knu
+{
+	namespace graphics
+	{
+		namespace
+		{
+			// vertices per task, the output of a range stays in cache while every target is added to it
+			const std::size_t morph_range = 4096;
+
+			template <typename Real>
+			struct weighted_target
+			{
+				const basic_gltf_component_info<Real>* info;
+				float weight;
+			};
+
+			// out[i] += weight * delta[i] for n floats
+			void accumulate(float* out, const float* delta, float weight, std::size_t n)
+			{
+				std::size_t i = 0;
+#if defined(__AVX__)
+				const __m256 weight8 = _mm256_set1_ps(weight);
+				for (; i + 8 <= n; i += 8)
+					_mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(weight8, _mm256_loadu_ps(delta + i))));
+#endif
+#if defined(KNU_GLTF_SSE)
+				const __m128 weight4 = _mm_set1_ps(weight);
+				for (; i + 4 <= n; i += 4)
+					_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(weight4, _mm_loadu_ps(delta + i))));
+#endif
+				for (; i < n; ++i)
+					out[i] += weight * delta[i];
+			}
+
+			// the xyz of the vertices [first, last) as floats, straight from the buffer when they are
+			// tightly packed floats already, decoded into scratch otherwise
+			template <typename Real>
+			const float* xyz_range(const std::vector<gltf_buffer>& buffers, const basic_gltf_component_info<Real>& info,
+				std::size_t first, std::size_t last, std::vector<float>& scratch)
+			{
+				const detail::attribute_reader reader{ buffers, info };
+				if (info.component_type == detail::GL_FLOAT && info.component_count == 3
+					&& (info.byte_stride == 0 || info.byte_stride == 3 * sizeof(float)))
+					return reinterpret_cast<const float*>(reader.element(first));
+
+				scratch.resize((last - first) * 3);
+				for (std::size_t i = first; i < last; ++i)
+				{
+					const std::array<float, 3> v = reader.vec3(i);
+					std::copy(std::begin(v), std::end(v), scratch.data() + (i - first) * 3);
+				}
+
+				return scratch.data();
+			}
+
+			template <typename Real>
+			void blend_range(const std::vector<gltf_buffer>& buffers, const basic_gltf_component_info<Real>& base,
+				const std::vector<weighted_target<Real>>& targets, std::size_t first, std::size_t last, float* out,
+				std::vector<float>& scratch)
+			{
+				const std::size_t n = (last - first) * 3;
+				const float* base_values = xyz_range(buffers, base, first, last, scratch);
+				std::copy(base_values, base_values + n, out);
+
+				for (const weighted_target<Real>& target : targets)
+					accumulate(out, xyz_range(buffers, *target.info, first, last, scratch), target.weight, n);
+			}
+		}
+
+		template <typename Real>
+		bool morph_vertices(const basic_gltf_mesh<Real>& mesh, const basic_gltf_partial_mesh<Real>& sub_mesh,
+			const float* weights, std::size_t weight_count, std::vector<float>& positions,
+			std::vector<float>* normals)
+		{
+			if (!sub_mesh.position_info.valid || sub_mesh.quantization.valid)
+				return false;
+
+			const std::size_t vertex_count = sub_mesh.position_info.count;
+			const bool morph_normals = normals != nullptr && sub_mesh.normal_info.valid && sub_mesh.normal_info.count >= vertex_count;
+
+			// only the targets that move anything, a face rig has most of its weights at 0
+			std::vector<weighted_target<Real>> position_targets;
+			std::vector<weighted_target<Real>> normal_targets;
+			const std::size_t target_count = std::min(weight_count, sub_mesh.targets.size());
+			for (std::size_t t = 0; t < target_count; ++t)
+			{
+				if (weights[t] == 0.0f)
+					continue;
+
+				const basic_gltf_morph_target<Real>& target = sub_mesh.targets[t];
+				if (target.position_info.valid && target.position_info.count >= vertex_count)
+					position_targets.push_back(weighted_target<Real>{ &target.position_info, weights[t] });
+				if (morph_normals && target.normal_info.valid && target.normal_info.count >= vertex_count)
+					normal_targets.push_back(weighted_target<Real>{ &target.normal_info, weights[t] });
+			}
+
+			positions.resize(vertex_count * 3);
+			if (normals != nullptr)
+				normals->resize(morph_normals ? vertex_count * 3 : 0);
+
+			std::vector<std::size_t> ranges;
+			for (std::size_t first = 0; first < vertex_count; first += morph_range)
+				ranges.push_back(first);
+
+			std::for_each(std::execution::par, std::begin(ranges), std::end(ranges), [&](std::size_t first)
+			{
+				const std::size_t last = std::min(first + morph_range, vertex_count);
+				std::vector<float> scratch;
+
+				blend_range(mesh.buffers, sub_mesh.position_info, position_targets, first, last,
+					positions.data() + first * 3, scratch);
+
+				if (!morph_normals)
+					return;
+
+				float* n = normals->data() + first * 3;
+				blend_range(mesh.buffers, sub_mesh.normal_info, normal_targets, first, last, n, scratch);
+				if (normal_targets.empty())
+					return;
+
+				for (std::size_t i = 0; i < last - first; ++i, n += 3)
+				{
+					const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					if (length > 0.0f)
+						for (int c = 0; c < 3; ++c)
+							n[c] /= length;
+				}
+			});
+
+			return true;
+		}
+
+		template <typename Real>
+		bool morph_vertices(const basic_gltf_node<Real>& node, const basic_gltf_partial_mesh<Real>& sub_mesh,
+			std::vector<float>& positions, std::vector<float>* normals)
+		{
+			return morph_vertices(node.mesh, sub_mesh, node.weights.data(), node.weights.size(), positions, normals);
+		}
+
+		template bool morph_vertices(const gltf_mesh&, const gltf_partial_mesh&, const float*, std::size_t,
+			std::vector<float>&, std::vector<float>*);
+		template bool morph_vertices(const gltf_mesh_f&, const gltf_partial_mesh_f&, const float*, std::size_t,
+			std::vector<float>&, std::vector<float>*);
+		template bool morph_vertices(const gltf_node&, const gltf_partial_mesh&, std::vector<float>&, std::vector<float>*);
+		template bool morph_vertices(const gltf_node_f&, const gltf_partial_mesh_f&, std::vector<float>&, std::vector<float>*);
+	} // namespace graphics
+} // namespace knu
@@ -0,0 +1,28 @@
+#ifndef KNU_GLTF_MORPH_HPP
+#define KNU_GLTF_MORPH_HPP
+
+#include "gltf.hpp"
+
+namespace knu
+{
+	namespace graphics
+	{
+		// morphs the POSITION, and the NORMAL when normals is given, of a primitive into xyz triples, one
+		// per vertex: the base attribute plus weights[t] times the displacement of target t. Weights past
+		// the targets are ignored and targets without a weight, or with a weight of 0, are not read at all.
+		// The weighted sums are accumulated with AVX (when the build enables it, /arch:AVX or -mavx) or SSE
+		// over ranges of vertices split across threads, normals come out normalized. Returns false when the
+		// primitive has no POSITION or is quantized
+		template <typename Real>
+		bool morph_vertices(const basic_gltf_mesh<Real>& mesh, const basic_gltf_partial_mesh<Real>& sub_mesh,
+			const float* weights, std::size_t weight_count, std::vector<float>& positions,
+			std::vector<float>* normals = nullptr);
+
+		// the node's own weights, see basic_gltf_node::weights
+		template <typename Real>
+		bool morph_vertices(const basic_gltf_node<Real>& node, const basic_gltf_partial_mesh<Real>& sub_mesh,
+			std::vector<float>& positions, std::vector<float>* normals = nullptr);
+	}
+}
+
+#endif // !KNU_GLTF_MORPH_HPP
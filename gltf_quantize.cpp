@@ -0,0 +1,396 @@
+#include "gltf_quantize.hpp"
+#include "gltf_detail.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <execution>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace knu
+{
+	namespace graphics
+	{
+		namespace
+		{
+			using vec3 = std::array<float, 3>;
+
+			enum class encoding { position, normal, tangent, texcoord, raw };
+
+			// where one attribute goes inside the interleaved vertex
+			template <typename Real>
+			struct attribute_slot
+			{
+				basic_gltf_component_info<Real>* info;
+				encoding kind;
+				std::uint32_t offset;
+				std::uint32_t size;
+			};
+
+			std::uint32_t align4(std::uint32_t size)
+			{
+				return (size + 3) & ~std::uint32_t(3);
+			}
+
+			float sign_not_zero(float v)
+			{
+				return v >= 0.0f ? 1.0f : -1.0f;
+			}
+
+			// 3 x normalized USHORT and a zero for padding, each vertex is 8 bytes at out + i * stride
+			void encode_positions(const std::vector<vec3>& positions, const vec3& offset, const vec3& scale,
+				std::uint8_t* out, std::uint32_t stride)
+			{
+				vec3 inv_scale;
+				for (int axis = 0; axis < 3; ++axis)
+					inv_scale[axis] = scale[axis] > 0.0f ? 65535.0f / scale[axis] : 0.0f;
+
+				std::size_t i = 0;
+
+#if defined(KNU_GLTF_SSE)
+				const __m128 offset4 = _mm_setr_ps(offset[0], offset[1], offset[2], 0.0f);
+				const __m128 inv_scale4 = _mm_setr_ps(inv_scale[0], inv_scale[1], inv_scale[2], 0.0f);
+				const __m128 upper = _mm_set1_ps(65535.0f);
+				const __m128 half = _mm_set1_ps(0.5f);
+				const __m128i bias = _mm_set1_epi32(32768);
+				const __m128i flip = _mm_set1_epi16(static_cast<short>(0x8000));
+
+				for (; i < positions.size(); ++i)
+				{
+					const __m128 p = _mm_setr_ps(positions[i][0], positions[i][1], positions[i][2], 0.0f);
+					__m128 q = _mm_mul_ps(_mm_sub_ps(p, offset4), inv_scale4);
+					q = _mm_min_ps(_mm_max_ps(q, _mm_setzero_ps()), upper);
+
+					// SSE2 only packs signed, so shift into the signed range and back
+					const __m128i value = _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(q, half)), bias);
+					const __m128i packed = _mm_xor_si128(_mm_packs_epi32(value, value), flip);
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(out + i * stride), packed);
+				}
+#endif
+				for (; i < positions.size(); ++i)
+				{
+					std::uint16_t q[4] = { 0, 0, 0, 0 };
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						const float v = (positions[i][axis] - offset[axis]) * inv_scale[axis];
+						q[axis] = static_cast<std::uint16_t>(std::min(std::max(v, 0.0f), 65535.0f) + 0.5f);
+					}
+					std::memcpy(out + i * stride, q, sizeof(q));
+				}
+			}
+
+			// octahedral encoding of count vectors, two values per vector in encoded
+			void encode_octahedral(const std::vector<vec3>& v, std::uint32_t bits, std::vector<std::int16_t>& encoded)
+			{
+				const float max_value = static_cast<float>((1 << (bits - 1)) - 1);
+				encoded.resize(v.size() * 2);
+
+				std::size_t i = 0;
+
+#if defined(KNU_GLTF_SSE)
+				const __m128 sign_mask = _mm_set1_ps(-0.0f);
+				const __m128 one = _mm_set1_ps(1.0f);
+				const __m128 scale = _mm_set1_ps(max_value);
+
+				for (; i + 4 <= v.size(); i += 4)
+				{
+					const __m128 x = _mm_setr_ps(v[i][0], v[i + 1][0], v[i + 2][0], v[i + 3][0]);
+					const __m128 y = _mm_setr_ps(v[i][1], v[i + 1][1], v[i + 2][1], v[i + 3][1]);
+					const __m128 z = _mm_setr_ps(v[i][2], v[i + 1][2], v[i + 2][2], v[i + 3][2]);
+
+					// project onto the octahedron |x| + |y| + |z| = 1
+					const __m128 l1 = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(sign_mask, x), _mm_andnot_ps(sign_mask, y)),
+						_mm_andnot_ps(sign_mask, z));
+					const __m128 valid = _mm_cmpgt_ps(l1, _mm_setzero_ps());
+					const __m128 inv = _mm_and_ps(valid, _mm_div_ps(one, _mm_or_ps(_mm_and_ps(valid, l1), _mm_andnot_ps(valid, one))));
+					const __m128 px = _mm_mul_ps(x, inv);
+					const __m128 py = _mm_mul_ps(y, inv);
+
+					// the lower half folds over the diagonals, keeping the signs of x and y. A zero counts as
+					// positive whatever its sign bit, as sign_not_zero does
+					const __m128 negative_x = _mm_and_ps(sign_mask, _mm_cmplt_ps(px, _mm_setzero_ps()));
+					const __m128 negative_y = _mm_and_ps(sign_mask, _mm_cmplt_ps(py, _mm_setzero_ps()));
+					const __m128 fx = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, py)), negative_x);
+					const __m128 fy = _mm_or_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, px)), negative_y);
+					const __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+					const __m128 ox = _mm_or_ps(_mm_and_ps(lower, fx), _mm_andnot_ps(lower, px));
+					const __m128 oy = _mm_or_ps(_mm_and_ps(lower, fy), _mm_andnot_ps(lower, py));
+
+					const __m128i qx = _mm_cvtps_epi32(_mm_mul_ps(ox, scale));
+					const __m128i qy = _mm_cvtps_epi32(_mm_mul_ps(oy, scale));
+					alignas(16) std::int16_t q[8];
+					_mm_store_si128(reinterpret_cast<__m128i*>(q), _mm_packs_epi32(_mm_unpacklo_epi32(qx, qy), _mm_unpackhi_epi32(qx, qy)));
+					std::copy(q, q + 8, encoded.data() + i * 2);
+				}
+#endif
+				for (; i < v.size(); ++i)
+				{
+					const std::array<std::int16_t, 2> q = graphics::encode_octahedral(v[i], bits);
+					encoded[i * 2] = q[0];
+					encoded[i * 2 + 1] = q[1];
+				}
+			}
+
+			template <typename Real>
+			void set_info(basic_gltf_component_info<Real>& info, std::uint32_t buffer_index, const attribute_slot<Real>& slot,
+				std::uint32_t stride, std::uint32_t component_type, std::uint32_t component_count)
+			{
+				info.buffer_index = buffer_index;
+				info.byte_offset = slot.offset;
+				info.byte_stride = stride;
+				info.component_type = component_type;
+				info.component_count = component_count;
+			}
+
+			template <typename Real>
+			gltf_buffer quantize(const std::vector<gltf_buffer>& buffers, basic_gltf_partial_mesh<Real>& sub_mesh,
+				std::uint32_t normal_bits, std::uint32_t buffer_index)
+			{
+				const std::uint32_t normal_size = normal_bits / 8;
+
+				// lay the vertex out, every attribute on a 4 byte boundary
+				std::vector<attribute_slot<Real>> slots;
+				std::uint32_t stride = 0;
+				std::uint32_t vertex_count = 0;
+				detail::for_each_attribute(sub_mesh, [&](basic_gltf_component_info<Real>& info)
+				{
+					const bool is_float = info.component_type == detail::GL_FLOAT;
+					const bool is_texcoord = std::any_of(std::begin(sub_mesh.texcoord_infos), std::end(sub_mesh.texcoord_infos),
+						[&info](const basic_gltf_component_info<Real>& texcoord) { return &texcoord == &info; });
+
+					attribute_slot<Real> slot{ &info, encoding::raw, stride, 0 };
+					if (is_float && &info == &sub_mesh.position_info && info.component_count >= 3)
+					{
+						slot.kind = encoding::position;
+						slot.size = 8;
+					}
+					else if (is_float && &info == &sub_mesh.normal_info && info.component_count == 3)
+					{
+						slot.kind = encoding::normal;
+						slot.size = align4(2 * normal_size);
+					}
+					else if (is_float && &info == &sub_mesh.tangent_info && info.component_count == 4)
+					{
+						slot.kind = encoding::tangent;
+						slot.size = align4(3 * normal_size);
+					}
+					else if (is_float && is_texcoord && info.component_count == 2)
+					{
+						slot.kind = encoding::texcoord;
+						slot.size = 4;
+					}
+					else
+					{
+						slot.size = align4(detail::attribute_reader{ buffers, info }.element_size());
+					}
+
+					stride += slot.size;
+					vertex_count = std::max(vertex_count, info.count);
+					slots.push_back(slot);
+				});
+
+				gltf_buffer buffer{ std::size_t(stride) * vertex_count, std::vector<std::uint8_t>(std::size_t(stride) * vertex_count) };
+				sub_mesh.quantization = gltf_quantization{};
+				sub_mesh.quantization.valid = true;
+
+				for (const attribute_slot<Real>& slot : slots)
+				{
+					basic_gltf_component_info<Real>& info = *slot.info;
+					const detail::attribute_reader reader{ buffers, info };
+					std::uint8_t* out = buffer.data.data() + slot.offset;
+
+					switch (slot.kind)
+					{
+					case encoding::position:
+					{
+						const std::vector<vec3> positions = detail::read_vec3(buffers, info);
+
+						// the accessor bounds, unless they do not hold the positions
+						vec3 lower = { static_cast<float>(info.min_bounds[0]), static_cast<float>(info.min_bounds[1]), static_cast<float>(info.min_bounds[2]) };
+						vec3 upper = { static_cast<float>(info.max_bounds[0]), static_cast<float>(info.max_bounds[1]), static_cast<float>(info.max_bounds[2]) };
+						for (const vec3& p : positions)
+							for (int axis = 0; axis < 3; ++axis)
+							{
+								lower[axis] = std::min(lower[axis], p[axis]);
+								upper[axis] = std::max(upper[axis], p[axis]);
+							}
+
+						gltf_quantization& q = sub_mesh.quantization;
+						for (int axis = 0; axis < 3; ++axis)
+						{
+							q.position_offset[axis] = lower[axis];
+							q.position_scale[axis] = upper[axis] - lower[axis];
+						}
+
+						encode_positions(positions, q.position_offset, q.position_scale, out, stride);
+						set_info(info, buffer_index, slot, stride, detail::GL_USHORT, 3);
+						break;
+					}
+
+					case encoding::normal:
+					case encoding::tangent:
+					{
+						std::vector<std::int16_t> encoded;
+						encode_octahedral(detail::read_vec3(buffers, info), normal_bits, encoded);
+
+						for (std::size_t i = 0; i < reader.size(); ++i)
+						{
+							std::uint8_t* vertex = out + i * stride;
+							std::int16_t values[3] = { encoded[i * 2], encoded[i * 2 + 1], 0 };
+							if (slot.kind == encoding::tangent)
+								values[2] = static_cast<std::int16_t>(reader.component(i, 3) < 0.0f ? -((1 << (normal_bits - 1)) - 1) : (1 << (normal_bits - 1)) - 1);
+
+							const int components = slot.kind == encoding::tangent ? 3 : 2;
+							for (int c = 0; c < components; ++c)
+							{
+								if (normal_bits == 8)
+									vertex[c] = static_cast<std::uint8_t>(static_cast<std::int8_t>(values[c]));
+								else
+									std::memcpy(vertex + c * 2, &values[c], sizeof(std::int16_t));
+							}
+						}
+
+						sub_mesh.quantization.normal_bits = normal_bits;
+						set_info(info, buffer_index, slot, stride, normal_bits == 8 ? detail::GL_BYTE : detail::GL_SHORT,
+							slot.kind == encoding::tangent ? 3 : 2);
+						break;
+					}
+
+					case encoding::texcoord:
+					{
+						std::vector<float> values(reader.size() * 2);
+						for (std::size_t i = 0; i < reader.size(); ++i)
+						{
+							values[i * 2] = reader.component(i, 0);
+							values[i * 2 + 1] = reader.component(i, 1);
+						}
+
+						std::vector<std::uint16_t> halves(values.size());
+						float_to_half(values.data(), halves.data(), values.size());
+						for (std::size_t i = 0; i < reader.size(); ++i)
+							std::memcpy(out + i * stride, halves.data() + i * 2, 4);
+
+						set_info(info, buffer_index, slot, stride, detail::GL_HALF_FLOAT, 2);
+						break;
+					}
+
+					case encoding::raw:
+					{
+						const std::uint32_t element_size = reader.element_size();
+						for (std::size_t i = 0; i < reader.size(); ++i)
+							std::memcpy(out + i * stride, reader.element(i), element_size);
+
+						set_info(info, buffer_index, slot, stride, info.component_type, info.component_count);
+						break;
+					}
+					}
+				}
+
+				return buffer;
+			}
+		}
+
+		std::array<std::int16_t, 2> encode_octahedral(const std::array<float, 3>& v, std::uint32_t bits)
+		{
+			const float max_value = static_cast<float>((1 << (bits - 1)) - 1);
+			const float l1 = std::abs(v[0]) + std::abs(v[1]) + std::abs(v[2]);
+
+			float x = l1 > 0.0f ? v[0] / l1 : 0.0f;
+			float y = l1 > 0.0f ? v[1] / l1 : 0.0f;
+			if (v[2] < 0.0f)
+			{
+				const float folded_x = (1.0f - std::abs(y)) * sign_not_zero(x);
+				y = (1.0f - std::abs(x)) * sign_not_zero(y);
+				x = folded_x;
+			}
+
+			return { static_cast<std::int16_t>(std::nearbyint(x * max_value)), static_cast<std::int16_t>(std::nearbyint(y * max_value)) };
+		}
+
+		std::array<float, 3> decode_octahedral(float x, float y)
+		{
+			std::array<float, 3> v = { x, y, 1.0f - std::abs(x) - std::abs(y) };
+			if (v[2] < 0.0f)
+			{
+				v[0] = (1.0f - std::abs(y)) * sign_not_zero(x);
+				v[1] = (1.0f - std::abs(x)) * sign_not_zero(y);
+			}
+
+			const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+			return { v[0] / length, v[1] / length, v[2] / length };
+		}
+
+		std::uint16_t float_to_half(float f)
+		{
+			std::uint32_t x;
+			std::memcpy(&x, &f, sizeof(x));
+
+			const std::uint16_t sign = static_cast<std::uint16_t>((x >> 16) & 0x8000);
+			x &= 0x7fffffff;
+
+			if (x >= 0x7f800000)
+				return sign | (x > 0x7f800000 ? 0x7e00 : 0x7c00);		// NaN stays NaN
+			if (x >= 0x477ff000)
+				return sign | 0x7c00;		// rounds past the largest half
+			if (x < 0x38800000)
+			{
+				// denormal, the default rounding mode rounds to nearest even
+				float magnitude;
+				std::memcpy(&magnitude, &x, sizeof(magnitude));
+				return sign | static_cast<std::uint16_t>(std::nearbyint(magnitude * 16777216.0f));
+			}
+
+			// rebias the exponent and round the dropped mantissa bits to nearest even
+			const std::uint32_t odd = (x >> 13) & 1;
+			x += 0xc8000fffu + odd;
+			return sign | static_cast<std::uint16_t>(x >> 13);
+		}
+
+		void float_to_half(const float* in, std::uint16_t* out, std::size_t count)
+		{
+			std::size_t i = 0;
+
+#if defined(__F16C__)
+			for (; i + 4 <= count; i += 4)
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_cvtps_ph(_mm_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+			for (; i < count; ++i)
+				out[i] = float_to_half(in[i]);
+		}
+
+		template <typename Real>
+		void quantize_vertices(basic_gltf_mesh<Real>& mesh, std::uint32_t normal_bits)
+		{
+			normal_bits = normal_bits == 8 ? 8 : 16;
+
+			// every primitive writes its own buffer slot, they are appended once all are done
+			const std::size_t first_new_buffer = mesh.buffers.size();
+			std::vector<gltf_buffer> new_buffers(mesh.sub_meshes.size());
+
+			std::vector<std::size_t> slots(mesh.sub_meshes.size());
+			for (std::size_t i = 0; i < slots.size(); ++i)
+				slots[i] = i;
+
+			std::for_each(std::execution::par, std::begin(slots), std::end(slots), [&](std::size_t slot)
+			{
+				basic_gltf_partial_mesh<Real>& sub_mesh = mesh.sub_meshes[slot];
+				if (sub_mesh.quantization.valid || !sub_mesh.position_info.valid)
+					return;
+
+				new_buffers[slot] = quantize(mesh.buffers, sub_mesh, normal_bits,
+					static_cast<std::uint32_t>(first_new_buffer + slot));
+			});
+
+			// skipped primitives leave an empty buffer behind, which the clean up removes
+			for (std::size_t slot = 0; slot < new_buffers.size(); ++slot)
+				mesh.buffers.emplace_back(std::move(new_buffers[slot]));
+
+			detail::remove_unused_buffers(mesh);
+		}
+
+		template void quantize_vertices(gltf_mesh&, std::uint32_t);
+		template void quantize_vertices(gltf_mesh_f&, std::uint32_t);
+	} // namespace graphics
+} // namespace knu
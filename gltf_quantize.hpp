@@ -0,0 +1,33 @@
+#ifndef KNU_GLTF_QUANTIZE_HPP
+#define KNU_GLTF_QUANTIZE_HPP
+
+#include "gltf.hpp"
+
+namespace knu
+{
+	namespace graphics
+	{
+		// octahedral encoding of a unit vector into two signed values of bits bits (8 or 16)
+		std::array<std::int16_t, 2> encode_octahedral(const std::array<float, 3>& v, std::uint32_t bits);
+
+		// the unit vector back from encode_octahedral, components normalized to [-1, 1]
+		std::array<float, 3> decode_octahedral(float x, float y);
+
+		// float to IEEE half, rounding to nearest even. Uses F16C for a whole array where available
+		std::uint16_t float_to_half(float f);
+		void float_to_half(const float* in, std::uint16_t* out, std::size_t count);
+
+		// rewrites the vertices of every primitive into one interleaved buffer of its own, every
+		// attribute 4 byte aligned:
+		//   POSITION (float)		3 x normalized USHORT against the accessor bounds, 8 bytes
+		//   NORMAL (float)			2 x octahedral BYTE or SHORT, 4 bytes
+		//   TANGENT (float)		2 x octahedral and the bitangent sign, 4 or 8 bytes
+		//   TEXCOORD_n (float)		2 x GL_HALF_FLOAT, 4 bytes
+		// and everything else copied as it is. The primitive's quantization says how to decode, the
+		// position bounds stay in model space. Primitives run in parallel
+		template <typename Real>
+		void quantize_vertices(basic_gltf_mesh<Real>& mesh, std::uint32_t normal_bits = 16);
+	}
+}
+
+#endif // !KNU_GLTF_QUANTIZE_HPP
@@ -0,0 +1,151 @@
+#include "gltf_skin.hpp"
+#include "gltf_detail.hpp"
+#include <algorithm>
+#include <cmath>
+#include <execution>
+
+namespace knu
+{
+	namespace graphics
+	{
+		namespace
+		{
+			// vertices per task, large enough that the threads are not busy with scheduling
+			const std::size_t skinning_range = 4096;
+
+			// the blend of up to four palette matrices by weight, column major
+			void blend_matrix(const std::vector<std::array<float, 16>>& palette, const std::uint32_t* joints,
+				const float* weights, float* out)
+			{
+#if defined(KNU_GLTF_SSE)
+				__m128 columns[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+				for (int i = 0; i < 4; ++i)
+				{
+					if (weights[i] == 0.0f || joints[i] >= palette.size())
+						continue;
+
+					const __m128 weight = _mm_set1_ps(weights[i]);
+					const float* m = palette[joints[i]].data();
+					for (int c = 0; c < 4; ++c)
+						columns[c] = _mm_add_ps(columns[c], _mm_mul_ps(weight, _mm_loadu_ps(m + c * 4)));
+				}
+
+				for (int c = 0; c < 4; ++c)
+					_mm_storeu_ps(out + c * 4, columns[c]);
+#else
+				std::fill(out, out + 16, 0.0f);
+				for (int i = 0; i < 4; ++i)
+				{
+					if (weights[i] == 0.0f || joints[i] >= palette.size())
+						continue;
+
+					const float* m = palette[joints[i]].data();
+					for (int e = 0; e < 16; ++e)
+						out[e] += weights[i] * m[e];
+				}
+#endif
+			}
+
+			// m * (v, w), the xyz of the result
+			void transform(const float* m, const std::array<float, 3>& v, float w, float* out)
+			{
+#if defined(KNU_GLTF_SSE)
+				__m128 r = _mm_mul_ps(_mm_loadu_ps(m), _mm_set1_ps(v[0]));
+				r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(v[1])));
+				r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(v[2])));
+				r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 12), _mm_set1_ps(w)));
+
+				float result[4];
+				_mm_storeu_ps(result, r);
+				std::copy(result, result + 3, out);
+#else
+				for (int row = 0; row < 3; ++row)
+					out[row] = m[row] * v[0] + m[4 + row] * v[1] + m[8 + row] * v[2] + m[12 + row] * w;
+#endif
+			}
+		}
+
+		std::vector<std::array<float, 16>> compute_joint_palette(const gltf_skin& skin,
+			const std::vector<std::array<double, 16>>& world)
+		{
+			std::vector<std::array<float, 16>> palette(skin.joints.size());
+			for (std::size_t j = 0; j < skin.joints.size(); ++j)
+			{
+				detail::mat4 inverse_bind = detail::identity_matrix();
+				if (j < skin.inverse_bind_matrices.size())
+					std::copy(std::begin(skin.inverse_bind_matrices[j]), std::end(skin.inverse_bind_matrices[j]),
+						std::begin(inverse_bind));
+
+				const detail::mat4 joint_matrix = detail::multiply(world.at(skin.joints[j]), inverse_bind);
+				std::transform(std::begin(joint_matrix), std::end(joint_matrix), std::begin(palette[j]),
+					[](double v) { return static_cast<float>(v); });
+			}
+
+			return palette;
+		}
+
+		template <typename Real>
+		bool skin_vertices(const basic_gltf_mesh<Real>& mesh, const basic_gltf_partial_mesh<Real>& sub_mesh,
+			const std::vector<std::array<float, 16>>& palette, std::vector<float>& positions,
+			std::vector<float>* normals)
+		{
+			const basic_gltf_component_info<Real>* joints_info = detail::find_attribute(sub_mesh, gltf_semantics::joints_0);
+			const basic_gltf_component_info<Real>* weights_info = detail::find_attribute(sub_mesh, gltf_semantics::weights_0);
+			if (!sub_mesh.position_info.valid || joints_info == nullptr || weights_info == nullptr)
+				return false;
+
+			const detail::attribute_reader position_reader{ mesh.buffers, sub_mesh.position_info };
+			const detail::attribute_reader joint_reader{ mesh.buffers, *joints_info };
+			const detail::attribute_reader weight_reader{ mesh.buffers, *weights_info };
+			const bool skin_normals = normals != nullptr && sub_mesh.normal_info.valid;
+			const detail::attribute_reader normal_reader = skin_normals ? detail::attribute_reader{ mesh.buffers, sub_mesh.normal_info }
+				: position_reader;
+
+			const std::size_t vertex_count = std::min<std::size_t>({ position_reader.size(), joint_reader.size(), weight_reader.size() });
+			positions.assign(vertex_count * 3, 0.0f);
+			if (normals != nullptr)
+				normals->assign(skin_normals ? vertex_count * 3 : 0, 0.0f);
+
+			std::vector<std::size_t> ranges;
+			for (std::size_t first = 0; first < vertex_count; first += skinning_range)
+				ranges.push_back(first);
+
+			std::for_each(std::execution::par, std::begin(ranges), std::end(ranges), [&](std::size_t first)
+			{
+				const std::size_t last = std::min(first + skinning_range, vertex_count);
+				for (std::size_t i = first; i < last; ++i)
+				{
+					std::uint32_t joints[4] = { 0, 0, 0, 0 };
+					float weights[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+					for (std::uint32_t k = 0; k < 4 && k < joint_reader.components(); ++k)
+					{
+						joints[k] = joint_reader.integer(i, k);
+						weights[k] = weight_reader.component(i, k);
+					}
+
+					float m[16];
+					blend_matrix(palette, joints, weights, m);
+					transform(m, position_reader.vec3(i), 1.0f, positions.data() + i * 3);
+
+					if (skin_normals)
+					{
+						// the blended matrix is close enough to a rotation and uniform scale for normals
+						float* n = normals->data() + i * 3;
+						transform(m, normal_reader.vec3(i), 0.0f, n);
+						const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+						if (length > 0.0f)
+							for (int c = 0; c < 3; ++c)
+								n[c] /= length;
+					}
+				}
+			});
+
+			return true;
+		}
+
+		template bool skin_vertices(const gltf_mesh&, const gltf_partial_mesh&, const std::vector<std::array<float, 16>>&,
+			std::vector<float>&, std::vector<float>*);
+		template bool skin_vertices(const gltf_mesh_f&, const gltf_partial_mesh_f&, const std::vector<std::array<float, 16>>&,
+			std::vector<float>&, std::vector<float>*);
+	} // namespace graphics
+} // namespace knu
@@ -0,0 +1,33 @@
+#ifndef KNU_GLTF_SKIN_HPP
+#define KNU_GLTF_SKIN_HPP
+
+#include "gltf.hpp"
+
+namespace knu
+{
+	namespace graphics
+	{
+		struct gltf_skin
+		{
+			std::string name;
+			std::vector<std::uint32_t> joints;			// gltf node indices, JOINTS_0 values index this
+			std::vector<std::array<float, 16>> inverse_bind_matrices;	// column major, identity when the file has none
+			int skeleton = -1;							// the common root node, -1 when not given
+		};
+
+		// palette[j] = world[joints[j]] * inverse_bind_matrices[j], world as from gltf::world_transforms.
+		// Skinned positions come out in world space, the transform of the skinned node itself does not apply
+		std::vector<std::array<float, 16>> compute_joint_palette(const gltf_skin& skin,
+			const std::vector<std::array<double, 16>>& world);
+
+		// skins the POSITION, and the NORMAL when normals is given, of a primitive with JOINTS_0 and WEIGHTS_0
+		// into xyz triples, one per vertex. Four influences are blended per vertex with SSE and the vertices
+		// are split across threads in ranges. Returns false when the primitive has no skinning attributes
+		template <typename Real>
+		bool skin_vertices(const basic_gltf_mesh<Real>& mesh, const basic_gltf_partial_mesh<Real>& sub_mesh,
+			const std::vector<std::array<float, 16>>& palette, std::vector<float>& positions,
+			std::vector<float>* normals = nullptr);
+	}
+}
+
+#endif // !KNU_GLTF_SKIN_HPP
@@ -0,0 +1,108 @@
+#include "gltf_upload.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace knu
+{
+	namespace graphics
+	{
+		gltf_upload_plan plan_uploads(const std::vector<gltf_buffer_view_range>& views,
+			std::size_t gap_threshold, std::size_t alignment)
+		{
+			alignment = std::max<std::size_t>(alignment, 1);
+
+			gltf_upload_plan plan;
+			plan.view_offsets.assign(views.size(), gltf_upload_plan::not_uploaded);
+
+			for (std::uint32_t target : { gltf_targets::array_buffer, gltf_targets::element_array_buffer })
+			{
+				std::vector<std::size_t> order;
+				for (std::size_t i = 0; i < views.size(); ++i)
+				{
+					if (views[i].referenced && views[i].target == target && views[i].byte_length > 0)
+						order.push_back(i);
+				}
+
+				std::sort(std::begin(order), std::end(order), [&views](std::size_t a, std::size_t b)
+				{
+					return std::make_pair(views[a].buffer_index, views[a].byte_offset)
+						< std::make_pair(views[b].buffer_index, views[b].byte_offset);
+				});
+
+				std::size_t& total = target == gltf_targets::array_buffer ? plan.array_buffer_bytes
+					: plan.element_array_buffer_bytes;
+
+				// a sweep over the sorted views, a view that starts past the range end plus the gap
+				// closes the range
+				for (std::size_t first = 0; first < order.size();)
+				{
+					const gltf_buffer_view_range& head = views[order[first]];
+					std::size_t end = head.byte_offset + head.byte_length;
+
+					std::size_t last = first + 1;
+					for (; last < order.size(); ++last)
+					{
+						const gltf_buffer_view_range& view = views[order[last]];
+						if (view.buffer_index != head.buffer_index || view.byte_offset > end + gap_threshold)
+							break;
+
+						end = std::max(end, view.byte_offset + view.byte_length);
+					}
+
+					gltf_upload_range range;
+					range.target = target;
+					range.buffer_index = head.buffer_index;
+					range.source_offset = head.byte_offset;
+					range.byte_length = end - head.byte_offset;
+					range.destination_offset = (total + alignment - 1) / alignment * alignment + head.byte_offset % alignment;
+
+					for (std::size_t i = first; i < last; ++i)
+						plan.view_offsets[order[i]] = range.destination_offset + (views[order[i]].byte_offset - range.source_offset);
+
+					total = range.destination_offset + range.byte_length;
+					plan.ranges.push_back(range);
+					first = last;
+				}
+			}
+
+			return plan;
+		}
+
+		std::size_t upload_offset(const gltf_upload_plan& plan, std::uint32_t target, std::uint32_t buffer_index,
+			std::size_t byte_offset)
+		{
+			// the ranges of a target are sorted by buffer and offset, the last one starting at or before it
+			auto first = std::find_if(std::begin(plan.ranges), std::end(plan.ranges),
+				[target](const gltf_upload_range& r) { return r.target == target; });
+			auto last = std::find_if(first, std::end(plan.ranges),
+				[target](const gltf_upload_range& r) { return r.target != target; });
+
+			auto iter = std::upper_bound(first, last, std::make_pair(buffer_index, byte_offset),
+				[](const std::pair<std::uint32_t, std::size_t>& value, const gltf_upload_range& r)
+			{
+				return value < std::make_pair(r.buffer_index, r.source_offset);
+			});
+
+			if (iter == first)
+				return gltf_upload_plan::not_uploaded;
+
+			--iter;
+			if (iter->buffer_index != buffer_index || byte_offset >= iter->source_offset + iter->byte_length)
+				return gltf_upload_plan::not_uploaded;
+
+			return iter->destination_offset + (byte_offset - iter->source_offset);
+		}
+
+		void copy_uploads(const gltf_upload_plan& plan, const std::vector<gltf_buffer>& buffers,
+			std::uint32_t target, void* destination)
+		{
+			std::uint8_t* out = static_cast<std::uint8_t*>(destination);
+			for (const gltf_upload_range& range : plan.ranges)
+			{
+				if (range.target == target)
+					std::memcpy(out + range.destination_offset, buffers[range.buffer_index].data.data() + range.source_offset,
+						range.byte_length);
+			}
+		}
+	} // namespace graphics
+} // namespace knu
@@ -0,0 +1,64 @@
+#ifndef KNU_GLTF_UPLOAD_HPP
+#define KNU_GLTF_UPLOAD_HPP
+
+#include "gltf.hpp"
+
+namespace knu
+{
+	namespace graphics
+	{
+		// the gltf bufferView targets, the GL buffer binding each one is uploaded to
+		namespace gltf_targets
+		{
+			constexpr std::uint32_t array_buffer = 34962;
+			constexpr std::uint32_t element_array_buffer = 34963;
+		}
+
+		// one bufferView as the planner sees it
+		struct gltf_buffer_view_range
+		{
+			std::uint32_t buffer_index;
+			std::size_t byte_offset;
+			std::size_t byte_length;
+			std::uint32_t target;		// gltf_targets, from the file or from what the accessors use it for
+			bool referenced;			// used by a mesh primitive, the others are not uploaded
+		};
+
+		// one memcpy from a buffer into the staging buffer of a target
+		struct gltf_upload_range
+		{
+			std::uint32_t target;
+			std::uint32_t buffer_index;
+			std::size_t source_offset;
+			std::size_t destination_offset;
+			std::size_t byte_length;
+		};
+
+		struct gltf_upload_plan
+		{
+			static constexpr std::size_t not_uploaded = ~std::size_t(0);
+
+			std::vector<gltf_upload_range> ranges;		// by target, then buffer and offset
+			std::vector<std::size_t> view_offsets;		// where each view lands in its target's staging buffer
+			std::size_t array_buffer_bytes = 0;			// staging buffer sizes
+			std::size_t element_array_buffer_bytes = 0;
+		};
+
+		// groups the referenced views by target and joins the ones in the same buffer that overlap or are at
+		// most gap_threshold bytes apart, the gaps are copied along. Ranges start at a multiple of alignment
+		// plus their source offset modulo alignment, so the data keeps the alignment it had in the buffer
+		gltf_upload_plan plan_uploads(const std::vector<gltf_buffer_view_range>& views,
+			std::size_t gap_threshold = 256, std::size_t alignment = 16);
+
+		// where a byte of a buffer lands in the target's staging buffer, for the byte_offset of a
+		// gltf_component_info say, or not_uploaded
+		std::size_t upload_offset(const gltf_upload_plan& plan, std::uint32_t target, std::uint32_t buffer_index,
+			std::size_t byte_offset);
+
+		// copies the ranges of the target out of the buffers, destination holds the target's staging size
+		void copy_uploads(const gltf_upload_plan& plan, const std::vector<gltf_buffer>& buffers,
+			std::uint32_t target, void* destination);
+	}
+}
+
+#endif // !KNU_GLTF_UPLOAD_HPP
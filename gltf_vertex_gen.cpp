@@ -0,0 +1,529 @@
+#include "gltf_vertex_gen.hpp"
+#include "gltf_detail.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <execution>
+#include <limits>
+
+namespace knu
+{
+	namespace graphics
+	{
+		namespace
+		{
+			using vec2 = std::array<float, 2>;
+			using vec3 = std::array<float, 3>;
+			using vec4 = std::array<float, 4>;
+
+			const std::uint32_t triangles_mode = 4;
+
+			// triangles per parallel task, a multiple of 4
+			const std::size_t block_size = 1024;
+
+			// structure of arrays vectors, padded to a multiple of 4 so SSE never needs a tail
+			struct vec3_array
+			{
+				explicit vec3_array(std::size_t count) :
+					x((count + 3) & ~std::size_t(3), 0.0f),
+					y((count + 3) & ~std::size_t(3), 0.0f),
+					z((count + 3) & ~std::size_t(3), 0.0f)
+				{}
+
+				std::vector<float> x;
+				std::vector<float> y;
+				std::vector<float> z;
+			};
+
+			std::vector<std::size_t> blocks(std::size_t count)
+			{
+				std::vector<std::size_t> firsts;
+				for (std::size_t first = 0; first < count; first += block_size)
+					firsts.push_back(first);
+
+				return firsts;
+			}
+
+			// the cross products of every triangle's edges, twice the area long
+			void face_normals(const std::vector<std::uint32_t>& indices, const std::vector<vec3>& positions, vec3_array& faces)
+			{
+				const std::size_t triangle_count = indices.size() / 3;
+				const std::vector<std::size_t> firsts = blocks(triangle_count);
+
+				std::for_each(std::execution::par, std::begin(firsts), std::end(firsts), [&](std::size_t first)
+				{
+					const std::size_t last = std::min(first + block_size, triangle_count);
+					std::size_t t = first;
+
+#if defined(KNU_GLTF_SSE)
+					for (; t + 4 <= last; t += 4)
+					{
+						const std::uint32_t* tri = indices.data() + t * 3;
+						__m128 p[3][3];
+						for (int corner = 0; corner < 3; ++corner)
+							for (int axis = 0; axis < 3; ++axis)
+								p[corner][axis] = _mm_setr_ps(positions[tri[corner]][axis], positions[tri[3 + corner]][axis],
+									positions[tri[6 + corner]][axis], positions[tri[9 + corner]][axis]);
+
+						const __m128 e1x = _mm_sub_ps(p[1][0], p[0][0]), e1y = _mm_sub_ps(p[1][1], p[0][1]), e1z = _mm_sub_ps(p[1][2], p[0][2]);
+						const __m128 e2x = _mm_sub_ps(p[2][0], p[0][0]), e2y = _mm_sub_ps(p[2][1], p[0][1]), e2z = _mm_sub_ps(p[2][2], p[0][2]);
+
+						_mm_storeu_ps(faces.x.data() + t, _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y)));
+						_mm_storeu_ps(faces.y.data() + t, _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z)));
+						_mm_storeu_ps(faces.z.data() + t, _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x)));
+					}
+#endif
+					for (; t < last; ++t)
+					{
+						const vec3& p0 = positions[indices[t * 3]];
+						const vec3& p1 = positions[indices[t * 3 + 1]];
+						const vec3& p2 = positions[indices[t * 3 + 2]];
+						const vec3 e1 = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+						const vec3 e2 = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+						faces.x[t] = e1[1] * e2[2] - e1[2] * e2[1];
+						faces.y[t] = e1[2] * e2[0] - e1[0] * e2[2];
+						faces.z[t] = e1[0] * e2[1] - e1[1] * e2[0];
+					}
+				});
+			}
+
+			// the weight of every corner for angle weighting, the angle divided by the length of the
+			// face normal so the sum ends up weighted by angle alone
+			std::vector<float> corner_angles(const std::vector<std::uint32_t>& indices, const std::vector<vec3>& positions,
+				const vec3_array& faces)
+			{
+				std::vector<float> weights(indices.size(), 0.0f);
+				const std::vector<std::size_t> firsts = blocks(indices.size() / 3);
+
+				std::for_each(std::execution::par, std::begin(firsts), std::end(firsts), [&](std::size_t first)
+				{
+					const std::size_t last = std::min(first + block_size, indices.size() / 3);
+					for (std::size_t t = first; t < last; ++t)
+					{
+						const float length = std::sqrt(faces.x[t] * faces.x[t] + faces.y[t] * faces.y[t] + faces.z[t] * faces.z[t]);
+						if (length <= 0.0f)
+							continue;
+
+						for (int c = 0; c < 3; ++c)
+						{
+							const vec3& p = positions[indices[t * 3 + c]];
+							const vec3& a = positions[indices[t * 3 + (c + 1) % 3]];
+							const vec3& b = positions[indices[t * 3 + (c + 2) % 3]];
+							const vec3 ea = { a[0] - p[0], a[1] - p[1], a[2] - p[2] };
+							const vec3 eb = { b[0] - p[0], b[1] - p[1], b[2] - p[2] };
+
+							const float lengths = std::sqrt((ea[0] * ea[0] + ea[1] * ea[1] + ea[2] * ea[2])
+								* (eb[0] * eb[0] + eb[1] * eb[1] + eb[2] * eb[2]));
+							if (lengths <= 0.0f)
+								continue;
+
+							const float cosine = (ea[0] * eb[0] + ea[1] * eb[1] + ea[2] * eb[2]) / lengths;
+							weights[t * 3 + c] = std::acos(std::max(-1.0f, std::min(1.0f, cosine))) / length;
+						}
+					}
+				});
+
+				return weights;
+			}
+
+			// normalizes in place, zero vectors become +z
+			void normalize(vec3_array& v)
+			{
+				const std::vector<std::size_t> firsts = blocks(v.x.size());
+
+				std::for_each(std::execution::par, std::begin(firsts), std::end(firsts), [&v](std::size_t first)
+				{
+					const std::size_t last = std::min(first + block_size, v.x.size());
+					std::size_t i = first;
+
+#if defined(KNU_GLTF_SSE)
+					const __m128 zero = _mm_setzero_ps();
+					const __m128 one = _mm_set1_ps(1.0f);
+					for (; i + 4 <= last; i += 4)
+					{
+						const __m128 x = _mm_loadu_ps(v.x.data() + i);
+						const __m128 y = _mm_loadu_ps(v.y.data() + i);
+						const __m128 z = _mm_loadu_ps(v.z.data() + i);
+
+						const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+						const __m128 degenerate = _mm_cmple_ps(length, zero);
+						const __m128 inv = _mm_div_ps(one, _mm_or_ps(_mm_and_ps(degenerate, one), _mm_andnot_ps(degenerate, length)));
+
+						_mm_storeu_ps(v.x.data() + i, _mm_andnot_ps(degenerate, _mm_mul_ps(x, inv)));
+						_mm_storeu_ps(v.y.data() + i, _mm_andnot_ps(degenerate, _mm_mul_ps(y, inv)));
+						_mm_storeu_ps(v.z.data() + i, _mm_or_ps(_mm_and_ps(degenerate, one), _mm_andnot_ps(degenerate, _mm_mul_ps(z, inv))));
+					}
+#endif
+					for (; i < last; ++i)
+					{
+						const float length = std::sqrt(v.x[i] * v.x[i] + v.y[i] * v.y[i] + v.z[i] * v.z[i]);
+						if (length <= 0.0f)
+						{
+							v.x[i] = 0.0f; v.y[i] = 0.0f; v.z[i] = 1.0f;
+							continue;
+						}
+
+						v.x[i] /= length; v.y[i] /= length; v.z[i] /= length;
+					}
+				});
+			}
+
+			std::vector<vec3> vertex_normals(const std::vector<std::uint32_t>& indices, const std::vector<vec3>& positions,
+				gltf_normal_generation weighting)
+			{
+				const std::size_t vertex_count = positions.size();
+
+				vec3_array faces{ indices.size() / 3 };
+				face_normals(indices, positions, faces);
+
+				std::vector<float> weights;
+				if (weighting == gltf_normal_generation::angle_weighted)
+					weights = corner_angles(indices, positions, faces);
+
+				// flat sums per vertex, smooth per position so seams do not show
+				std::vector<std::uint32_t> group;
+				if (weighting == gltf_normal_generation::flat)
+				{
+					group.resize(vertex_count);
+					for (std::uint32_t v = 0; v < vertex_count; ++v)
+						group[v] = v;
+				}
+				else
+				{
+					group = detail::position_ids(positions);
+				}
+
+				// the corners of every group, so each group gathers its own sum and no two tasks write the same vertex
+				std::vector<std::uint32_t> offsets(vertex_count + 1, 0);
+				for (std::uint32_t v : indices)
+					++offsets[group[v] + 1];
+				for (std::size_t g = 0; g < vertex_count; ++g)
+					offsets[g + 1] += offsets[g];
+
+				std::vector<std::uint32_t> corners(indices.size());
+				{
+					std::vector<std::uint32_t> fill(std::begin(offsets), std::end(offsets) - 1);
+					for (std::uint32_t i = 0; i < indices.size(); ++i)
+						corners[fill[group[indices[i]]]++] = i;
+				}
+
+				vec3_array sums{ vertex_count };
+				const std::vector<std::size_t> firsts = blocks(vertex_count);
+				std::for_each(std::execution::par, std::begin(firsts), std::end(firsts), [&](std::size_t first)
+				{
+					const std::size_t last = std::min(first + block_size, vertex_count);
+					for (std::size_t g = first; g < last; ++g)
+					{
+						float x = 0.0f, y = 0.0f, z = 0.0f;
+						for (std::uint32_t i = offsets[g]; i < offsets[g + 1]; ++i)
+						{
+							const std::uint32_t corner = corners[i];
+							const std::uint32_t t = corner / 3;
+							const float weight = weights.empty() ? 1.0f : weights[corner];
+							x += faces.x[t] * weight;
+							y += faces.y[t] * weight;
+							z += faces.z[t] * weight;
+						}
+
+						sums.x[g] = x;
+						sums.y[g] = y;
+						sums.z[g] = z;
+					}
+				});
+
+				normalize(sums);
+
+				std::vector<vec3> normals(vertex_count);
+				for (std::size_t v = 0; v < vertex_count; ++v)
+					normals[v] = { sums.x[group[v]], sums.y[group[v]], sums.z[group[v]] };
+
+				return normals;
+			}
+
+			// the tangent of every vertex from the triangles around it, the MikkTSpace way: each corner
+			// contributes the triangle's texture space tangent projected into the plane of the corner's normal,
+			// weighted by the corner's angle in that plane. The bitangent sign follows the texture winding
+			std::vector<vec4> vertex_tangents(const std::vector<std::uint32_t>& indices, const std::vector<vec3>& positions,
+				const std::vector<vec3>& normals, const std::vector<vec2>& texcoords)
+			{
+				const std::size_t vertex_count = positions.size();
+				const std::size_t triangle_count = indices.size() / 3;
+
+				auto dot = [](const vec3& a, const vec3& b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; };
+				auto project = [&dot](const vec3& v, const vec3& n)
+				{
+					const float d = dot(v, n);
+					vec3 p = { v[0] - n[0] * d, v[1] - n[1] * d, v[2] - n[2] * d };
+					const float length = std::sqrt(dot(p, p));
+					if (length > 0.0f)
+						p = { p[0] / length, p[1] / length, p[2] / length };
+					return p;
+				};
+
+				// every corner's weighted tangent, negative weights for mirrored texture space
+				std::vector<vec3> corner_tangents(indices.size(), vec3{ 0, 0, 0 });
+				std::vector<float> corner_weights(indices.size(), 0.0f);
+
+				const std::vector<std::size_t> firsts = blocks(triangle_count);
+				std::for_each(std::execution::par, std::begin(firsts), std::end(firsts), [&](std::size_t first)
+				{
+					const std::size_t last = std::min(first + block_size, triangle_count);
+					for (std::size_t t = first; t < last; ++t)
+					{
+						const std::uint32_t* tri = indices.data() + t * 3;
+						const vec3& p1 = positions[tri[0]];
+						const vec3& p2 = positions[tri[1]];
+						const vec3& p3 = positions[tri[2]];
+						const vec2& t1 = texcoords[tri[0]];
+						const vec2& t2 = texcoords[tri[1]];
+						const vec2& t3 = texcoords[tri[2]];
+
+						const vec3 d1 = { p2[0] - p1[0], p2[1] - p1[1], p2[2] - p1[2] };
+						const vec3 d2 = { p3[0] - p1[0], p3[1] - p1[1], p3[2] - p1[2] };
+						const float t21x = t2[0] - t1[0], t21y = t2[1] - t1[1];
+						const float t31x = t3[0] - t1[0], t31y = t3[1] - t1[1];
+
+						const float signed_area = t21x * t31y - t21y * t31x;
+						if (signed_area == 0.0f)
+							continue;		// no texture space to follow, the neighbours decide
+
+						// dP/du scaled by the signed texture area, the sign is taken back out
+						const float orientation = signed_area > 0.0f ? 1.0f : -1.0f;
+						const vec3 os = { (t31y * d1[0] - t21y * d2[0]) * orientation, (t31y * d1[1] - t21y * d2[1]) * orientation,
+							(t31y * d1[2] - t21y * d2[2]) * orientation };
+
+						for (int c = 0; c < 3; ++c)
+						{
+							const vec3& n = normals[tri[c]];
+							const vec3& p = positions[tri[c]];
+							const vec3& a = positions[tri[(c + 1) % 3]];
+							const vec3& b = positions[tri[(c + 2) % 3]];
+
+							const vec3 ea = project({ a[0] - p[0], a[1] - p[1], a[2] - p[2] }, n);
+							const vec3 eb = project({ b[0] - p[0], b[1] - p[1], b[2] - p[2] }, n);
+							const float angle = std::acos(std::max(-1.0f, std::min(1.0f, dot(ea, eb))));
+
+							const vec3 tangent = project(os, n);
+							corner_tangents[t * 3 + c] = { tangent[0] * angle, tangent[1] * angle, tangent[2] * angle };
+							corner_weights[t * 3 + c] = angle * orientation;
+						}
+					}
+				});
+
+				// the corners of every vertex, so each vertex gathers its own sum
+				std::vector<std::uint32_t> offsets(vertex_count + 1, 0);
+				for (std::uint32_t v : indices)
+					++offsets[v + 1];
+				for (std::size_t v = 0; v < vertex_count; ++v)
+					offsets[v + 1] += offsets[v];
+
+				std::vector<std::uint32_t> corners(indices.size());
+				{
+					std::vector<std::uint32_t> fill(std::begin(offsets), std::end(offsets) - 1);
+					for (std::uint32_t i = 0; i < indices.size(); ++i)
+						corners[fill[indices[i]]++] = i;
+				}
+
+				std::vector<vec4> tangents(vertex_count);
+				const std::vector<std::size_t> vertex_firsts = blocks(vertex_count);
+				std::for_each(std::execution::par, std::begin(vertex_firsts), std::end(vertex_firsts), [&](std::size_t first)
+				{
+					const std::size_t last = std::min(first + block_size, vertex_count);
+					for (std::size_t v = first; v < last; ++v)
+					{
+						// MikkTSpace splits a vertex used by mirrored and unmirrored triangles, a shared
+						// vertex can only have one tangent so the side with more weight wins
+						vec3 sum[2] = { { 0, 0, 0 }, { 0, 0, 0 } };
+						float weight[2] = { 0.0f, 0.0f };
+						for (std::uint32_t i = offsets[v]; i < offsets[v + 1]; ++i)
+						{
+							const std::uint32_t corner = corners[i];
+							const int side = corner_weights[corner] < 0.0f ? 1 : 0;
+							weight[side] += std::abs(corner_weights[corner]);
+							for (int c = 0; c < 3; ++c)
+								sum[side][c] += corner_tangents[corner][c];
+						}
+
+						const int side = weight[1] > weight[0] ? 1 : 0;
+						vec3 tangent = project(sum[side], normals[v]);
+
+						// nothing to go by, any direction in the normal's plane will do
+						if (dot(tangent, tangent) == 0.0f)
+						{
+							const vec3& n = normals[v];
+							tangent = project(std::abs(n[0]) < 0.9f ? vec3{ 1, 0, 0 } : vec3{ 0, 1, 0 }, n);
+						}
+
+						tangents[v] = { tangent[0], tangent[1], tangent[2], side == 0 ? 1.0f : -1.0f };
+					}
+				});
+
+				return tangents;
+			}
+
+			// the triangle list of a TRIANGLES primitive, a primitive without indices draws its vertices in order
+			template <typename Real>
+			std::vector<std::uint32_t> triangle_list(const basic_gltf_partial_mesh<Real>& sub_mesh, std::size_t vertex_count)
+			{
+				std::vector<std::uint32_t> indices(std::begin(sub_mesh.indices), std::end(sub_mesh.indices));
+				if (indices.empty())
+				{
+					indices.resize(vertex_count / 3 * 3);
+					for (std::uint32_t i = 0; i < indices.size(); ++i)
+						indices[i] = i;
+				}
+
+				return indices;
+			}
+
+			// runs make_values on every primitive in parallel. A primitive it returns an attribute for gets
+			// the values it filled in as that attribute, tightly packed floats in a buffer of its own
+			template <typename Real, std::size_t N, typename Fn>
+			void add_float_attribute(basic_gltf_mesh<Real>& mesh, Fn make_values)
+			{
+				// every primitive writes its own buffer slot, they are appended once all are done
+				const std::size_t first_new_buffer = mesh.buffers.size();
+				std::vector<gltf_buffer> new_buffers(mesh.sub_meshes.size());
+
+				std::vector<std::size_t> slots(mesh.sub_meshes.size());
+				for (std::size_t i = 0; i < slots.size(); ++i)
+					slots[i] = i;
+
+				std::for_each(std::execution::par, std::begin(slots), std::end(slots), [&](std::size_t slot)
+				{
+					std::vector<std::array<float, N>> values;
+					basic_gltf_component_info<Real>* info = make_values(mesh.sub_meshes[slot], values);
+					if (!info)
+						return;
+
+					gltf_buffer& buffer = new_buffers[slot];
+					buffer.byte_length = values.size() * sizeof(std::array<float, N>);
+					buffer.data.resize(buffer.byte_length);
+					std::memcpy(buffer.data.data(), values.data(), buffer.byte_length);
+
+					info->valid = true;
+					info->buffer_index = static_cast<std::uint32_t>(first_new_buffer + slot);
+					info->byte_offset = 0;
+					info->component_type = detail::GL_FLOAT;
+					info->component_count = static_cast<std::uint32_t>(N);
+					info->byte_stride = 0;
+					info->count = static_cast<std::uint32_t>(values.size());
+
+					const std::size_t components = std::min<std::size_t>(N, 3);
+					for (std::size_t c = 0; c < components; ++c)
+					{
+						info->min_bounds[c] = std::numeric_limits<Real>::max();
+						info->max_bounds[c] = std::numeric_limits<Real>::lowest();
+					}
+
+					for (const auto& value : values)
+						for (std::size_t c = 0; c < components; ++c)
+						{
+							info->min_bounds[c] = std::min(info->min_bounds[c], static_cast<Real>(value[c]));
+							info->max_bounds[c] = std::max(info->max_bounds[c], static_cast<Real>(value[c]));
+						}
+				});
+
+				// primitives that were skipped leave an empty buffer behind, which the clean up removes
+				for (std::size_t slot = 0; slot < new_buffers.size(); ++slot)
+					mesh.buffers.emplace_back(std::move(new_buffers[slot]));
+
+				detail::remove_unused_buffers(mesh);
+			}
+		}
+
+		std::vector<std::array<float, 3>> generate_normals(const std::vector<std::uint16_t>& indices,
+			const std::vector<std::array<float, 3>>& positions, gltf_normal_generation weighting)
+		{
+			return vertex_normals(std::vector<std::uint32_t>(std::begin(indices), std::end(indices)), positions, weighting);
+		}
+
+		template <typename Real>
+		void generate_normals(basic_gltf_mesh<Real>& mesh, gltf_normal_generation weighting)
+		{
+			if (weighting == gltf_normal_generation::none)
+				return;
+
+			auto needs_normals = [](const basic_gltf_partial_mesh<Real>& sub_mesh)
+			{
+				return sub_mesh.render_mode == triangles_mode && sub_mesh.position_info.valid && !sub_mesh.normal_info.valid;
+			};
+
+			const std::size_t max_vertices = std::size_t(std::numeric_limits<std::uint16_t>::max()) + 1;
+
+			// flat normals need a vertex per triangle corner, the indices become 0, 1, 2, ...
+			if (weighting == gltf_normal_generation::flat)
+			{
+				detail::rebuild_vertices(mesh, [&](basic_gltf_partial_mesh<Real>& sub_mesh, std::vector<std::uint32_t>& source_vertices)
+				{
+					if (!needs_normals(sub_mesh) || sub_mesh.indices.empty() || sub_mesh.indices.size() > max_vertices)
+						return false;
+
+					source_vertices.assign(std::begin(sub_mesh.indices), std::end(sub_mesh.indices));
+					for (std::size_t i = 0; i < sub_mesh.indices.size(); ++i)
+						sub_mesh.indices[i] = static_cast<std::uint16_t>(i);
+
+					return true;
+				});
+			}
+
+			add_float_attribute<Real, 3>(mesh, [&](basic_gltf_partial_mesh<Real>& sub_mesh, std::vector<vec3>& normals)
+				-> basic_gltf_component_info<Real>*
+			{
+				if (!needs_normals(sub_mesh))
+					return nullptr;
+
+				const std::vector<vec3> positions = detail::read_vec3(mesh.buffers, sub_mesh.position_info);
+
+				// a flat primitive that could not be split shares its vertices, it gets smooth normals
+				gltf_normal_generation primitive_weighting = weighting;
+				if (weighting == gltf_normal_generation::flat && !sub_mesh.indices.empty()
+					&& sub_mesh.indices.size() != positions.size())
+					primitive_weighting = gltf_normal_generation::area_weighted;
+
+				normals = vertex_normals(triangle_list(sub_mesh, positions.size()), positions, primitive_weighting);
+				return &sub_mesh.normal_info;
+			});
+		}
+
+		std::vector<std::array<float, 4>> generate_tangents(const std::vector<std::uint16_t>& indices,
+			const std::vector<std::array<float, 3>>& positions, const std::vector<std::array<float, 3>>& normals,
+			const std::vector<std::array<float, 2>>& texcoords)
+		{
+			return vertex_tangents(std::vector<std::uint32_t>(std::begin(indices), std::end(indices)), positions, normals, texcoords);
+		}
+
+		template <typename Real>
+		void generate_tangents(basic_gltf_mesh<Real>& mesh, std::uint32_t texcoord_set)
+		{
+			add_float_attribute<Real, 4>(mesh, [&](basic_gltf_partial_mesh<Real>& sub_mesh, std::vector<vec4>& tangents)
+				-> basic_gltf_component_info<Real>*
+			{
+				if (sub_mesh.render_mode != triangles_mode || sub_mesh.tangent_info.valid || !sub_mesh.position_info.valid
+					|| !sub_mesh.normal_info.valid || texcoord_set >= sub_mesh.texcoord_infos.size()
+					|| !sub_mesh.texcoord_infos[texcoord_set].valid)
+					return nullptr;
+
+				const std::vector<vec3> positions = detail::read_vec3(mesh.buffers, sub_mesh.position_info);
+				const std::vector<vec3> normals = detail::read_vec3(mesh.buffers, sub_mesh.normal_info);
+
+				const detail::attribute_reader reader{ mesh.buffers, sub_mesh.texcoord_infos[texcoord_set] };
+				std::vector<vec2> texcoords(reader.size());
+				for (std::size_t i = 0; i < texcoords.size(); ++i)
+					texcoords[i] = { reader.component(i, 0), reader.component(i, 1) };
+
+				if (normals.size() != positions.size() || texcoords.size() != positions.size())
+					return nullptr;
+
+				tangents = vertex_tangents(triangle_list(sub_mesh, positions.size()), positions, normals, texcoords);
+				return &sub_mesh.tangent_info;
+			});
+		}
+
+		template void generate_normals(gltf_mesh&, gltf_normal_generation);
+		template void generate_normals(gltf_mesh_f&, gltf_normal_generation);
+		template void generate_tangents(gltf_mesh&, std::uint32_t);
+		template void generate_tangents(gltf_mesh_f&, std::uint32_t);
+	} // namespace graphics
+} // namespace knu
@@ -0,0 +1,37 @@
+#ifndef KNU_GLTF_VERTEX_GEN_HPP
+#define KNU_GLTF_VERTEX_GEN_HPP
+
+#include "gltf.hpp"
+
+namespace knu
+{
+	namespace graphics
+	{
+		// unit normals of an indexed triangle list, one per vertex. Smooth weightings average the
+		// triangles around every position (not every vertex, so attribute seams stay smooth). Flat
+		// averages around every vertex instead, which is the triangle's own normal as long as no
+		// vertex is shared between triangles
+		std::vector<std::array<float, 3>> generate_normals(const std::vector<std::uint16_t>& indices,
+			const std::vector<std::array<float, 3>>& positions, gltf_normal_generation weighting);
+
+		// gives every TRIANGLES primitive without a NORMAL accessor a generated one, in an owned buffer.
+		// For flat normals the triangles stop sharing vertices first, primitives that would need more
+		// than 65536 vertices for that get area weighted normals instead. Primitives run in parallel
+		template <typename Real>
+		void generate_normals(basic_gltf_mesh<Real>& mesh, gltf_normal_generation weighting);
+
+		// MikkTSpace style tangents of an indexed triangle list, xyz unit length and w the sign of the
+		// bitangent, cross(normal, tangent) * w. Where MikkTSpace would split a vertex shared by mirrored
+		// and unmirrored texture space the side with the larger corner angles is kept instead
+		std::vector<std::array<float, 4>> generate_tangents(const std::vector<std::uint16_t>& indices,
+			const std::vector<std::array<float, 3>>& positions, const std::vector<std::array<float, 3>>& normals,
+			const std::vector<std::array<float, 2>>& texcoords);
+
+		// gives every TRIANGLES primitive without a TANGENT accessor a generated one, in an owned buffer.
+		// Needs NORMAL and TEXCOORD_<texcoord_set>, generate_normals can provide the first. Primitives run in parallel
+		template <typename Real>
+		void generate_tangents(basic_gltf_mesh<Real>& mesh, std::uint32_t texcoord_set = 0);
+	}
+}
+
+#endif // !KNU_GLTF_VERTEX_GEN_HPP
@@ -3,9 +3,22 @@
 
 //#include "json.hpp"
 #include <iostream>
+#include <algorithm>
 #include <iomanip>
 #include <filesystem>
+#include <cmath>
+#include <cstring>
+#include <chrono>
 #include "gltf.hpp"
+#include "gltf_animation.hpp"
+#include "gltf_bvh.hpp"
+#include "gltf_indirect.hpp"
+#include "gltf_interleave.hpp"
+#include "gltf_mesh_opt.hpp"
+#include "gltf_morph.hpp"
+#include "gltf_quantize.hpp"
+#include "gltf_upload.hpp"
+#include "gltf_skin.hpp"
 
 
 //using json = nlohmann::json;
@@ -15,8 +28,731 @@ std::string node_name = "Cube";
 
 using namespace std;
 
-int main()
+namespace
 {
+	int failures = 0;
+
+	void check(bool condition, const std::string& what)
+	{
+		cout << (condition ? "ok    " : "FAIL  ") << what << "\n";
+		if (!condition)
+			++failures;
+	}
+
+	// nodes without names are built by index, each one draws its own mesh
+	void check_scene_draws()
+	{
+		knu::graphics::gltf scene{ "scene_unnamed.gltf", path };
+
+		knu::graphics::gltf_vertex_layout layout;
+		layout.elements.push_back({ knu::graphics::gltf_semantics::position, knu::graphics::gltf_vertex_format::float3, 0 });
+		layout.stride = 12;
+
+		const knu::graphics::gltf_indirect_draws draws = scene.build_scene_draws(layout);
+		check(draws.commands.size() == 2, "scene draws: one command per unnamed mesh node");
+		if (draws.commands.size() == 2)
+		{
+			check(draws.commands[0].count == 36 && draws.commands[1].count == 24,
+				"scene draws: unnamed nodes draw their own meshes");
+		}
+
+		check(scene.build_shared_node("") == scene.build_shared_node(""), "shared node: same node handed out again");
+	}
+
+	// a morphed primitive moved to world space morphs to the moved morph of the original
+	void check_pre_transformed_targets()
+	{
+		knu::graphics::gltf_mesh mesh;
+		auto float3_stream = [&mesh](const std::vector<float>& values)
+		{
+			knu::graphics::gltf_component_info info;
+			info.valid = true;
+			info.buffer_index = static_cast<std::uint32_t>(mesh.buffers.size());
+			info.byte_offset = 0;
+			info.component_type = 5126;
+			info.component_count = 3;
+			info.byte_stride = 0;
+			info.count = static_cast<std::uint32_t>(values.size() / 3);
+			mesh.buffers.push_back(knu::graphics::gltf_buffer{ values.size() * 4, std::vector<std::uint8_t>(values.size() * 4) });
+			std::memcpy(mesh.buffers.back().data.data(), values.data(), values.size() * 4);
+			return info;
+		};
+
+		knu::graphics::gltf_partial_mesh points;
+		points.render_mode = 0;		// POINTS
+		points.material_index = 0;
+		points.position_info = float3_stream({ 0, 0, 0, 1, 0, 0, 0, 1, 0 });
+		points.normal_info = float3_stream({ 0, 0, 1, 1, 0, 0, 0, 1, 0 });
+		knu::graphics::gltf_morph_target target;
+		target.position_info = float3_stream({ 0, 0, 1, 0.5f, 0, 0, 0, 0, -1 });
+		target.normal_info = float3_stream({ 1, 0, 0, 0, 1, 0, 0, 0, 1 });
+		points.targets.push_back(target);
+		mesh.sub_meshes.push_back(points);
+
+		// a quarter turn around z after a scale of 2 in x, then moved by (1, 2, 3)
+		const std::array<double, 16> matrix{ 0, 2, 0, 0, -1, 0, 0, 0, 0, 0, 1, 0, 1, 2, 3, 1 };
+		const float weight = 0.5f;
+		std::vector<float> positions, normals, moved_positions, moved_normals;
+		knu::graphics::morph_vertices(mesh, mesh.sub_meshes[0], &weight, 1, positions, &normals);
+		knu::graphics::pre_transform(mesh, matrix);
+		knu::graphics::morph_vertices(mesh, mesh.sub_meshes[0], &weight, 1, moved_positions, &moved_normals);
+
+		float position_error = 0.0f;
+		float normal_error = 0.0f;
+		for (std::size_t i = 0; i < 3; ++i)
+		{
+			const float* p = positions.data() + i * 3;
+			const float* n = normals.data() + i * 3;
+			const float expected_position[3] = { -p[1] + 1.0f, 2.0f * p[0] + 2.0f, p[2] + 3.0f };
+			// the inverse transpose of the 3x3, up to scale
+			float expected_normal[3] = { -2.0f * n[1], n[0], 2.0f * n[2] };
+			const float length = std::sqrt(expected_normal[0] * expected_normal[0] + expected_normal[1] * expected_normal[1]
+				+ expected_normal[2] * expected_normal[2]);
+			for (int c = 0; c < 3; ++c)
+			{
+				position_error = std::max(position_error, std::abs(moved_positions[i * 3 + c] - expected_position[c]));
+				normal_error = std::max(normal_error, std::abs(moved_normals[i * 3 + c] - expected_normal[c] / length));
+			}
+		}
+
+		check(position_error < 1e-5f, "pre_transform: target positions move with the vertices");
+		check(normal_error < 1e-5f, "pre_transform: target normals move with the normals");
+	}
+
+	// an element that does not fit the stride is refused before anything is written
+	void check_bad_layout()
+	{
+		knu::graphics::gltf box{ file_name, path };
+		const knu::graphics::gltf_node_f cube = box.build_node_f(node_name).second;
+
+		knu::graphics::gltf_vertex_layout layout;
+		layout.elements.push_back({ knu::graphics::gltf_semantics::position, knu::graphics::gltf_vertex_format::float3, 8 });
+		layout.stride = 16;
+		check(!knu::graphics::is_valid_layout(layout), "layout: element past the stride is invalid");
+
+		bool refused = false;
+		try
+		{
+			knu::graphics::build_vertex_buffer(cube.mesh, cube.mesh.sub_meshes[0], layout);
+		}
+		catch (const std::invalid_argument&)
+		{
+			refused = true;
+		}
+		check(refused, "layout: vertex buffer refuses an element past the stride");
+
+		refused = false;
+		try
+		{
+			knu::graphics::build_indirect_draws(std::vector<knu::graphics::gltf_node_f>{ cube }, layout);
+		}
+		catch (const std::invalid_argument&)
+		{
+			refused = true;
+		}
+		check(refused, "layout: indirect draws refuse an element past the stride");
+	}
+
+	// interleaving a quantized primitive gives back the positions and normals, not the stored integers
+	void check_interleave_quantized()
+	{
+		knu::graphics::gltf box{ file_name, path };
+		knu::graphics::gltf_build_options options;
+		const knu::graphics::gltf_node_f plain = box.build_node_f(node_name, options).second;
+		options.quantize_vertices = true;
+		const knu::graphics::gltf_node_f quantized = box.build_node_f(node_name, options).second;
+
+		knu::graphics::gltf_vertex_layout layout;
+		layout.elements.push_back({ knu::graphics::gltf_semantics::position, knu::graphics::gltf_vertex_format::float3, 0 });
+		layout.elements.push_back({ knu::graphics::gltf_semantics::normal, knu::graphics::gltf_vertex_format::float3, 12 });
+		layout.stride = 24;
+
+		const std::vector<std::uint8_t> a = knu::graphics::build_vertex_buffer(plain.mesh, plain.mesh.sub_meshes[0], layout);
+		const std::vector<std::uint8_t> b = knu::graphics::build_vertex_buffer(quantized.mesh, quantized.mesh.sub_meshes[0], layout);
+
+		float position_error = a.size() == b.size() ? 0.0f : 1.0f;
+		float normal_error = 0.0f;
+		for (std::size_t v = 0; a.size() == b.size() && v < a.size() / layout.stride; ++v)
+		{
+			float x[6], y[6];
+			std::memcpy(x, a.data() + v * layout.stride, sizeof(x));
+			std::memcpy(y, b.data() + v * layout.stride, sizeof(y));
+			for (int c = 0; c < 3; ++c)
+			{
+				position_error = std::max(position_error, std::abs(x[c] - y[c]));
+				normal_error = std::max(normal_error, std::abs(x[3 + c] - y[3 + c]));
+			}
+		}
+
+		check(position_error < 2.0f / 65535.0f, "interleave: quantized positions are decoded");
+		check(normal_error < 1e-3f, "interleave: octahedral normals are decoded");
+	}
+
+	// a static batch of unnamed nodes holds every node it was given
+	void check_static_batch()
+	{
+		knu::graphics::gltf scene{ "scene_unnamed.gltf", path };
+		const std::pair<bool, knu::graphics::gltf_node_f> batch = scene.build_static_batch_f(std::vector<std::size_t>{ 0, 1 });
+
+		std::size_t index_count = 0;
+		float max_x = std::numeric_limits<float>::lowest();
+		for (const knu::graphics::gltf_partial_mesh_f& sub_mesh : batch.second.mesh.sub_meshes)
+		{
+			index_count += sub_mesh.indices.size();
+			max_x = std::max(max_x, sub_mesh.position_info.max_bounds[0]);
+		}
+
+		check(batch.first && index_count == 36 + 24, "static batch: unnamed nodes batch their own meshes");
+		check(max_x > 4.0f, "static batch: nodes are moved to world space");
+	}
+
+	// the triangle hierarchy of a stripified primitive covers the same triangles as the list did
+	void check_stripified_bvh()
+	{
+		knu::graphics::gltf box{ file_name, path };
+		knu::graphics::gltf_build_options options;
+		options.build_triangle_bvh = true;
+
+		const knu::graphics::gltf_node_f list = box.build_node_f(node_name, options).second;
+		options.stripify = true;
+		const knu::graphics::gltf_node_f strips = box.build_node_f(node_name, options).second;
+
+		const auto& list_bvh = *list.mesh.sub_meshes[0].triangle_bvh;
+		const auto& strip_bvh = *strips.mesh.sub_meshes[0].triangle_bvh;
+		check(strips.mesh.sub_meshes[0].render_mode == 5, "stripify: primitive became a strip");
+		check(!strip_bvh.nodes.empty(), "stripify: strip primitive has a triangle hierarchy");
+
+		const knu::graphics::gltf_ray ray{ { 0.25f, 0.3f, 10.0f }, { 0.0f, 0.0f, -1.0f } };
+		const knu::graphics::gltf_triangle_hit list_hit = knu::graphics::intersect(list_bvh, ray);
+		const knu::graphics::gltf_triangle_hit strip_hit = knu::graphics::intersect(strip_bvh, ray);
+		check(list_hit.triangle != knu::graphics::gltf_triangle_bvh::no_triangle && strip_hit.triangle != knu::graphics::gltf_triangle_bvh::no_triangle
+			&& std::abs(list_hit.t - strip_hit.t) < 1e-5f, "stripify: strip hierarchy hits where the list one does");
+	}
+
+	// hierarchies are only shared between builds with the same options
+	void check_bvh_cache()
+	{
+		knu::graphics::gltf box{ file_name, path };
+		knu::graphics::gltf_build_options options;
+		options.build_triangle_bvh = true;
+		options.weld_vertices = true;
+		options.optimize_vertex_cache = true;
+
+		const auto first = box.build_node_f(node_name, options).second.mesh.sub_meshes[0].triangle_bvh;
+		const auto again = box.build_node_f(node_name, options).second.mesh.sub_meshes[0].triangle_bvh;
+		options.generate_tangents = true;
+		const auto tangents = box.build_node_f(node_name, options).second.mesh.sub_meshes[0].triangle_bvh;
+
+		check(first == again, "bvh cache: same options share the hierarchy");
+		check(first != tangents, "bvh cache: tangent generation gets a hierarchy of its own");
+	}
+
+	// a bumpy grid of n x n quads split down the middle by a seam, the right half uses vertices of its
+	// own at the same positions as the left half's last column
+	struct grid
+	{
+		std::vector<std::array<float, 3>> positions;
+		std::vector<std::uint16_t> indices;
+		std::vector<std::uint16_t> seam;		// the vertices of both sides of the seam
+	};
+
+	grid make_grid(int n)
+	{
+		grid g;
+		const int columns = n + 1;
+		auto vertex = [&](int x, int y) { return static_cast<std::uint16_t>(y * columns + x); };
+		for (int y = 0; y <= n; ++y)
+			for (int x = 0; x <= n; ++x)
+				g.positions.push_back({ static_cast<float>(x), static_cast<float>(y), 0.3f * std::sin(x * 0.4f) * std::cos(y * 0.3f) });
+
+		// the copies of the middle column
+		const int middle = n / 2;
+		std::vector<std::uint16_t> copies;
+		for (int y = 0; y <= n; ++y)
+		{
+			copies.push_back(static_cast<std::uint16_t>(g.positions.size()));
+			g.positions.push_back(g.positions[vertex(middle, y)]);
+			g.seam.push_back(vertex(middle, y));
+			g.seam.push_back(copies.back());
+		}
+
+		for (int y = 0; y < n; ++y)
+			for (int x = 0; x < n; ++x)
+			{
+				auto corner = [&](int cx, int cy) { return cx == middle && x >= middle ? copies[cy] : vertex(cx, cy); };
+				const std::uint16_t a = corner(x, y), b = corner(x + 1, y), c = corner(x + 1, y + 1), d = corner(x, y + 1);
+				g.indices.insert(std::end(g.indices), { a, b, c, a, c, d });
+			}
+
+		return g;
+	}
+
+	// the triangles of a list, each rotated so its smallest index is first, sorted
+	std::vector<std::array<std::uint32_t, 3>> triangle_set(const std::vector<std::uint16_t>& indices)
+	{
+		std::vector<std::array<std::uint32_t, 3>> triangles;
+		for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			std::array<std::uint32_t, 3> t{ indices[i], indices[i + 1], indices[i + 2] };
+			while (t[0] > t[1] || t[0] > t[2])
+				t = { t[1], t[2], t[0] };
+			triangles.push_back(t);
+		}
+
+		std::sort(std::begin(triangles), std::end(triangles));
+		return triangles;
+	}
+
+	// the reordering stages keep every triangle and its winding
+	void check_reordering()
+	{
+		const grid g = make_grid(40);
+		const auto before = knu::graphics::analyze_vertex_cache(g.indices, g.positions.size());
+
+		std::vector<std::uint16_t> indices = g.indices;
+		knu::graphics::optimize_vertex_cache(indices, g.positions.size());
+		const auto after = knu::graphics::analyze_vertex_cache(indices, g.positions.size());
+		check(triangle_set(indices) == triangle_set(g.indices), "vertex cache: same triangles and winding");
+		check(after.acmr <= before.acmr, "vertex cache: miss ratio does not get worse");
+
+		knu::graphics::optimize_overdraw(indices, g.positions);
+		check(triangle_set(indices) == triangle_set(g.indices), "overdraw: same triangles and winding");
+	}
+
+	// fetch order drops what no triangle uses and keeps the triangles on the same positions
+	void check_vertex_fetch()
+	{
+		const grid g = make_grid(8);
+		std::vector<std::uint16_t> indices(std::begin(g.indices), std::begin(g.indices) + 30);
+
+		std::vector<std::uint16_t> used = indices;
+		std::sort(std::begin(used), std::end(used));
+		used.erase(std::unique(std::begin(used), std::end(used)), std::end(used));
+
+		const std::vector<std::uint16_t> original = indices;
+		const std::vector<std::uint32_t> remap = knu::graphics::optimize_vertex_fetch(indices, g.positions.size());
+		check(remap.size() == used.size(), "vertex fetch: unused vertices are dropped");
+
+		bool same = indices.size() == original.size();
+		for (std::size_t i = 0; same && i < indices.size(); ++i)
+			same = indices[i] < remap.size() && remap[indices[i]] == original[i];
+		check(same, "vertex fetch: indices point at the same vertices");
+	}
+
+	// exact welding merges the seam copies and nothing else
+	void check_exact_weld()
+	{
+		const grid g = make_grid(8);
+		knu::graphics::gltf_mesh mesh;
+		mesh.buffers.push_back(knu::graphics::gltf_buffer{ g.positions.size() * 12, std::vector<std::uint8_t>(g.positions.size() * 12) });
+		std::memcpy(mesh.buffers[0].data.data(), g.positions.data(), g.positions.size() * 12);
+
+		knu::graphics::gltf_partial_mesh sub_mesh;
+		sub_mesh.render_mode = 4;
+		sub_mesh.material_index = 0;
+		sub_mesh.indices = g.indices;
+		sub_mesh.position_info.valid = true;
+		sub_mesh.position_info.buffer_index = 0;
+		sub_mesh.position_info.byte_offset = 0;
+		sub_mesh.position_info.component_type = 5126;
+		sub_mesh.position_info.component_count = 3;
+		sub_mesh.position_info.byte_stride = 0;
+		sub_mesh.position_info.count = static_cast<std::uint32_t>(g.positions.size());
+		mesh.sub_meshes.push_back(sub_mesh);
+
+		knu::graphics::weld_vertices(mesh);
+		const knu::graphics::gltf_weld_report& report = mesh.sub_meshes[0].weld_report;
+		check(report.valid && report.vertices_before - report.vertices_after == g.seam.size() / 2,
+			"weld: exact copies merge, nothing else does");
+	}
+
+	// each lod has fewer indices than the one before and the seam is never collapsed
+	void check_lods()
+	{
+		const grid g = make_grid(40);
+		std::vector<std::uint16_t> previous = g.indices;
+		bool fewer = true;
+		bool seam_kept = true;
+		for (float ratio : { 0.5f, 0.25f, 0.125f })
+		{
+			const std::vector<std::uint16_t> lod = knu::graphics::simplify(previous,
+				g.positions, static_cast<std::size_t>(g.indices.size() * ratio));
+			fewer = fewer && lod.size() < previous.size();
+			for (std::uint16_t v : g.seam)
+				seam_kept = seam_kept && std::find(std::begin(lod), std::end(lod), v) != std::end(lod);
+			previous = lod;
+		}
+
+		check(fewer, "lods: every lod has fewer indices");
+		check(seam_kept, "lods: seam vertices stay put");
+	}
+
+	// every meshlet keeps to its limits and together they hold every triangle once
+	void check_meshlets()
+	{
+		const grid g = make_grid(40);
+		const std::uint32_t max_vertices = 64;
+		const std::uint32_t max_triangles = 124;
+		const knu::graphics::gltf_meshlets meshlets = knu::graphics::build_meshlets(g.indices, g.positions, max_vertices, max_triangles);
+
+		bool within = true;
+		std::vector<std::uint16_t> triangles;
+		for (const knu::graphics::gltf_meshlet& m : meshlets.meshlets)
+		{
+			within = within && m.vertex_count <= max_vertices && m.triangle_count <= max_triangles;
+			for (std::uint32_t t = 0; t < m.triangle_count * 3; ++t)
+			{
+				const std::uint8_t micro = meshlets.triangles[m.triangle_offset + t];
+				within = within && micro < m.vertex_count;
+				triangles.push_back(static_cast<std::uint16_t>(meshlets.vertices[m.vertex_offset + micro]));
+			}
+		}
+
+		check(within, "meshlets: vertex and triangle limits hold");
+		check(triangle_set(triangles) == triangle_set(g.indices), "meshlets: every triangle once");
+	}
+
+	// quantized positions and normals decode to what they were, and the vectorized octahedral encoding
+	// agrees with encode_octahedral, signed zeros included
+	void check_quantize_round_trip()
+	{
+		std::vector<std::array<float, 3>> normals{ { -0.0f, 0.6f, -0.8f }, { 0.6f, -0.0f, -0.8f }, { -0.0f, -0.0f, -1.0f },
+			{ 0.0f, -0.0f, -1.0f }, { -0.0f, 0.0f, 1.0f } };
+		for (int i = 0; normals.size() < 64; ++i)
+		{
+			const float a = i * 0.7f, b = i * 1.3f;
+			normals.push_back({ std::cos(a) * std::sin(b), std::sin(a) * std::sin(b), std::cos(b) });
+		}
+
+		std::vector<std::array<float, 3>> positions;
+		for (std::size_t i = 0; i < normals.size(); ++i)
+			positions.push_back({ i * 0.37f - 3.0f, std::sin(i * 0.5f) * 10.0f, 100.0f + i * 0.01f });
+
+		for (std::uint32_t bits : { 8u, 16u })
+		{
+			knu::graphics::gltf_mesh mesh;
+			const std::size_t bytes = normals.size() * 12;
+			mesh.buffers.push_back(knu::graphics::gltf_buffer{ 2 * bytes, std::vector<std::uint8_t>(2 * bytes) });
+			std::memcpy(mesh.buffers[0].data.data(), positions.data(), bytes);
+			std::memcpy(mesh.buffers[0].data.data() + bytes, normals.data(), bytes);
+
+			knu::graphics::gltf_partial_mesh points;
+			points.render_mode = 0;		// POINTS
+			points.material_index = 0;
+			points.position_info.valid = true;
+			points.position_info.buffer_index = 0;
+			points.position_info.byte_offset = 0;
+			points.position_info.component_type = 5126;
+			points.position_info.component_count = 3;
+			points.position_info.byte_stride = 0;
+			points.position_info.count = static_cast<std::uint32_t>(normals.size());
+			points.position_info.min_bounds = { 0, 0, 0 };
+			points.position_info.max_bounds = { 0, 0, 0 };
+			points.normal_info = points.position_info;
+			points.normal_info.byte_offset = static_cast<std::uint32_t>(bytes);
+			mesh.sub_meshes.push_back(points);
+
+			knu::graphics::quantize_vertices(mesh, bits);
+			const knu::graphics::gltf_partial_mesh& q = mesh.sub_meshes[0];
+			const std::vector<std::uint8_t>& data = mesh.buffers[q.position_info.buffer_index].data;
+
+			float position_error = 0.0f;
+			for (std::size_t i = 0; i < positions.size(); ++i)
+				for (int c = 0; c < 3; ++c)
+				{
+					std::uint16_t value;
+					std::memcpy(&value, data.data() + q.position_info.byte_offset + i * q.position_info.byte_stride + c * 2, 2);
+					const float decoded = q.quantization.position_offset[c] + q.quantization.position_scale[c] * (value / 65535.0f);
+					position_error = std::max(position_error, std::abs(decoded - positions[i][c]) / q.quantization.position_scale[c]);
+				}
+
+			const float max_value = static_cast<float>((1 << (bits - 1)) - 1);
+			bool same_encoding = true;
+			float normal_error = 0.0f;
+			for (std::size_t i = 0; i < normals.size(); ++i)
+			{
+				std::int16_t stored[2];
+				const std::uint8_t* p = mesh.buffers[q.normal_info.buffer_index].data.data() + q.normal_info.byte_offset + i * q.normal_info.byte_stride;
+				for (int c = 0; c < 2; ++c)
+				{
+					if (bits == 8)
+						stored[c] = static_cast<std::int8_t>(p[c]);
+					else
+						std::memcpy(&stored[c], p + c * 2, 2);
+				}
+
+				const std::array<std::int16_t, 2> scalar = knu::graphics::encode_octahedral(normals[i], bits);
+				same_encoding = same_encoding && scalar[0] == stored[0] && scalar[1] == stored[1];
+
+				const std::array<float, 3> decoded = knu::graphics::decode_octahedral(scalar[0] / max_value, scalar[1] / max_value);
+				for (int c = 0; c < 3; ++c)
+					normal_error = std::max(normal_error, std::abs(decoded[c] - normals[i][c]));
+			}
+
+			const std::string name = std::to_string(bits) + " bit";
+			check(position_error <= 1.0f / 65535.0f, "quantize: positions within a step of the originals, " + name);
+			check(normal_error < (bits == 8 ? 0.02f : 1e-4f), "quantize: octahedral round trip within tolerance, " + name);
+			check(same_encoding, "quantize: vectorized octahedral encoding matches the scalar one, " + name);
+		}
+	}
+
+	// overlapping, adjacent and near views join, a view just past the gap or in another buffer does not
+	void check_upload_plan()
+	{
+		using knu::graphics::gltf_buffer_view_range;
+		const std::uint32_t array = knu::graphics::gltf_targets::array_buffer;
+		const std::uint32_t element = knu::graphics::gltf_targets::element_array_buffer;
+		const std::size_t not_uploaded = knu::graphics::gltf_upload_plan::not_uploaded;
+
+		const std::vector<gltf_buffer_view_range> views{
+			{ 0, 0, 100, array, true },
+			{ 0, 50, 100, array, true },		// overlaps
+			{ 0, 150, 10, array, true },		// adjacent
+			{ 0, 416, 20, array, true },		// exactly the gap past the end
+			{ 0, 693, 8, array, true },			// a byte further than the gap
+			{ 1, 0, 12, array, true },			// another buffer
+			{ 0, 0, 4, element, true },
+			{ 0, 2000, 64, array, false } };	// never used
+		const knu::graphics::gltf_upload_plan plan = knu::graphics::plan_uploads(views, 256, 16);
+
+		check(plan.ranges.size() == 4, "upload plan: three array ranges and one index range");
+		check(plan.view_offsets == std::vector<std::size_t>{ 0, 50, 150, 416, 453, 464, 0, not_uploaded },
+			"upload plan: views land at aligned offsets that keep their source alignment");
+		check(plan.array_buffer_bytes == 476 && plan.element_array_buffer_bytes == 4, "upload plan: staging sizes");
+		check(knu::graphics::upload_offset(plan, array, 0, 420) == 420
+			&& knu::graphics::upload_offset(plan, array, 0, 500) == not_uploaded
+			&& knu::graphics::upload_offset(plan, array, 0, 700) == 460
+			&& knu::graphics::upload_offset(plan, array, 1, 4) == 468
+			&& knu::graphics::upload_offset(plan, element, 0, 2) == 2
+			&& knu::graphics::upload_offset(plan, element, 1, 0) == not_uploaded,
+			"upload plan: upload_offset finds the range of a byte");
+	}
+
+	// a loop of two points is a single line
+	void check_short_line_loop()
+	{
+		knu::graphics::gltf_mesh mesh;
+		mesh.buffers.push_back(knu::graphics::gltf_buffer{ 24, std::vector<std::uint8_t>(24, 0) });
+
+		knu::graphics::gltf_partial_mesh loop;
+		loop.render_mode = 2;		// LINE_LOOP
+		loop.material_index = 0;
+		loop.indices = { 0, 1 };
+		loop.position_info.valid = true;
+		loop.position_info.buffer_index = 0;
+		loop.position_info.byte_offset = 0;
+		loop.position_info.component_type = 5126;
+		loop.position_info.component_count = 3;
+		loop.position_info.byte_stride = 0;
+		loop.position_info.count = 2;
+		mesh.sub_meshes.push_back(loop);
+
+		knu::graphics::convert_to_lists(mesh);
+		check(mesh.sub_meshes[0].render_mode == 1 && mesh.sub_meshes[0].indices.size() == 2,
+			"convert_to_lists: two point loop is one line");
+	}
+
+	// coordinates far past the weld grid keep apart instead of overflowing into one cell
+	void check_weld_far_vertices()
+	{
+		const std::vector<float> positions{ 0.0f, 0.0f, 0.0f, 0.0004f, 0.0f, 0.0f,
+			1e30f, 0.0f, 0.0f, 2e30f, 0.0f, 0.0f, 1e30f, 0.0f, 0.0f, 3e9f, 0.0f, 0.0f };
+		knu::graphics::gltf_mesh mesh;
+		mesh.buffers.push_back(knu::graphics::gltf_buffer{ positions.size() * 4, std::vector<std::uint8_t>(positions.size() * 4) });
+		std::memcpy(mesh.buffers[0].data.data(), positions.data(), positions.size() * 4);
+
+		knu::graphics::gltf_partial_mesh points;
+		points.render_mode = 0;		// POINTS
+		points.material_index = 0;
+		points.position_info.valid = true;
+		points.position_info.buffer_index = 0;
+		points.position_info.byte_offset = 0;
+		points.position_info.component_type = 5126;
+		points.position_info.component_count = 3;
+		points.position_info.byte_stride = 0;
+		points.position_info.count = 6;
+		mesh.sub_meshes.push_back(points);
+
+		knu::graphics::weld_vertices(mesh, 0.001f);
+		check(mesh.sub_meshes[0].position_info.count == 4, "weld: near points merge, far ones keep apart");
+	}
+
+	// inverse bind matrices from a sparse accessor without a bufferView, one matrix short of the joints
+	void check_skin_without_buffer_view()
+	{
+		knu::graphics::gltf rig{ "skin_sparse.gltf", path };
+		const std::pair<bool, knu::graphics::gltf_skin> skin = rig.build_skin(0);
+		check(skin.first && skin.second.inverse_bind_matrices.size() == 3, "skin: one matrix per joint");
+		if (skin.second.inverse_bind_matrices.size() != 3)
+			return;
+
+		const std::array<float, 16> identity{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+		std::array<float, 16> translation = identity;
+		translation[12] = 1.0f;
+		translation[13] = 2.0f;
+		translation[14] = 3.0f;
+
+		check(skin.second.inverse_bind_matrices[0] == std::array<float, 16>{}, "skin: matrix without data is zero");
+		check(skin.second.inverse_bind_matrices[1] == translation, "skin: sparse matrix is read");
+		check(skin.second.inverse_bind_matrices[2] == identity, "skin: matrix past the accessor is identity");
+	}
+
+	// a child index past the nodes is skipped and a cycle is walked once
+	void check_broken_hierarchy()
+	{
+		knu::graphics::gltf broken{ "scene_cycle.gltf", path };
+		const std::vector<std::array<double, 16>> world = broken.world_transforms();
+		check(world.size() == 3 && world[2][12] == 1.0 && world[2][13] == 1.0 && world[2][14] == 1.0,
+			"world transforms: bad child skipped, cycle walked once");
+	}
+
+	// an animation copies only the keys it uses, and compressing it keeps the samples within tolerance
+	void check_animation_round_trip()
+	{
+		knu::graphics::gltf mover{ "animation_strided.gltf", path };
+		const knu::graphics::gltf_animation plain = mover.build_animation("move").second;
+
+		std::size_t bytes = 0;
+		for (const knu::graphics::gltf_buffer& buffer : plain.buffers)
+			bytes += buffer.data.size();
+		check(bytes == 200 * (4 + 12 + 16), "animation: only the accessors the samplers use are copied");
+
+		const std::vector<float> first = knu::graphics::sample_animation(plain, 1.0f / 60.0f);
+		check(std::abs(first[0] - std::sin(2.0f / 60.0f)) < 1e-6f && std::abs(first[2] - std::cos(3.0f / 60.0f)) < 1e-6f,
+			"animation: strided keys are read");
+
+		knu::graphics::gltf_animation_options options;
+		options.reduce_keys = true;
+		options.quantize_rotations = true;
+		const knu::graphics::gltf_animation compressed = mover.build_animation("move", options).second;
+
+		float translation_error = 0.0f;
+		float rotation_error = 0.0f;
+		for (float time = plain.start_time; time <= plain.end_time; time += 1.0f / 240.0f)
+		{
+			const std::vector<float> a = knu::graphics::sample_animation(plain, time);
+			const std::vector<float> b = knu::graphics::sample_animation(compressed, time);
+			for (std::uint32_t c = 0; c < 3; ++c)
+				translation_error = std::max(translation_error, std::abs(a[plain.value_offsets[0] + c] - b[compressed.value_offsets[0] + c]));
+
+			float chord = 0.0f;
+			float dot = 0.0f;
+			for (std::uint32_t c = 0; c < 4; ++c)
+			{
+				const float x = a[plain.value_offsets[1] + c];
+				const float y = b[compressed.value_offsets[1] + c];
+				dot += x * y;
+				chord += (x - y) * (x - y);
+			}
+			// the angle between the rotations, from the chord so it stays precise near 0
+			const float half = std::atan2(std::sqrt(chord), std::sqrt(std::max(0.0f, 4.0f - chord)));
+			rotation_error = std::max(rotation_error, 4.0f * (dot < 0.0f ? 3.14159265f / 2.0f - half : half));
+		}
+
+		check(translation_error < 2e-4f, "animation: compressed translations stay within tolerance");
+		check(rotation_error < 5e-4f, "animation: compressed rotations stay within tolerance");
+	}
+
+	// the batch sampling of many instances gives what sampling each one alone does, for a full group of
+	// eight, a short group and a clip whose instances are spread between the others
+	void check_batch_sampling()
+	{
+		knu::graphics::gltf mover{ "animation_strided.gltf", path };
+		knu::graphics::gltf_animation_options options;
+		options.reduce_keys = true;
+		options.quantize_rotations = true;
+		const std::vector<knu::graphics::gltf_animation> clips{ mover.build_animation("move").second,
+			mover.build_animation("move", options).second };
+
+		std::vector<knu::graphics::gltf_animation_instance> instances;
+		const float end_time = clips[0].end_time;
+		for (std::uint32_t i = 0; i < 14; ++i)
+		{
+			// before the first key, on a key, between keys and past the last one
+			const float time = -0.5f + static_cast<float>(i) * (end_time + 1.0f) / 13.0f + (i % 3 == 1 ? 1.0f / 60.0f : 0.0f);
+			instances.push_back(knu::graphics::gltf_animation_instance{ i % 4 == 2 ? 1u : 0u, time });
+		}
+
+		knu::graphics::gltf_pose_batch batch;
+		knu::graphics::sample_animations(clips, instances, batch);
+
+		float error = batch.instance_count == instances.size() ? 0.0f : 1.0f;
+		for (std::size_t i = 0; i < instances.size() && error < 1.0f; ++i)
+		{
+			const std::vector<float> alone = knu::graphics::sample_animation(clips[instances[i].clip], instances[i].time);
+			for (std::size_t v = 0; v < alone.size(); ++v)
+				error = std::max(error, std::abs(alone[v] - batch.values[v * batch.stride + i]));
+		}
+
+		check(error < 1e-5f, "animation: batch sampling matches sampling one instance at a time");
+	}
+
+	// --bench: blends 50 morph targets into 100k vertices and prints the time per call
+	void bench_morph()
+	{
+		const std::size_t vertex_count = 100000;
+		const std::size_t target_count = 50;
+
+		knu::graphics::gltf_mesh mesh;
+		knu::graphics::gltf_partial_mesh face;
+		face.render_mode = 0;		// POINTS
+		face.material_index = 0;
+
+		auto float3_buffer = [&](float scale)
+		{
+			knu::graphics::gltf_component_info info;
+			info.valid = true;
+			info.buffer_index = static_cast<std::uint32_t>(mesh.buffers.size());
+			info.byte_offset = 0;
+			info.component_type = 5126;
+			info.component_count = 3;
+			info.byte_stride = 0;
+			info.count = static_cast<std::uint32_t>(vertex_count);
+
+			std::vector<float> values(vertex_count * 3);
+			for (std::size_t i = 0; i < values.size(); ++i)
+				values[i] = scale * static_cast<float>(i % 97);
+
+			mesh.buffers.push_back(knu::graphics::gltf_buffer{ values.size() * 4, std::vector<std::uint8_t>(values.size() * 4) });
+			std::memcpy(mesh.buffers.back().data.data(), values.data(), values.size() * 4);
+			return info;
+		};
+
+		face.position_info = float3_buffer(1.0f);
+		for (std::size_t t = 0; t < target_count; ++t)
+		{
+			knu::graphics::gltf_morph_target target;
+			target.position_info = float3_buffer(0.001f * static_cast<float>(t + 1));
+			face.targets.push_back(target);
+		}
+		mesh.sub_meshes.push_back(face);
+
+		std::vector<float> weights(target_count);
+		for (std::size_t t = 0; t < target_count; ++t)
+			weights[t] = 1.0f / static_cast<float>(t + 1);
+
+		const int runs = 20;
+		std::vector<float> positions;
+		knu::graphics::morph_vertices(mesh, mesh.sub_meshes[0], weights.data(), weights.size(), positions);
+
+		const auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < runs; ++r)
+			knu::graphics::morph_vertices(mesh, mesh.sub_meshes[0], weights.data(), weights.size(), positions);
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+		cout << "morph " << target_count << " targets, " << vertex_count << " vertices: "
+			<< fixed << setprecision(3) << elapsed.count() / runs << " ms\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::string{ argv[1] } == "--bench")
+	{
+		bench_morph();
+		return 0;
+	}
+
 	//knu::graphics::gltf box(file_name);
 
 	bool success;
@@ -25,7 +761,29 @@ int main()
 
 	std::tie(success, cube_node) =
 		knu::graphics::load_gltf_node(file_name, path, node_name);
+	check(success, "load_gltf_node: box");
 
+	check_scene_draws();
+	check_static_batch();
+	check_bad_layout();
+	check_interleave_quantized();
+	check_pre_transformed_targets();
+	check_stripified_bvh();
+	check_short_line_loop();
+	check_reordering();
+	check_vertex_fetch();
+	check_exact_weld();
+	check_lods();
+	check_meshlets();
+	check_quantize_round_trip();
+	check_upload_plan();
+	check_bvh_cache();
+	check_weld_far_vertices();
+	check_skin_without_buffer_view();
+	check_animation_round_trip();
+	check_batch_sampling();
+	check_broken_hierarchy();
 
-	return 0;
+	cout << (failures == 0 ? "all checks passed\n" : "some checks failed\n");
+	return failures == 0 ? 0 : 1;
 }